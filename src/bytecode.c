@@ -0,0 +1,204 @@
+//
+// Created by alex on 19/10/2026.
+//
+// On-disk cache of precompiled chunks (luac) loaded by Interpreter.require.
+// Chunks are named by the hash of path, mtime and size of the source,
+// so a changed source never matches an old chunk.
+
+#include <Python.h>
+#include <lua.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#include <process.h>
+#include <io.h>
+#define getpid _getpid
+#define access _access
+#define CACHE_PATH_MAX _MAX_PATH
+#else
+#include <unistd.h>
+#include <limits.h>
+#define CACHE_PATH_MAX PATH_MAX
+#endif
+
+#include "bytecode.h"
+
+#define ID_CHUNK 27  // first byte of a precompiled chunk
+#define CHUNK_SIGNATURE "Lua"
+#define CHUNK_VERSION 0x32  // format of the chunks of luac 3.2
+
+static char *cache_directory = NULL;
+static char *cache_compiler = NULL;
+static unsigned long cache_tmpcount = 0;
+
+/* FNV-1a */
+static unsigned long long hash_update(unsigned long long hash, const void *data, size_t size) {
+    const unsigned char *bytes = (const unsigned char *) data;
+    while (size--) {
+        hash ^= *bytes++;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * Sets the directory of the cache and the compiler (luac) used to fill it.
+ * A NULL directory disables the cache. Returns zero on success.
+**/
+int lua_bytecode_cache_set(const char *directory, const char *compiler) {
+    struct stat st;
+    if (directory && (stat(directory, &st) != 0 || !S_ISDIR(st.st_mode)))
+        return -1;
+    free(cache_directory);
+    free(cache_compiler);
+    cache_directory = directory ? strdup(directory) : NULL;
+    cache_compiler = strdup(compiler ? compiler : "luac");
+    return 0;
+}
+
+/* Cached chunk of the file: <directory>/<hash>.luac */
+static int bytecode_cache_path(const char *filename, char *cached, size_t size) {
+    char fullpath[CACHE_PATH_MAX];
+    struct stat st;
+    unsigned long long hash = 14695981039346656037ULL;
+    long long mtime, fsize;
+    if (stat(filename, &st) != 0)
+        return -1;
+#if defined(_WIN32)
+    if (!_fullpath(fullpath, filename, sizeof(fullpath)))
+        return -1;
+#else
+    if (!realpath(filename, fullpath))
+        return -1;
+#endif
+    mtime = (long long) st.st_mtime;
+    fsize = (long long) st.st_size;
+    hash = hash_update(hash, LUA_VERSION, strlen(LUA_VERSION));
+    hash = hash_update(hash, fullpath, strlen(fullpath));
+    hash = hash_update(hash, &mtime, sizeof(mtime));
+    hash = hash_update(hash, &fsize, sizeof(fsize));
+    if (snprintf(cached, size, "%s/%016llx%s", cache_directory, hash, LUA_BYTECODE_SUFFIX) >= (int) size)
+        return -1;
+    return 0;
+}
+
+/* Checks if the file is already a precompiled chunk */
+static int is_bytecode(const char *filename) {
+    FILE *file = fopen(filename, "rb");
+    int c = EOF;
+    if (file) {
+        c = fgetc(file);
+        fclose(file);
+    }
+    return c == ID_CHUNK;
+}
+
+/* Checks the header of the chunk: ESC "Lua" <version> of this Lua (not the luac of Lua 5.x) */
+static int is_chunk_valid(const char *filename) {
+    unsigned char header[5];
+    FILE *file = fopen(filename, "rb");
+    size_t size = 0;
+    if (file) {
+        size = fread(header, 1, sizeof(header), file);
+        fclose(file);
+    }
+    return size == sizeof(header) && header[0] == ID_CHUNK &&
+           memcmp(header + 1, CHUNK_SIGNATURE, 3) == 0 &&
+           header[4] == CHUNK_VERSION;
+}
+
+/**
+ * Compiles the file with luac into a temporary file, renamed to the chunk name
+ * (atomic: concurrent processes see the whole chunk or nothing).
+**/
+static int bytecode_compile(const char *filename, const char *cached) {
+    char tmpname[CACHE_PATH_MAX + 64];
+    PyObject *subprocess, *ret;
+    long status = -1;
+    snprintf(tmpname, sizeof(tmpname), "%s.%ld.%lu.tmp", cached, (long) getpid(), cache_tmpcount++);
+    if (!(subprocess = PyImport_ImportModule("subprocess")))
+        return -1;
+    ret = PyObject_CallMethod(subprocess, "call", "([ssss])", cache_compiler, "-o", tmpname, filename);
+    Py_DECREF(subprocess);
+    if (ret) {
+        status = PyInt_AsLong(ret);
+        Py_DECREF(ret);
+    }
+    if (status == 0 && !is_chunk_valid(tmpname))
+        status = -1;  // other version of luac
+    if (status == 0 && rename(tmpname, cached) != 0) {
+        // Windows: another process created the chunk first
+        status = access(cached, 0) == 0 ? 0 : -1;
+    }
+    remove(tmpname);
+    return status == 0 ? 0 : -1;
+}
+
+/**
+ * Returns the file to be loaded by lua_dofile: the cached chunk (compiled
+ * on a miss) or the source itself when the cache can not be used.
+**/
+const char *lua_bytecode_cache_lookup(const char *filename, char *cached, size_t size) {
+    if (!cache_directory || bytecode_cache_path(filename, cached, size) != 0)
+        return filename;
+    if (access(cached, 0) == 0) {
+        if (is_chunk_valid(cached))
+            return cached;
+        remove(cached);  // written by another version of luac
+    }
+    if (!is_bytecode(filename) && bytecode_compile(filename, cached) == 0)
+        return cached;
+    PyErr_Clear(); // compile errors are reported by the source load
+    return filename;
+}
+
+/**
+ * Compiles every .lua file of the directory (recursive).
+ * Returns the number of cached chunks or -1 on error (python exception).
+**/
+int lua_bytecode_cache_prewarm(const char *directory) {
+    char cached[CACHE_PATH_MAX + 64];
+    PyObject *os, *walk, *item;
+    int count = 0;
+    size_t suffix = strlen(".lua");
+    if (!cache_directory) {
+        PyErr_SetString(PyExc_RuntimeError, "bytecode cache is not enabled");
+        return -1;
+    }
+    if (!(os = PyImport_ImportModule("os")))
+        return -1;
+    walk = PyObject_CallMethod(os, "walk", "(s)", directory);
+    Py_DECREF(os);
+    if (!walk || !(item = PyObject_GetIter(walk))) {
+        Py_XDECREF(walk);
+        return -1;
+    }
+    Py_DECREF(walk);
+    walk = item;
+    while ((item = PyIter_Next(walk))) { // (dirpath, dirnames, filenames)
+        char *dirpath;
+        PyObject *dirnames, *filenames;
+        Py_ssize_t index;
+        if (!PyArg_ParseTuple(item, "sOO", &dirpath, &dirnames, &filenames)) {
+            Py_DECREF(item);
+            break;
+        }
+        for (index = 0; index < PySequence_Size(filenames); index++) {
+            PyObject *name = PySequence_GetItem(filenames, index);
+            char *s = name ? PyString_AsString(name) : NULL;
+            if (s && strlen(s) > suffix && strcmp(s + strlen(s) - suffix, ".lua") == 0) {
+                char filename[CACHE_PATH_MAX];
+                snprintf(filename, sizeof(filename), "%s/%s", dirpath, s);
+                if (lua_bytecode_cache_lookup(filename, cached, sizeof(cached)) != filename)
+                    count++;
+            }
+            Py_XDECREF(name);
+            PyErr_Clear();
+        }
+        Py_DECREF(item);
+    }
+    Py_DECREF(walk);
+    return PyErr_Occurred() ? -1 : count;
+}
@@ -0,0 +1,16 @@
+//
+// Created by alex on 19/10/2026.
+//
+
+#ifndef LUNATIC_BYTECODE_H
+#define LUNATIC_BYTECODE_H
+
+#include <stddef.h>
+
+#define LUA_BYTECODE_SUFFIX ".luac"
+
+int lua_bytecode_cache_set(const char *directory, const char *compiler);
+const char *lua_bytecode_cache_lookup(const char *filename, char *cached, size_t size);
+int lua_bytecode_cache_prewarm(const char *directory);
+
+#endif //LUNATIC_BYTECODE_H
@@ -11,9 +11,15 @@
 #define PY_API_TAG "_api_tag"
 #define PY_UNICODE_ENCODING "_unicode_encoding"
 #define PY_UNICODE_ENCODING_ERRORHANDLER "_unicode_encoding_errorhandler"
+#define PY_UNICODE_CODEC "_unicode_codec"
+#define PY_UNICODE_DECODING "_unicode_decoding"
 #define PY_OBJECT_BY_REFERENCE "_object_by_reference"
 #define PY_LUA_TABLE_CONVERT "_lua_table_convert"
+#define PY_LUA_TABLE_DEPTH "_lua_table_depth"
 #define PY_API_IS_EMBEDDED "_api_is_embedded"
+#define PY_STATE_ID "_state_id"
+#define PY_REF_REGISTRY "_refs"
+#define PY_SCHEMA_KEYS "_schema_keys"
 
 // globals Lua
 #define PY_ARGS_ARRAY_FUNC "pyargs_array"
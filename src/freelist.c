@@ -0,0 +1,58 @@
+//
+// Created by alex on 19/10/2026.
+//
+#include <Python.h>
+
+#include "freelist.h"
+
+lua_freelist LuaObject_freelist = {"LuaObject", PyObject_GC_Del};
+lua_freelist LuaObjectIter_freelist = {"LuaObject_iterator", PyObject_GC_Del};
+
+/**
+ * Released object ready for reuse (new reference, the fields must be set again).
+ * Returns NULL when the list is empty.
+**/
+PyObject *lua_freelist_pop(lua_freelist *list) {
+    if (list->count == 0) {
+        list->misses++;
+        return NULL;
+    }
+    PyObject *obj = list->items[--list->count];
+    _Py_NewReference(obj);
+    list->hits++;
+    return obj;
+}
+
+/* Keeps the object in dealloc (instead of tp_free). Returns false when the list is full. */
+bool lua_freelist_push(lua_freelist *list, PyObject *obj) {
+    if (list->count >= LUA_FREELIST_SIZE)
+        return false;
+    list->items[list->count++] = obj;
+    return true;
+}
+
+/* Releases the memory of the kept objects (the counters are kept) */
+void lua_freelist_clear(lua_freelist *list) {
+    while (list->count > 0)
+        list->release(list->items[--list->count]);
+}
+
+/* {name: {"hits": n, "misses": n, "size": n}} of the lists */
+PyObject *lua_freelist_stats(void) {
+    lua_freelist *lists[] = {&LuaObject_freelist, &LuaObjectIter_freelist, NULL};
+    PyObject *stats = PyDict_New(), *item;
+    int index;
+    if (!stats)
+        return NULL;
+    for (index = 0; lists[index]; index++) {
+        item = Py_BuildValue("{s:n,s:n,s:i}", "hits", lists[index]->hits,
+                             "misses", lists[index]->misses, "size", lists[index]->count);
+        if (!item || PyDict_SetItemString(stats, lists[index]->name, item) != 0) {
+            Py_XDECREF(item);
+            Py_DECREF(stats);
+            return NULL;
+        }
+        Py_DECREF(item);
+    }
+    return stats;
+}
@@ -0,0 +1,34 @@
+//
+// Created by alex on 19/10/2026.
+//
+// Free lists of the short-lived wrappers (LuaObject and its iterator): the
+// released objects are kept (up to LUA_FREELIST_SIZE) and reused by the next
+// allocation, as CPython does with tuples and floats. Used with the GIL held.
+
+#ifndef LUNATIC_FREELIST_H
+#define LUNATIC_FREELIST_H
+
+#include <Python.h>
+#include <stdbool.h>
+
+// Maximum number of objects kept by each list
+#define LUA_FREELIST_SIZE 256
+
+typedef struct {
+    const char *name;
+    freefunc release;   // tp_free of the type (clear)
+    PyObject *items[LUA_FREELIST_SIZE];
+    int count;
+    Py_ssize_t hits;    // allocations served by the list
+    Py_ssize_t misses;  // allocations with the list empty
+} lua_freelist;
+
+extern lua_freelist LuaObject_freelist;
+extern lua_freelist LuaObjectIter_freelist;
+
+PyObject *lua_freelist_pop(lua_freelist *list);
+bool lua_freelist_push(lua_freelist *list, PyObject *obj);
+void lua_freelist_clear(lua_freelist *list);
+PyObject *lua_freelist_stats(void);
+
+#endif //LUNATIC_FREELIST_H
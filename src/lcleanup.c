@@ -0,0 +1,192 @@
+//
+// Created by alex on 19/10/2026.
+//
+#include <Python.h>
+#include <lua.h>
+#include <lstate.h>
+#include <string.h>
+
+#include "lcleanup.h"
+#include "lthread.h"
+#include "utils.h"
+
+typedef struct lua_cleanup_entry lua_cleanup_entry;
+typedef void (*lua_cleanup_fn)(lua_cleanup_entry *entry);
+
+/**
+ * Entry of the stack: a temporary (release) or a mark.
+ * Marks: frame of a Lua C function (L, base) or barrier (no L).
+**/
+struct lua_cleanup_entry {
+    lua_cleanup_fn release;
+    void *data;
+    lua_State *L;
+    int base;  // position of the C function in the stack of L
+    int value;  // previous value of a flag
+};
+
+typedef struct {
+    lua_cleanup_entry *entries;
+    int top;
+    int size;
+    int lost;  // barriers not pushed (out of memory)
+} lua_cleanup_stack;
+
+static LUA_THREAD_LOCAL lua_cleanup_stack cleanup = {NULL, 0, 0, 0};
+
+static void cleanup_decref(lua_cleanup_entry *entry) {
+    Py_DECREF((PyObject *) entry->data);
+}
+
+static void cleanup_nop(lua_cleanup_entry *entry) {
+}
+
+static void cleanup_flag(lua_cleanup_entry *entry) {
+    lua_beginblock(entry->L);  // also released outside of the C functions
+    python_setnumber(entry->L, (char *) entry->data, entry->value);
+    lua_endblock(entry->L);
+}
+
+/* Returns zero when there is no room for one more entry */
+static int cleanup_reserve(void) {
+    if (cleanup.top < cleanup.size)
+        return 1;
+    int size = cleanup.size ? cleanup.size * 2 : 64;
+    lua_cleanup_entry *entries = realloc(cleanup.entries, size * sizeof(lua_cleanup_entry));
+    if (!entries)
+        return 0;
+    cleanup.entries = entries;
+    cleanup.size = size;
+    return 1;
+}
+
+static int cleanup_mark(lua_State *L, int base) {
+    if (!cleanup_reserve())
+        return 0;
+    lua_cleanup_entry *entry = &cleanup.entries[cleanup.top++];
+    entry->release = NULL;
+    entry->data = NULL;
+    entry->L = L;
+    entry->base = base;
+    entry->value = 0;
+    return 1;
+}
+
+/**
+ * Releases the entries above 'mark' (last in, first out).
+ * A release can run python code reentering the stack, so the entries are read by index.
+**/
+static void cleanup_release(int mark) {
+    if (cleanup.top <= mark)
+        return;
+    PyThreadState *tstate = python_gil_enter();
+    while (cleanup.top > mark) {
+        lua_cleanup_entry entry = cleanup.entries[--cleanup.top];
+        if (entry.release)
+            entry.release(&entry);
+    }
+    python_gil_leave(tstate);
+}
+
+/* Index of the topmost mark (-1: none) */
+static int cleanup_topmark(void) {
+    int index = cleanup.top - 1;
+    while (index >= 0 && cleanup.entries[index].release)
+        index--;
+    return index;
+}
+
+/**
+ * Opens the frame of a Lua C function (returns the value for 'lua_cleanup_leave').
+ * Frames of the same state at or above this position are dead: the function
+ * that owned them was left by an error. They are released first.
+**/
+int lua_cleanup_enter(lua_State *L) {
+    int base = (int) L->Cstack.base;
+    int index;
+    while ((index = cleanup_topmark()) >= 0) {
+        lua_cleanup_entry *mark = &cleanup.entries[index];
+        if (mark->L != L || mark->base < base)
+            break;  // barrier, other state or a live caller
+        cleanup_release(index);
+    }
+    int frame = cleanup.top;
+    cleanup_mark(L, base);  // without memory the entries go to the previous frame
+    return frame;
+}
+
+/* Closes the frame: releases the temporaries of the function */
+void lua_cleanup_leave(int frame) {
+    cleanup_release(frame);
+}
+
+/**
+ * Barrier of a protected call (Python calling Lua): the frames opened after it
+ * are released by 'lua_cleanup_unwind' even if an error left them.
+**/
+void lua_cleanup_barrier(void) {
+    if (!cleanup_mark(NULL, 0))
+        cleanup.lost++;
+}
+
+/* Releases the entries above the last barrier (and the barrier) */
+void lua_cleanup_unwind(void) {
+    if (cleanup.lost > 0) {
+        cleanup.lost--;
+        return;
+    }
+    int index = cleanup.top - 1;
+    while (index >= 0 && (cleanup.entries[index].release || cleanup.entries[index].L))
+        index--;
+    if (index >= 0) cleanup_release(index);
+}
+
+/**
+ * Registers a temporary of the current function (the reference is stolen).
+ * The object stays valid until the function returns. Returns 'obj'.
+**/
+PyObject *lua_cleanup_push(lua_State *L, PyObject *obj) {
+    if (!obj)
+        return NULL;
+    if (!cleanup_reserve()) {
+        Py_DECREF(obj);
+        lua_error(L, "not enough memory");
+    }
+    lua_cleanup_entry *entry = &cleanup.entries[cleanup.top++];
+    entry->release = cleanup_decref;
+    entry->data = obj;
+    entry->L = L;
+    entry->base = 0;
+    entry->value = 0;
+    return obj;
+}
+
+/**
+ * Sets the number 'name' of the python table (python_setnumber).
+ * A non-zero value is undone by the zero of the normal exit, or when the function
+ * leaves by an error: both restore the value found before it.
+**/
+void lua_cleanup_flag(lua_State *L, char *name, int value) {
+    if (value == 0) {  // normal exit: the restore is no longer pending
+        int index = cleanup.top - 1;
+        for (; index >= 0 && cleanup.entries[index].release; index--) {
+            lua_cleanup_entry *entry = &cleanup.entries[index];
+            if (entry->release == cleanup_flag && entry->L == L &&
+                strcmp((char *) entry->data, name) == 0) {
+                entry->release = cleanup_nop;
+                value = entry->value;
+                break;
+            }
+        }
+    } else if (!cleanup_reserve()) {
+        lua_error(L, "not enough memory");
+    } else {
+        lua_cleanup_entry *entry = &cleanup.entries[cleanup.top++];
+        entry->release = cleanup_flag;
+        entry->data = name;
+        entry->L = L;
+        entry->base = 0;
+        entry->value = python_getnumber(L, name);
+    }
+    python_setnumber(L, name, value);
+}
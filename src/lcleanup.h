@@ -0,0 +1,22 @@
+//
+// Created by alex on 19/10/2026.
+//
+// Temporaries of the Lua entry points: lua_error (longjmp) leaves the C function
+// without its Py_DECREF calls. The objects are registered in a stack of the
+// thread and released when the function returns, or when a later call (or the
+// protected call that caught the error) finds its frame dead.
+
+#ifndef LUNATIC_LCLEANUP_H
+#define LUNATIC_LCLEANUP_H
+
+#include <Python.h>
+#include <lua.h>
+
+int lua_cleanup_enter(lua_State *L);
+void lua_cleanup_leave(int frame);
+void lua_cleanup_barrier(void);
+void lua_cleanup_unwind(void);
+PyObject *lua_cleanup_push(lua_State *L, PyObject *obj);
+void lua_cleanup_flag(lua_State *L, char *name, int value);
+
+#endif //LUNATIC_LCLEANUP_H
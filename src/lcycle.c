@@ -0,0 +1,403 @@
+//
+// Created by alex on 19/10/2026.
+//
+#include <Python.h>
+#include <lua.h>
+#include <lstate.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include "lapi.h"
+#else
+#include "lshared.h"
+#endif
+
+#include "lcycle.h"
+#include "lregistry.h"
+#include "luaconv.h"
+#include "pyconv.h"
+#include "utils.h"
+
+// Marks of the objects seen: reachable from the roots of the state, or a container
+// reachable from more than one wrapper (both keep the python object alive).
+// The other marks are the index of the wrapper.
+#define LCYCLE_ROOT (-1)
+#define LCYCLE_SHARED (-2)
+
+static char *lcycle_events[] = {
+    "gettable", "settable", "index", "getglobal", "setglobal", "add", "sub",
+    "mul", "div", "pow", "unm", "lt", "le", "gt", "ge", "concat", "gc", "function",
+    NULL
+};
+
+typedef struct {
+    void *key;
+    int mark;
+    PyObject *object;  // object of the container (userdata of the api) or NULL
+} lcycle_entry;
+
+typedef struct {
+    lua_State *L;
+    int tag;                 // tag of the containers
+    lcycle_entry *entries;   // objects seen (open addressing)
+    size_t capacity;
+    size_t count;
+    TObject *stack;          // objects waiting for the traversal
+    size_t top;
+    size_t size;
+} lcycle;
+
+static lcycle_entry *lcycle_find(lcycle *c, void *key) {
+    size_t index = (size_t) (((uintptr_t) key >> 3) * 2654435761u) & (c->capacity - 1);
+    while (c->entries[index].key && c->entries[index].key != key)
+        index = (index + 1) & (c->capacity - 1);
+    return &c->entries[index];
+}
+
+static int lcycle_grow(lcycle *c) {
+    lcycle_entry *entries = c->entries;
+    size_t capacity = c->capacity, index;
+    c->capacity = capacity ? capacity * 2 : 1024;
+    if (!(c->entries = calloc(c->capacity, sizeof(lcycle_entry)))) {
+        c->entries = entries;
+        c->capacity = capacity;
+        return -1;
+    }
+    for (index = 0; index < capacity; index++) {
+        if (entries[index].key)
+            *lcycle_find(c, entries[index].key) = entries[index];
+    }
+    free(entries);
+    return 0;
+}
+
+/* Entry of the object (created with the mark when it is new). NULL without memory. */
+static lcycle_entry *lcycle_get(lcycle *c, void *key, int mark, bool *created) {
+    if ((c->count + 1) * 2 > c->capacity && lcycle_grow(c) != 0)
+        return NULL;
+    lcycle_entry *entry = lcycle_find(c, key);
+    if ((*created = !entry->key)) {
+        entry->key = key;
+        entry->mark = mark;
+        entry->object = NULL;
+        c->count++;
+    }
+    return entry;
+}
+
+/* Queues the objects that can reach others (tables, functions and userdata) */
+static int lcycle_push(lcycle *c, TObject *o) {
+    switch (ttype(o)) {
+        case LUA_T_ARRAY:
+        case LUA_T_CLOSURE:
+        case LUA_T_CLMARK:
+        case LUA_T_PROTO:
+        case LUA_T_PMARK:
+        case LUA_T_USERDATA:
+            break;
+        default:
+            return 0;
+    }
+    if (c->top == c->size) {
+        size_t size = c->size ? c->size * 2 : 256;
+        TObject *stack = realloc(c->stack, size * sizeof(TObject));
+        if (!stack)
+            return -1;
+        c->stack = stack;
+        c->size = size;
+    }
+    c->stack[c->top++] = *o;
+    return 0;
+}
+
+/* 1 if the traversal enters the object (not seen from the roots nor with this mark) */
+static int lcycle_enter(lcycle *c, void *key, int mark) {
+    bool created;
+    lcycle_entry *entry = lcycle_get(c, key, mark, &created);
+    if (!entry)
+        return -1;
+    if (created)
+        return 1;
+    if (entry->mark == LCYCLE_ROOT || entry->mark == mark)
+        return 0;
+    entry->mark = mark;  // seen with another wrapper: traversed again
+    return 1;
+}
+
+/* Container of a python object reached with the mark */
+static int lcycle_container(lcycle *c, TaggedString *ts, int mark) {
+    bool created;
+    lcycle_entry *entry = lcycle_get(c, ts, mark, &created);
+    if (!entry)
+        return -1;
+    if (created) {
+        entry->object = ((py_object *) ts->u.d.v)->object;
+    } else if (entry->mark != LCYCLE_ROOT && entry->mark != mark) {
+        entry->mark = LCYCLE_SHARED;
+    }
+    return 0;
+}
+
+/* Marks everything reachable from the object (the containers found get the mark) */
+static int lcycle_traverse(lcycle *c, TObject *root, int mark) {
+    TObject o;
+    int index, enter;
+    c->top = 0;
+    if (lcycle_push(c, root) != 0)
+        return -1;
+    while (c->top > 0) {
+        o = c->stack[--c->top];
+        switch (ttype(&o)) {
+            case LUA_T_ARRAY: {
+                Hash *hash = avalue(&o);
+                if ((enter = lcycle_enter(c, hash, mark)) <= 0) {
+                    if (enter < 0) return -1;
+                    break;
+                }
+                for (index = 0; index < nhash(c->L, hash); index++) {
+                    Node *n = node(c->L, hash, index);
+                    if (ttype(val(c->L, n)) == LUA_T_NIL)
+                        continue;
+                    if (lcycle_push(c, ref(c->L, n)) != 0 || lcycle_push(c, val(c->L, n)) != 0)
+                        return -1;
+                }
+                break;
+            }
+            case LUA_T_CLOSURE:
+            case LUA_T_CLMARK: {
+                Closure *cl = clvalue(&o);
+                if ((enter = lcycle_enter(c, cl, mark)) <= 0) {
+                    if (enter < 0) return -1;
+                    break;
+                }
+                for (index = 0; index <= cl->nelems; index++) {  // function and upvalues
+                    if (lcycle_push(c, &cl->consts[index]) != 0)
+                        return -1;
+                }
+                break;
+            }
+            case LUA_T_PROTO:
+            case LUA_T_PMARK: {
+                TProtoFunc *tf = tfvalue(&o);
+                if ((enter = lcycle_enter(c, tf, mark)) <= 0) {
+                    if (enter < 0) return -1;
+                    break;
+                }
+                for (index = 0; index < tf->nconsts; index++) {
+                    if (lcycle_push(c, &tf->consts[index]) != 0)
+                        return -1;
+                }
+                break;
+            }
+            case LUA_T_USERDATA: {
+                TaggedString *ts = tsvalue(&o);
+                if (ts->u.d.tag == c->tag && ts->u.d.v && lcycle_container(c, ts, mark) != 0)
+                    return -1;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Marks the objects of the state that stay alive without the wrappers: stack,
+ * locked references, globals, tag methods and the references of the other
+ * LuaObject (owned[ref] false). The table of the references is not traversed.
+**/
+static int lcycle_roots(lcycle *c, const bool *owned, int size) {
+    lua_State *L = c->L;
+    Hash *registry = lregistry_table(L);
+    char *name = NULL;
+    bool created;
+    int tag, index, error = 0;
+    TObject *o;
+    if (registry) {
+        if (!lcycle_get(c, registry, LCYCLE_ROOT, &created))
+            return -1;
+        for (index = 1; index <= size; index++) {
+            o = luaH_getint(L, registry, index);
+            if (!owned[index] && lcycle_traverse(c, o, LCYCLE_ROOT) != 0)
+                return -1;
+        }
+    }
+    for (o = L->stack.stack; o < L->stack.top; o++) {
+        if (lcycle_traverse(c, o, LCYCLE_ROOT) != 0)
+            return -1;
+    }
+    for (index = 0; index < L->refSize; index++) {
+        if (L->refArray[index].status == LOCK && lcycle_traverse(c, &L->refArray[index].o, LCYCLE_ROOT) != 0)
+            return -1;
+    }
+    while (!error && (name = lua_nextvar(L, name))) {
+        lua_beginblock(L);
+        error = lcycle_traverse(c, lapi_address(L, lua_getresult(L, 2)), LCYCLE_ROOT);
+        lua_endblock(L);
+    }
+    for (tag = 0; !error && tag >= L->last_tag; tag--) {
+        for (index = 0; !error && lcycle_events[index]; index++) {
+            lua_beginblock(L);
+            lua_Object method = lua_gettagmethod(L, tag, lcycle_events[index]);
+            if (!lua_isnil(L, method))
+                error = lcycle_traverse(c, lapi_address(L, method), LCYCLE_ROOT);
+            lua_endblock(L);
+        }
+    }
+    return error;
+}
+
+static void lcycle_reach_free(LuaObject **wrappers, Py_ssize_t count) {
+    Py_ssize_t index;
+    for (index = 0; index < count; index++) {
+        free(wrappers[index]->reach);
+        wrappers[index]->reach = NULL;
+        wrappers[index]->nreach = 0;
+    }
+}
+
+/* Gives each wrapper the python objects of the containers reachable only from its value */
+static int lcycle_reach(lcycle *c, LuaObject **wrappers, Py_ssize_t count) {
+    size_t index;
+    Py_ssize_t windex;
+    for (index = 0; index < c->capacity; index++) {
+        if (c->entries[index].object && c->entries[index].mark >= 0)
+            wrappers[c->entries[index].mark]->nreach++;
+    }
+    for (windex = 0; windex < count; windex++) {
+        LuaObject *obj = wrappers[windex];
+        if (obj->nreach && !(obj->reach = malloc((size_t) obj->nreach * sizeof(PyObject *)))) {
+            lcycle_reach_free(wrappers, count);
+            return -1;
+        }
+        obj->nreach = 0;
+    }
+    for (index = 0; index < c->capacity; index++) {
+        lcycle_entry *entry = &c->entries[index];
+        if (entry->object && entry->mark >= 0) {
+            LuaObject *obj = wrappers[entry->mark];
+            obj->reach[obj->nreach++] = entry->object;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Sets the reach of the live wrappers of the interpreter (state acquired).
+ * The objects are borrowed: lcycle_release must be called before the state runs again.
+ * Returns the number of objects reported or -1 (Python error set).
+**/
+Py_ssize_t lcycle_attribute(InterpreterObject *interpreter) {
+    lua_State *L = interpreter->L;
+    lcycle c;
+    PyObject *key, *wref, *obj;
+    Py_ssize_t pos = 0, count = 0, index, reported = -1;
+    LuaObject **wrappers = malloc((size_t) (PyDict_Size(interpreter->wrappers) + 1) * sizeof(LuaObject *));
+    Hash *registry = lregistry_table(L);
+    int size = 0;
+    bool *owned = NULL;
+
+    memset(&c, 0, sizeof(lcycle));
+    c.L = L;
+    lua_beginblock(L);
+    c.tag = python_api_tag(L);
+    lua_endblock(L);
+    if (registry) {
+        TObject *slots = luaH_getint(L, registry, LREGISTRY_SIZE);
+        size = ttype(slots) == LUA_T_NUMBER ? (int) nvalue(slots) : 0;
+    }
+    if (!wrappers || !(owned = calloc((size_t) size + 1, sizeof(bool))))
+        goto done;
+    while (PyDict_Next(interpreter->wrappers, &pos, &key, &wref)) {
+        obj = PyWeakref_GET_OBJECT(wref);
+        if (obj == Py_None || Py_REFCNT(obj) <= 0)
+            continue;
+        wrappers[count++] = (LuaObject *) obj;
+        if (((LuaObject *) obj)->ref > 0 && ((LuaObject *) obj)->ref <= size)
+            owned[((LuaObject *) obj)->ref] = true;
+    }
+    if (lcycle_roots(&c, owned, size) != 0)
+        goto done;
+    for (index = 0; index < count; index++) {
+        TObject *o = lregistry_object(L, wrappers[index]->ref);
+        if (o && lcycle_traverse(&c, o, (int) index) != 0)
+            goto done;
+    }
+    if (lcycle_reach(&c, wrappers, count) != 0)
+        goto done;
+    reported = 0;
+    for (index = 0; index < count; index++)
+        reported += wrappers[index]->nreach;
+done:
+    if (reported < 0)
+        PyErr_NoMemory();
+    free(c.entries);
+    free(c.stack);
+    free(owned);
+    free(wrappers);
+    return reported;
+}
+
+/* Clears the reach of the live wrappers (after the collection) */
+void lcycle_release(InterpreterObject *interpreter) {
+    PyObject *key, *wref, *obj;
+    Py_ssize_t pos = 0;
+    while (PyDict_Next(interpreter->wrappers, &pos, &key, &wref)) {
+        obj = PyWeakref_GET_OBJECT(wref);
+        if (obj != Py_None) {
+            free(((LuaObject *) obj)->reach);
+            ((LuaObject *) obj)->reach = NULL;
+            ((LuaObject *) obj)->nreach = 0;
+        }
+    }
+}
+
+/**
+ * {LuaObject: (objects, ...)}: the python objects whose containers are reachable only
+ * from the value of that wrapper (candidates of cycles). State acquired.
+**/
+PyObject *lcycle_report(InterpreterObject *interpreter) {
+    PyObject *key, *wref, *obj, *report, *objects;
+    Py_ssize_t pos = 0, count = 0, index, item;
+    if (lcycle_attribute(interpreter) < 0)
+        return NULL;
+    LuaObject **wrappers = malloc((size_t) (PyDict_Size(interpreter->wrappers) + 1) * sizeof(LuaObject *));
+    if (!wrappers) {
+        lcycle_release(interpreter);
+        return PyErr_NoMemory();
+    }
+    // owned before any allocation of python objects (the collector can run)
+    while (PyDict_Next(interpreter->wrappers, &pos, &key, &wref)) {
+        obj = PyWeakref_GET_OBJECT(wref);
+        if (obj != Py_None && ((LuaObject *) obj)->nreach > 0) {
+            Py_INCREF(obj);
+            for (item = 0; item < ((LuaObject *) obj)->nreach; item++)
+                Py_INCREF(((LuaObject *) obj)->reach[item]);
+            wrappers[count++] = (LuaObject *) obj;
+        }
+    }
+    report = PyDict_New();
+    for (index = 0; index < count; index++) {
+        LuaObject *wrapper = wrappers[index];
+        objects = PyTuple_New(wrapper->nreach);
+        for (item = 0; item < wrapper->nreach; item++) {
+            if (objects) {
+                PyTuple_SET_ITEM(objects, item, wrapper->reach[item]);  // steals
+            } else {
+                Py_DECREF(wrapper->reach[item]);
+            }
+        }
+        if (report && (!objects || PyDict_SetItem(report, (PyObject *) wrapper, objects) != 0))
+            Py_CLEAR(report);
+        Py_XDECREF(objects);
+        free(wrapper->reach);
+        wrapper->reach = NULL;
+        wrapper->nreach = 0;
+        Py_DECREF(wrapper);
+    }
+    free(wrappers);
+    return report;
+}
@@ -0,0 +1,19 @@
+//
+// Created by alex on 19/10/2026.
+//
+// Cycles between the two collectors: a python object referenced by a LuaObject
+// whose table (function, ...) holds the container of that same object. The
+// containers reachable only from the table of one wrapper are reported to its
+// tp_traverse (LuaObject.reach), so the Python collector sees the whole cycle.
+
+#ifndef LUNATIC_LCYCLE_H
+#define LUNATIC_LCYCLE_H
+
+#include <Python.h>
+#include "luainpython.h"
+
+Py_ssize_t lcycle_attribute(InterpreterObject *interpreter);
+void lcycle_release(InterpreterObject *interpreter);
+PyObject *lcycle_report(InterpreterObject *interpreter);
+
+#endif //LUNATIC_LCYCLE_H
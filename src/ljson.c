@@ -0,0 +1,397 @@
+//
+// Created by alex on 19/10/2026.
+//
+// As lpack.c, the values are built as internal objects inside a single
+// block (the collector does not run while they are unreachable).
+
+#include <lua.h>
+#include <lauxlib.h>
+#include <lstring.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lshared.h"
+#include "lpack.h"
+#include "ljson.h"
+
+/*
+ * Encoder (streaming writer over the growable buffer)
+ */
+static const char *ljson_tobject(lua_State *L, lpack_buffer *buf, TObject *o, int depth);
+
+#define LJSON_PUT(buf, s) lpack_put((buf), (s), sizeof(s) - 1)
+
+static int ljson_put_string(lpack_buffer *buf, const char *s, size_t size) {
+    static const char hex[] = "0123456789abcdef";
+    size_t index, start = 0;
+    if (LJSON_PUT(buf, "\"") != 0) return -1;
+    for (index = 0; index < size; index++) {
+        unsigned char ch = (unsigned char) s[index];
+        if (ch >= 0x20 && ch != '"' && ch != '\\')
+            continue;  // run copied at once
+        if (lpack_put(buf, s + start, index - start) != 0) return -1;
+        start = index + 1;
+        switch (ch) {
+            case '"':  if (LJSON_PUT(buf, "\\\"") != 0) return -1; break;
+            case '\\': if (LJSON_PUT(buf, "\\\\") != 0) return -1; break;
+            case '\n': if (LJSON_PUT(buf, "\\n") != 0) return -1; break;
+            case '\r': if (LJSON_PUT(buf, "\\r") != 0) return -1; break;
+            case '\t': if (LJSON_PUT(buf, "\\t") != 0) return -1; break;
+            default: {
+                char escape[6] = {'\\', 'u', '0', '0', hex[ch >> 4], hex[ch & 0xF]};
+                if (lpack_put(buf, escape, sizeof(escape)) != 0) return -1;
+            }
+        }
+    }
+    if (lpack_put(buf, s + start, size - start) != 0) return -1;
+    return LJSON_PUT(buf, "\"");
+}
+
+static const char *ljson_put_number(lpack_buffer *buf, double num) {
+    char text[32];
+    int size;
+    if (num != num || num == HUGE_VAL || num == -HUGE_VAL)
+        return "number not representable (nan or inf)";
+    if (rint(num) == num && fabs(num) < 1e15) {
+        size = snprintf(text, sizeof(text), "%.0f", num);
+    } else {
+        size = snprintf(text, sizeof(text), "%.17g", num);
+    }
+    return lpack_put(buf, text, (size_t) size) == 0 ? NULL : "not enough memory";
+}
+
+/**
+ * Largest index when all the keys are integers, -1 otherwise (object).
+ * The indexes must be dense enough (half of them at least, holes as null) and
+ * the field "n" is part of the array only when it is its length.
+**/
+static int ljson_array_size(lua_State *L, Hash *hash) {
+    int index, count = 0;
+    double max = 0;
+    TObject *nfield = NULL;
+    for (index = 0; index < nhash(L, hash); index++) {
+        Node *n = node(L, hash, index);
+        TObject *key = ref(L, n);
+        if (ttype(val(L, n)) == LUA_T_NIL) continue;
+        if (ttype(key) == LUA_T_NUMBER) {
+            if (nvalue(key) < 1 || rint(nvalue(key)) != nvalue(key)) return -1;
+            if (nvalue(key) > max) max = nvalue(key);
+            count++;
+        } else if (ttype(key) == LUA_T_STRING && strcmp(svalue(key), "n") == 0) {
+            nfield = val(L, n);
+        } else {
+            return -1;
+        }
+    }
+    if (max > INT_MAX || (double) count * 2 < max)
+        return -1;  // sparse
+    if (nfield && (ttype(nfield) != LUA_T_NUMBER || nvalue(nfield) != max))
+        return -1;
+    return (int) max;
+}
+
+static const char *ljson_table(lua_State *L, lpack_buffer *buf, Hash *hash, int depth) {
+    const char *error = NULL;
+    int size = ljson_array_size(L, hash), index, count = 0;
+    if (size >= 0) {  // holes as null
+        if (LJSON_PUT(buf, "[") != 0) return "not enough memory";
+        for (index = 1; !error && index <= size; index++) {
+            if (index > 1 && LJSON_PUT(buf, ",") != 0) return "not enough memory";
+            error = ljson_tobject(L, buf, luaH_getint(L, hash, index), depth + 1);
+        }
+        return error ? error : LJSON_PUT(buf, "]") == 0 ? NULL : "not enough memory";
+    }
+    if (LJSON_PUT(buf, "{") != 0) return "not enough memory";
+    for (index = 0; !error && index < nhash(L, hash); index++) {
+        Node *n = node(L, hash, index);
+        TObject *key = ref(L, n);
+        if (ttype(val(L, n)) == LUA_T_NIL) continue;
+        if (count++ > 0 && LJSON_PUT(buf, ",") != 0) return "not enough memory";
+        if (ttype(key) == LUA_T_STRING) {
+            if (ljson_put_string(buf, svalue(key), (size_t) tsvalue(key)->u.s.len) != 0)
+                return "not enough memory";
+        } else if (ttype(key) == LUA_T_NUMBER) {  // as the text of the number
+            if (LJSON_PUT(buf, "\"") != 0) return "not enough memory";
+            if ((error = ljson_put_number(buf, nvalue(key)))) return error;
+            if (LJSON_PUT(buf, "\"") != 0) return "not enough memory";
+        } else {
+            return "table key type not supported";
+        }
+        if (LJSON_PUT(buf, ":") != 0) return "not enough memory";
+        error = ljson_tobject(L, buf, val(L, n), depth + 1);
+    }
+    return error ? error : LJSON_PUT(buf, "}") == 0 ? NULL : "not enough memory";
+}
+
+static const char *ljson_tobject(lua_State *L, lpack_buffer *buf, TObject *o, int depth) {
+    if (depth > LJSON_MAX_DEPTH) return "nesting too deep (cyclic table?)";
+    switch (ttype(o)) {
+        case LUA_T_NIL:
+            return LJSON_PUT(buf, "null") == 0 ? NULL : "not enough memory";
+        case LUA_T_NUMBER:
+            return ljson_put_number(buf, nvalue(o));
+        case LUA_T_STRING:
+            if (ljson_put_string(buf, svalue(o), (size_t) tsvalue(o)->u.s.len) != 0)
+                return "not enough memory";
+            return NULL;
+        case LUA_T_ARRAY:
+            return ljson_table(L, buf, avalue(o), depth);
+        default:
+            return "type not supported";
+    }
+}
+
+/*
+ * Decoder (recursive descent, the values created as internal objects)
+ */
+typedef struct {
+    const char *s;
+    size_t size;
+    size_t pos;
+    lpack_buffer text;  // unescaped string
+} ljson_reader;
+
+static void ljson_skip(ljson_reader *r) {
+    while (r->pos < r->size && (r->s[r->pos] == ' ' || r->s[r->pos] == '\t' ||
+                                r->s[r->pos] == '\n' || r->s[r->pos] == '\r'))
+        r->pos++;
+}
+
+static int ljson_literal(ljson_reader *r, const char *word) {
+    size_t size = strlen(word);
+    if (r->size - r->pos < size || memcmp(r->s + r->pos, word, size) != 0) return -1;
+    r->pos += size;
+    return 0;
+}
+
+static int ljson_hex(ljson_reader *r, unsigned int *code) {
+    int index;
+    *code = 0;
+    if (r->size - r->pos < 4) return -1;
+    for (index = 0; index < 4; index++) {
+        char ch = r->s[r->pos++];
+        *code <<= 4;
+        if (ch >= '0' && ch <= '9') *code |= (unsigned int) (ch - '0');
+        else if (ch >= 'a' && ch <= 'f') *code |= (unsigned int) (ch - 'a' + 10);
+        else if (ch >= 'A' && ch <= 'F') *code |= (unsigned int) (ch - 'A' + 10);
+        else return -1;
+    }
+    return 0;
+}
+
+static int ljson_put_utf8(lpack_buffer *buf, unsigned int code) {
+    char out[4];
+    size_t size;
+    if (code < 0x80) {
+        out[0] = (char) code, size = 1;
+    } else if (code < 0x800) {
+        out[0] = (char) (0xC0 | (code >> 6)), out[1] = (char) (0x80 | (code & 0x3F)), size = 2;
+    } else if (code < 0x10000) {
+        out[0] = (char) (0xE0 | (code >> 12)), out[1] = (char) (0x80 | ((code >> 6) & 0x3F));
+        out[2] = (char) (0x80 | (code & 0x3F)), size = 3;
+    } else {
+        out[0] = (char) (0xF0 | (code >> 18)), out[1] = (char) (0x80 | ((code >> 12) & 0x3F));
+        out[2] = (char) (0x80 | ((code >> 6) & 0x3F)), out[3] = (char) (0x80 | (code & 0x3F)), size = 4;
+    }
+    return lpack_put(buf, out, size);
+}
+
+/* String at the position (after the quote), unescaped in r->text */
+static const char *ljson_string(ljson_reader *r) {
+    size_t start = r->pos;
+    unsigned int code, low;
+    r->text.size = 0;
+    while (r->pos < r->size) {
+        char ch = r->s[r->pos];
+        if (ch == '"' || ch == '\\') {
+            if (lpack_put(&r->text, r->s + start, r->pos - start) != 0) return "not enough memory";
+            r->pos++;
+            if (ch == '"') return NULL;
+            if (r->pos >= r->size) break;
+            switch (r->s[r->pos++]) {
+                case '"':  ch = '"'; break;
+                case '\\': ch = '\\'; break;
+                case '/':  ch = '/'; break;
+                case 'b':  ch = '\b'; break;
+                case 'f':  ch = '\f'; break;
+                case 'n':  ch = '\n'; break;
+                case 'r':  ch = '\r'; break;
+                case 't':  ch = '\t'; break;
+                case 'u':
+                    if (ljson_hex(r, &code) != 0) return "invalid \\u escape";
+                    if (code >= 0xD800 && code <= 0xDBFF && ljson_literal(r, "\\u") == 0) {
+                        if (ljson_hex(r, &low) != 0 || low < 0xDC00 || low > 0xDFFF)
+                            return "invalid surrogate pair";
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    if (ljson_put_utf8(&r->text, code) != 0) return "not enough memory";
+                    start = r->pos;
+                    continue;
+                default:
+                    return "invalid escape";
+            }
+            if (lpack_put(&r->text, &ch, 1) != 0) return "not enough memory";
+            start = r->pos;
+        } else if ((unsigned char) ch < 0x20) {
+            return "control character in string";
+        } else {
+            r->pos++;
+        }
+    }
+    return "unterminated string";
+}
+
+static const char *ljson_value(lua_State *L, ljson_reader *r, TObject *o, int depth);
+
+static const char *ljson_array(lua_State *L, ljson_reader *r, TObject *o, int depth) {
+    const char *error;
+    TObject key, value;
+    Hash *hash = luaH_new(L, 4);
+    ttype(o) = LUA_T_ARRAY;
+    avalue(o) = hash;
+    ttype(&key) = LUA_T_NUMBER;
+    nvalue(&key) = 0;
+    ljson_skip(r);
+    if (r->pos < r->size && r->s[r->pos] == ']') {
+        r->pos++;
+        return NULL;
+    }
+    while (1) {
+        if ((error = ljson_value(L, r, &value, depth + 1))) return error;
+        nvalue(&key) += 1;
+        if (ttype(&value) != LUA_T_NIL)  // null: hole
+            *luaH_set(L, hash, &key) = value;
+        ljson_skip(r);
+        if (r->pos >= r->size) return "unterminated array";
+        if (r->s[r->pos] == ']') {
+            r->pos++;
+            return NULL;
+        }
+        if (r->s[r->pos++] != ',') return "',' or ']' expected";
+    }
+}
+
+static const char *ljson_object(lua_State *L, ljson_reader *r, TObject *o, int depth) {
+    const char *error;
+    TObject key, value;
+    Hash *hash = luaH_new(L, 4);
+    ttype(o) = LUA_T_ARRAY;
+    avalue(o) = hash;
+    ljson_skip(r);
+    if (r->pos < r->size && r->s[r->pos] == '}') {
+        r->pos++;
+        return NULL;
+    }
+    while (1) {
+        ljson_skip(r);
+        if (r->pos >= r->size || r->s[r->pos++] != '"') return "string key expected";
+        if ((error = ljson_string(r))) return error;
+        ttype(&key) = LUA_T_STRING;
+        tsvalue(&key) = luaS_newlstr(L, r->text.data ? r->text.data : "", (long) r->text.size);
+        ljson_skip(r);
+        if (r->pos >= r->size || r->s[r->pos++] != ':') return "':' expected";
+        if ((error = ljson_value(L, r, &value, depth + 1))) return error;
+        if (ttype(&value) != LUA_T_NIL)
+            *luaH_set(L, hash, &key) = value;
+        ljson_skip(r);
+        if (r->pos >= r->size) return "unterminated object";
+        if (r->s[r->pos] == '}') {
+            r->pos++;
+            return NULL;
+        }
+        if (r->s[r->pos++] != ',') return "',' or '}' expected";
+    }
+}
+
+static const char *ljson_number(ljson_reader *r, TObject *o) {
+    char text[64], *end;
+    size_t size = 0;
+    while (r->pos + size < r->size && size < sizeof(text) - 1 &&
+           strchr("+-0123456789.eE", r->s[r->pos + size]) && r->s[r->pos + size])
+        size++;
+    memcpy(text, r->s + r->pos, size);
+    text[size] = '\0';
+    ttype(o) = LUA_T_NUMBER;
+    nvalue(o) = strtod(text, &end);
+    if (size == 0 || end != text + size) return "invalid number";
+    r->pos += size;
+    return NULL;
+}
+
+static const char *ljson_value(lua_State *L, ljson_reader *r, TObject *o, int depth) {
+    const char *error;
+    if (depth > LJSON_MAX_DEPTH) return "nesting too deep";
+    ljson_skip(r);
+    if (r->pos >= r->size) return "value expected";
+    switch (r->s[r->pos]) {
+        case '{':
+            r->pos++;
+            return ljson_object(L, r, o, depth);
+        case '[':
+            r->pos++;
+            return ljson_array(L, r, o, depth);
+        case '"':
+            r->pos++;
+            if ((error = ljson_string(r))) return error;
+            ttype(o) = LUA_T_STRING;
+            tsvalue(o) = luaS_newlstr(L, r->text.data ? r->text.data : "", (long) r->text.size);
+            return NULL;
+        case 't':
+            ttype(o) = LUA_T_NUMBER;  // as the bridge converts True
+            nvalue(o) = 1;
+            return ljson_literal(r, "true") == 0 ? NULL : "invalid literal";
+        case 'f':
+            ttype(o) = LUA_T_NIL;
+            return ljson_literal(r, "false") == 0 ? NULL : "invalid literal";
+        case 'n':
+            ttype(o) = LUA_T_NIL;
+            return ljson_literal(r, "null") == 0 ? NULL : "invalid literal";
+        default:
+            return ljson_number(r, o);
+    }
+}
+
+/* python.json_encode(value): JSON text of the value (tables, strings, numbers, nil) */
+void py_json_encode(lua_State *L) {
+    lua_Object lobj = lua_getparam(L, 1);
+    const char *error;
+    lpack_buffer buf;
+    if (lobj == LUA_NOOBJECT)
+        luaL_argerror(L, 1, "value expected");
+    lpack_buffer_init(&buf);
+    if ((error = ljson_tobject(L, &buf, lapi_address(L, lobj), 0))) {
+        char message[128];
+        lpack_buffer_free(&buf);
+        snprintf(message, sizeof(message), "json_encode: %s", error);
+        lua_error(L, message);
+    }
+    lua_pushlstring(L, buf.data ? buf.data : "", (long) buf.size);
+    lpack_buffer_free(&buf);
+}
+
+/* python.json_decode(text): value of the JSON text (objects and arrays as tables, null as nil) */
+void py_json_decode(lua_State *L) {
+    lua_Object lobj = lua_getparam(L, 1);
+    const char *error;
+    ljson_reader r;
+    TObject o;
+    luaL_arg_check(L, lua_isstring(L, lobj), 1, "string expected");
+    r.s = lua_getstring(L, lobj);
+    r.size = (size_t) lua_strlen(L, lobj);
+    r.pos = 0;
+    lpack_buffer_init(&r.text);
+    if (!(error = ljson_value(L, &r, &o, 0))) {
+        ljson_skip(&r);
+        if (r.pos < r.size) error = "unexpected data after the value";
+    }
+    lpack_buffer_free(&r.text);
+    if (error) {
+        char message[128];
+        snprintf(message, sizeof(message), "json_decode: %s at position %lu", error, (unsigned long) r.pos);
+        lua_error(L, message);
+    }
+    luaA_pushobject(L, &o);
+}
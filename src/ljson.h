@@ -0,0 +1,18 @@
+//
+// Created by alex on 19/10/2026.
+//
+// JSON text directly from / to the Lua tables (internal objects), without
+// python objects: tables with only integer keys are arrays (is_indexed_array).
+
+#ifndef LUNATIC_LJSON_H
+#define LUNATIC_LJSON_H
+
+#include <lua.h>
+
+// Nesting limit (also stops tables referencing themselves)
+#define LJSON_MAX_DEPTH 200
+
+void py_json_encode(lua_State *L);
+void py_json_decode(lua_State *L);
+
+#endif //LUNATIC_LJSON_H
@@ -0,0 +1,288 @@
+//
+// Created by alex on 19/10/2026.
+//
+#include <Python.h>
+#include <lua.h>
+#include <lauxlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include "lapi.h"
+#else
+#include "lshared.h"
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "lnumeric.h"
+#include "luaconv.h"
+#include "utils.h"
+
+// 2^52: every double from here on is an integer
+#define LNUM_INTEGRAL 4503599627370496.0
+
+typedef struct {
+    char typecode;
+    Py_ssize_t itemsize;
+    bool integral;       // integer type (values checked)
+    double min, max;     // range of the integer type
+} lnum_format;
+
+/* Native struct format of one number ("d", "@i", "=q", ...), -1 if not supported */
+static int lnum_format_get(const char *format, lnum_format *f) {
+    if (*format == '@' || *format == '=')
+        format++;
+    if (!*format || format[1])
+        return -1;
+    f->typecode = *format;
+    f->integral = true;
+    switch (*format) {
+        case 'b': f->itemsize = 1, f->min = -128.0, f->max = 127.0; break;
+        case 'B': f->itemsize = 1, f->min = 0, f->max = 255.0; break;
+        case 'h': f->itemsize = sizeof(short), f->min = -32768.0, f->max = 32767.0; break;
+        case 'H': f->itemsize = sizeof(short), f->min = 0, f->max = 65535.0; break;
+        case 'i': f->itemsize = sizeof(int), f->min = -2147483648.0, f->max = 2147483647.0; break;
+        case 'I': f->itemsize = sizeof(int), f->min = 0, f->max = 4294967295.0; break;
+        case 'l': f->itemsize = sizeof(long); break;
+        case 'L': f->itemsize = sizeof(long); break;
+        case 'q': f->itemsize = sizeof(int64_t); break;
+        case 'Q': f->itemsize = sizeof(uint64_t); break;
+        case 'f': f->itemsize = sizeof(float), f->integral = false; break;
+        case 'd': f->itemsize = sizeof(double), f->integral = false; break;
+        default:
+            return -1;
+    }
+    if (*format == 'l' || *format == 'q') {
+        // the largest double below 2^63 (2^63 itself does not fit)
+        f->min = f->itemsize == 4 ? -2147483648.0 : -9223372036854775808.0;
+        f->max = f->itemsize == 4 ? 2147483647.0 : 9223372036854774784.0;
+    } else if (*format == 'L' || *format == 'Q') {
+        f->min = 0;
+        f->max = f->itemsize == 4 ? 4294967295.0 : 18446744073709549568.0;
+    }
+    return 0;
+}
+
+/* Index of the first value out of the range or not integer (2 per step with SSE2), n if none */
+static Py_ssize_t lnum_check(const double *values, Py_ssize_t n, const lnum_format *f) {
+    Py_ssize_t index = 0;
+    if (!f->integral)
+        return n;
+#if defined(__SSE2__)
+    const __m128d min = _mm_set1_pd(f->min), max = _mm_set1_pd(f->max);
+    const __m128d integral = _mm_set1_pd(LNUM_INTEGRAL), sign = _mm_set1_pd(-0.0);
+    for (; index + 2 <= n; index += 2) {
+        __m128d x = _mm_loadu_pd(values + index);
+        __m128d ax = _mm_andnot_pd(sign, x);
+        __m128d rounded = _mm_sub_pd(_mm_add_pd(ax, integral), integral);
+        __m128d ok = _mm_and_pd(_mm_cmpge_pd(x, min), _mm_cmple_pd(x, max));  // NaN fails
+        ok = _mm_and_pd(ok, _mm_or_pd(_mm_cmpeq_pd(rounded, ax), _mm_cmpge_pd(ax, integral)));
+        if (_mm_movemask_pd(ok) != 3)
+            break;
+    }
+#endif
+    for (; index < n; index++) {
+        double x = values[index], ax = x < 0 ? -x : x;
+        if (!(x >= f->min && x <= f->max) || (ax < LNUM_INTEGRAL && (ax + LNUM_INTEGRAL) - LNUM_INTEGRAL != ax))
+            break;
+    }
+    return index;
+}
+
+#define LNUM_PACK(type) do { \
+    type *o = (type *) out; \
+    for (index = 0; index < n; index++) o[index] = (type) values[index]; \
+} while (0)
+
+/* Numbers (checked) in the C type of the format */
+static void lnum_pack(const double *values, Py_ssize_t n, const lnum_format *f, void *out) {
+    Py_ssize_t index;
+    switch (f->typecode) {
+        case 'b': LNUM_PACK(signed char); break;
+        case 'B': LNUM_PACK(unsigned char); break;
+        case 'h': LNUM_PACK(short); break;
+        case 'H': LNUM_PACK(unsigned short); break;
+        case 'i': LNUM_PACK(int); break;
+        case 'I': LNUM_PACK(unsigned int); break;
+        case 'l': LNUM_PACK(long); break;
+        case 'L': LNUM_PACK(unsigned long); break;
+        case 'q': LNUM_PACK(int64_t); break;
+        case 'Q': LNUM_PACK(uint64_t); break;
+        case 'f': LNUM_PACK(float); break;
+        default: memcpy(out, values, (size_t) n * sizeof(double));
+    }
+}
+
+#define LNUM_UNPACK(type) do { \
+    const type *i = (const type *) in; \
+    for (index = 0; index < n; index++) values[index] = (double) i[index]; \
+} while (0)
+
+/* C values of the format as numbers */
+static void lnum_unpack(const void *in, Py_ssize_t n, const lnum_format *f, double *values) {
+    Py_ssize_t index;
+    switch (f->typecode) {
+        case 'b': LNUM_UNPACK(signed char); break;
+        case 'B': LNUM_UNPACK(unsigned char); break;
+        case 'h': LNUM_UNPACK(short); break;
+        case 'H': LNUM_UNPACK(unsigned short); break;
+        case 'i': LNUM_UNPACK(int); break;
+        case 'I': LNUM_UNPACK(unsigned int); break;
+        case 'l': LNUM_UNPACK(long); break;
+        case 'L': LNUM_UNPACK(unsigned long); break;
+        case 'q': LNUM_UNPACK(int64_t); break;
+        case 'Q': LNUM_UNPACK(uint64_t); break;
+        case 'f': LNUM_UNPACK(float); break;
+        default: memcpy(values, in, (size_t) n * sizeof(double));
+    }
+}
+
+/* New array.array(typecode) of 'size' zeros and its memory */
+static PyObject *lnum_array_new(const lnum_format *f, Py_ssize_t size, void **buffer) {
+    char name[2] = {f->typecode, '\0'};
+    PyObject *module = PyImport_ImportModule("array"), *zero, *array = NULL;
+    if (!module)
+        return NULL;
+    zero = PyObject_CallMethod(module, "array", "s(i)", name, 0);
+    Py_DECREF(module);
+    if (!zero)
+        return NULL;
+    array = PySequence_Repeat(zero, size);
+    Py_DECREF(zero);
+    if (!array)
+        return NULL;
+#if PY_MAJOR_VERSION < 3
+    Py_ssize_t len;
+    if (PyObject_AsWriteBuffer(array, buffer, &len) != 0) {
+        Py_DECREF(array);
+        return NULL;
+    }
+#else
+    Py_buffer view;
+    if (PyObject_GetBuffer(array, &view, PyBUF_WRITABLE) != 0) {
+        Py_DECREF(array);
+        return NULL;
+    }
+    *buffer = view.buf;  // the array is not resized before it is filled
+    PyBuffer_Release(&view);
+#endif
+    return array;
+}
+
+/**
+ * Converts the dense numeric table to array.array(typecode). The values are read
+ * in one pass, checked (integer types) and written to the array without python numbers.
+ * Returns NULL with the Python error set.
+ **/
+PyObject *lnum_table_array(lua_State *L, Hash *hash, const char *typecode) {
+    lnum_format f;
+    if (lnum_format_get(typecode, &f) != 0 || f.typecode == 'q' || f.typecode == 'Q') {
+        // q/Q: buffers only (array.array of Python 2 has no 64-bit typecode)
+        PyErr_Format(PyExc_ValueError, "typecode \"%.20s\" not supported", typecode);
+        return NULL;
+    }
+    int size = lraw_array_size(L, hash), index;
+    if (size < 0) {
+        PyErr_SetString(PyExc_TypeError, "array expected (table with the keys 1..n)");
+        return NULL;
+    }
+    double *values = malloc((size_t) (size ? size : 1) * sizeof(double));
+    if (!values)
+        return PyErr_NoMemory();
+    for (index = 0; index < size; index++) {
+        TObject *o = luaH_getint(L, hash, index + 1);
+        if (ttype(o) != LUA_T_NUMBER)
+            break;
+        values[index] = nvalue(o);
+    }
+    PyObject *array = NULL;
+    void *buffer;
+    Py_ssize_t bad = index < size ? index : lnum_check(values, size, &f);
+    if (index < size) {
+        PyErr_Format(PyExc_TypeError, "number expected at index %d", index + 1);
+    } else if (bad < size) {
+        PyErr_Format(PyExc_ValueError, "value at index %zd does not fit the typecode \"%c\"",
+                     bad + 1, f.typecode);
+    } else if ((array = lnum_array_new(&f, size, &buffer)) && size > 0) {
+        lnum_pack(values, size, &f, buffer);
+    }
+    free(values);
+    return array;
+}
+
+/* Contiguous buffer of the object and its format (old buffers of Python 2 by the typecode) */
+static int lnum_buffer_get(PyObject *obj, Py_buffer *view, lnum_format *f) {
+    const char *format = "B";
+    PyObject *typecode = NULL;
+    if (PyObject_CheckBuffer(obj)) {
+        if (PyObject_GetBuffer(obj, view, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) != 0)
+            return -1;
+        if (view->format)
+            format = view->format;
+    } else {
+#if PY_MAJOR_VERSION < 3
+        const void *buffer;
+        Py_ssize_t len;
+        if (PyObject_AsReadBuffer(obj, &buffer, &len) != 0)
+            return -1;
+        if ((typecode = PyObject_GetAttrString(obj, "typecode")) && PyString_Check(typecode)) {
+            format = PyString_AS_STRING(typecode);
+        } else {
+            PyErr_Clear();
+        }
+        memset(view, 0, sizeof(Py_buffer));
+        view->buf = (void *) buffer;
+        view->len = len;
+#else
+        PyErr_SetString(PyExc_TypeError, "buffer expected");
+        return -1;
+#endif
+    }
+    if (lnum_format_get(format, f) != 0) {
+        PyErr_Format(PyExc_ValueError, "buffer format \"%.20s\" not supported", format);
+        Py_XDECREF(typecode);
+        if (view->obj) PyBuffer_Release(view);
+        return -1;
+    }
+    Py_XDECREF(typecode);
+    return 0;
+}
+
+/* python.fromarray(buffer): new table {1..n} with the numbers of the buffer */
+void py_fromarray(lua_State *L) {
+    lua_Object lobj = lua_getparam(L, 1);
+    if (!is_object_container(L, lobj))
+        luaL_argerror(L, 1, "python buffer expected");
+    PyObject *obj = get_py_object(L, lobj)->object;
+    Py_buffer view;
+    lnum_format f;
+    if (lnum_buffer_get(obj, &view, &f) != 0)
+        lua_raise_error(L, "failed to read the buffer of \"%s\"", obj);
+    Py_ssize_t size = view.len / f.itemsize, index;
+    double *values = f.typecode == 'd' ? (double *) view.buf :
+                     malloc((size_t) (size ? size : 1) * sizeof(double));
+    if (!values) {
+        if (view.obj) PyBuffer_Release(&view);
+        lua_error(L, "out of memory");
+    }
+    if (values != (double *) view.buf)
+        lnum_unpack(view.buf, size, &f, values);
+    TObject table, key;
+    Hash *hash = luaH_new(L, (int) size);
+    ttype(&table) = LUA_T_ARRAY;
+    avalue(&table) = hash;
+    luaA_pushobject(L, &table);  // result (reachable by the collector)
+    ttype(&key) = LUA_T_NUMBER;
+    for (index = 0; index < size; index++) {
+        nvalue(&key) = (double) (index + 1);
+        TObject *value = luaH_set(L, hash, &key);
+        ttype(value) = LUA_T_NUMBER;
+        nvalue(value) = values[index];
+    }
+    if (values != (double *) view.buf)
+        free(values);
+    if (view.obj) PyBuffer_Release(&view);
+}
@@ -0,0 +1,18 @@
+//
+// Created by alex on 19/10/2026.
+//
+// Bulk conversion of dense numeric tables (keys 1..n, numbers only) to and
+// from the Python buffers (array.array, LuaArray, numpy, ...), without one
+// python number per element.
+
+#ifndef LUNATIC_LNUMERIC_H
+#define LUNATIC_LNUMERIC_H
+
+#include <Python.h>
+#include <lua.h>
+#include "ltable.h"
+
+PyObject *lnum_table_array(lua_State *L, Hash *hash, const char *typecode);
+void py_fromarray(lua_State *L);
+
+#endif //LUNATIC_LNUMERIC_H
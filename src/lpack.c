@@ -0,0 +1,530 @@
+//
+// Created by alex on 19/10/2026.
+//
+// The Lua side works on the internal objects (TObject), without the C stack
+// of the API: tables of any size are converted inside a single block and
+// the collector does not run while the new values are unreachable.
+
+#include <Python.h>
+#include <lua.h>
+#include <lauxlib.h>
+#include <lstring.h>
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <errno.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "lshared.h"
+#include "lpack.h"
+#include "luaconv.h"
+#include "lcleanup.h"
+#include "utils.h"
+
+void lpack_buffer_init(lpack_buffer *buf) {
+    buf->data = NULL;
+    buf->size = 0;
+    buf->capacity = 0;
+}
+
+void lpack_buffer_free(lpack_buffer *buf) {
+    free(buf->data);
+    lpack_buffer_init(buf);
+}
+
+/* Returns zero on success (-1 out of memory) */
+int lpack_put(lpack_buffer *buf, const void *data, size_t size) {
+    if (buf->size + size > buf->capacity) {
+        size_t capacity = buf->capacity ? buf->capacity : 256;
+        while (capacity < buf->size + size) capacity *= 2;
+        char *block = realloc(buf->data, capacity);
+        if (!block) return -1;
+        buf->data = block;
+        buf->capacity = capacity;
+    }
+    memcpy(buf->data + buf->size, data, size);
+    buf->size += size;
+    return 0;
+}
+
+static int lpack_put_tag(lpack_buffer *buf, char tag) {
+    return lpack_put(buf, &tag, 1);
+}
+
+static int lpack_put_count(lpack_buffer *buf, char tag, size_t count) {
+    uint32_t n = (uint32_t) count;
+    return lpack_put_tag(buf, tag) || lpack_put(buf, &n, sizeof(n));
+}
+
+static int lpack_put_number(lpack_buffer *buf, double num) {
+    return lpack_put_tag(buf, LPACK_NUMBER) || lpack_put(buf, &num, sizeof(num));
+}
+
+static int lpack_put_string(lpack_buffer *buf, const char *s, size_t size) {
+    return lpack_put_count(buf, LPACK_STRING, size) || lpack_put(buf, s, size);
+}
+
+void lpack_reader_init(lpack_reader *reader, const char *data, size_t size) {
+    reader->data = data;
+    reader->size = size;
+    reader->pos = 0;
+}
+
+/* Returns the next 'size' bytes (NULL past the end) */
+const char *lpack_get(lpack_reader *reader, size_t size) {
+    const char *data;
+    if (reader->size - reader->pos < size) return NULL;
+    data = reader->data + reader->pos;
+    reader->pos += size;
+    return data;
+}
+
+static int lpack_get_count(lpack_reader *reader, uint32_t *count) {
+    const char *data = lpack_get(reader, sizeof(*count));
+    if (!data) return -1;
+    memcpy(count, data, sizeof(*count));
+    return 0;
+}
+
+/*
+ * Python
+ */
+static int lpack_python_value(lpack_buffer *buf, PyObject *obj, int depth) {
+    Py_ssize_t index, size;
+    PyObject *key, *value;
+    int status = 0;
+    if (depth > LPACK_MAX_DEPTH) {
+        PyErr_SetString(PyExc_ValueError, "pack: nesting too deep");
+        return -1;
+    }
+    if (obj == Py_None || obj == Py_False) {
+        status = lpack_put_tag(buf, LPACK_NIL);
+    } else if (obj == Py_True) {
+        status = lpack_put_number(buf, 1);
+    } else if (PyInt_Check(obj)) {
+        status = lpack_put_number(buf, (double) PyInt_AS_LONG(obj));
+    } else if (PyLong_Check(obj) || PyFloat_Check(obj)) {
+        double num = PyFloat_AsDouble(obj);
+        if (num == -1.0 && PyErr_Occurred()) return -1;
+        status = lpack_put_number(buf, num);
+    } else if (PyString_Check(obj)) {
+        status = lpack_put_string(buf, PyString_AS_STRING(obj), (size_t) PyString_GET_SIZE(obj));
+    } else if (PyUnicode_Check(obj)) {
+        PyObject *str = PyUnicode_AsUTF8String(obj);
+        if (!str) return -1;
+        status = lpack_put_string(buf, PyString_AS_STRING(str), (size_t) PyString_GET_SIZE(str));
+        Py_DECREF(str);
+    } else if (PyList_Check(obj) || PyTuple_Check(obj)) {
+        size = PySequence_Fast_GET_SIZE(obj);
+        if (lpack_put_count(buf, LPACK_ARRAY, (size_t) size) != 0) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        for (index = 0; index < size; index++) {
+            if (lpack_python_value(buf, PySequence_Fast_GET_ITEM(obj, index), depth + 1) != 0)
+                return -1;
+        }
+        return 0;
+    } else if (PyDict_Check(obj)) {
+        if (lpack_put_count(buf, LPACK_HASH, (size_t) PyDict_Size(obj)) != 0) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        index = 0;
+        while (PyDict_Next(obj, &index, &key, &value)) {
+            if (key == Py_None || key == Py_False) {
+                PyErr_SetString(PyExc_ValueError, "pack: nil can't be a table key");
+                return -1;
+            }
+            if (lpack_python_value(buf, key, depth + 1) != 0 ||
+                lpack_python_value(buf, value, depth + 1) != 0)
+                return -1;
+        }
+        return 0;
+    } else {
+        PyErr_Format(PyExc_TypeError, "pack: type '%s' not supported", Py_TYPE(obj)->tp_name);
+        return -1;
+    }
+    if (status != 0) PyErr_NoMemory();
+    return status;
+}
+
+/* Appends the encoded object. Returns -1 with the Python error set. */
+int lpack_python(lpack_buffer *buf, PyObject *obj) {
+    return lpack_python_value(buf, obj, 0);
+}
+
+static PyObject *lunpack_python_value(lpack_reader *reader, int depth) {
+    const char *tag = lpack_get(reader, 1), *data;
+    PyObject *ret = NULL, *key, *value;
+    uint32_t count, index;
+    double num;
+    if (!tag || depth > LPACK_MAX_DEPTH) {
+        PyErr_SetString(PyExc_ValueError, "unpack: invalid data");
+        return NULL;
+    }
+    switch (*tag) {
+        case LPACK_NIL:
+            Py_INCREF(Py_None);
+            return Py_None;
+        case LPACK_NUMBER:
+            if (!(data = lpack_get(reader, sizeof(num)))) break;
+            memcpy(&num, data, sizeof(num));
+            return lua_number_convert(num);
+        case LPACK_STRING:
+            if (lpack_get_count(reader, &count) != 0 || !(data = lpack_get(reader, count))) break;
+            return PyString_FromStringAndSize(data, count);
+        case LPACK_ARRAY:
+            if (lpack_get_count(reader, &count) != 0 || count > reader->size - reader->pos) break;
+            if (!(ret = PyTuple_New(count))) return NULL;
+            for (index = 0; index < count; index++) {
+                if (!(value = lunpack_python_value(reader, depth + 1))) {
+                    Py_DECREF(ret);
+                    return NULL;
+                }
+                PyTuple_SET_ITEM(ret, index, value);
+            }
+            return ret;
+        case LPACK_HASH:
+            if (lpack_get_count(reader, &count) != 0) break;
+            if (!(ret = PyDict_New())) return NULL;
+            for (index = 0; index < count; index++) {
+                if (!(key = lunpack_python_value(reader, depth + 1))) {
+                    Py_DECREF(ret);
+                    return NULL;
+                }
+                value = lunpack_python_value(reader, depth + 1);
+                if (!value || PyDict_SetItem(ret, key, value) != 0) {
+                    Py_DECREF(key);
+                    Py_XDECREF(value);
+                    Py_DECREF(ret);
+                    return NULL;
+                }
+                Py_DECREF(key);
+                Py_DECREF(value);
+            }
+            return ret;
+        default:
+            break;
+    }
+    PyErr_SetString(PyExc_ValueError, "unpack: invalid data");
+    return NULL;
+}
+
+/* Decodes the next value (arrays as tuples, hashes as dicts) */
+PyObject *lunpack_python(lpack_reader *reader) {
+    return lunpack_python_value(reader, 0);
+}
+
+/*
+ * Lua
+ */
+static const char *lpack_tobject(lua_State *L, lpack_buffer *buf, TObject *o, int depth);
+
+static const char *lpack_table(lua_State *L, lpack_buffer *buf, Hash *hash, int depth) {
+    const char *error = NULL;
+    int count = lraw_array_size(L, hash), i;
+    if (count >= 0) {
+        if (lpack_put_count(buf, LPACK_ARRAY, (size_t) count) != 0) return "not enough memory";
+        for (i = 1; !error && i <= count; i++) {
+            error = lpack_tobject(L, buf, luaH_getint(L, hash, i), depth + 1);
+        }
+        return error;
+    }
+    count = 0;
+    for (i = 0; i < nhash(L, hash); i++) {
+        if (ttype(val(L, node(L, hash, i))) != LUA_T_NIL) count++;
+    }
+    if (lpack_put_count(buf, LPACK_HASH, (size_t) count) != 0) return "not enough memory";
+    for (i = 0; !error && i < nhash(L, hash); i++) {
+        Node *n = node(L, hash, i);
+        if (ttype(val(L, n)) == LUA_T_NIL) continue;
+        if (!(error = lpack_tobject(L, buf, ref(L, n), depth + 1))) {
+            error = lpack_tobject(L, buf, val(L, n), depth + 1);
+        }
+    }
+    return error;
+}
+
+static const char *lpack_tobject(lua_State *L, lpack_buffer *buf, TObject *o, int depth) {
+    int status;
+    if (depth > LPACK_MAX_DEPTH) return "nesting too deep";
+    switch (ttype(o)) {
+        case LUA_T_NIL:
+            status = lpack_put_tag(buf, LPACK_NIL);
+            break;
+        case LUA_T_NUMBER:
+            status = lpack_put_number(buf, nvalue(o));
+            break;
+        case LUA_T_STRING:
+            status = lpack_put_string(buf, svalue(o), (size_t) tsvalue(o)->u.s.len);
+            break;
+        case LUA_T_ARRAY:
+            return lpack_table(L, buf, avalue(o), depth);
+        default:
+            return "type not supported";
+    }
+    return status == 0 ? NULL : "not enough memory";
+}
+
+/* Appends the encoded object. Returns the error message or NULL. */
+const char *lpack_lua(lua_State *L, lpack_buffer *buf, lua_Object lobj) {
+    return lpack_tobject(L, buf, lapi_address(L, lobj), 0);
+}
+
+static const char *lunpack_tobject(lua_State *L, lpack_reader *reader, TObject *o, int depth) {
+    const char *tag = lpack_get(reader, 1), *data, *error;
+    uint32_t count, index;
+    TObject key, value;
+    Hash *hash;
+    if (!tag || depth > LPACK_MAX_DEPTH) return "invalid data";
+    switch (*tag) {
+        case LPACK_NIL:
+            ttype(o) = LUA_T_NIL;
+            return NULL;
+        case LPACK_NUMBER:
+            if (!(data = lpack_get(reader, sizeof(nvalue(o))))) break;
+            ttype(o) = LUA_T_NUMBER;
+            memcpy(&nvalue(o), data, sizeof(nvalue(o)));
+            return NULL;
+        case LPACK_STRING:
+            if (lpack_get_count(reader, &count) != 0 || !(data = lpack_get(reader, count))) break;
+            ttype(o) = LUA_T_STRING;
+            tsvalue(o) = luaS_newlstr(L, (char *) data, count);
+            return NULL;
+        case LPACK_ARRAY:
+            if (lpack_get_count(reader, &count) != 0 || count > reader->size - reader->pos) break;
+            hash = luaH_new(L, (int) count);
+            ttype(o) = LUA_T_ARRAY;
+            avalue(o) = hash;
+            ttype(&key) = LUA_T_NUMBER;
+            for (index = 0; index < count; index++) {
+                if ((error = lunpack_tobject(L, reader, &value, depth + 1))) return error;
+                if (ttype(&value) == LUA_T_NIL) continue;
+                nvalue(&key) = index + 1;
+                *luaH_set(L, hash, &key) = value;
+            }
+            return NULL;
+        case LPACK_HASH:
+            if (lpack_get_count(reader, &count) != 0 || count > reader->size - reader->pos) break;
+            hash = luaH_new(L, (int) count);
+            ttype(o) = LUA_T_ARRAY;
+            avalue(o) = hash;
+            for (index = 0; index < count; index++) {
+                if ((error = lunpack_tobject(L, reader, &key, depth + 1)) ||
+                    (error = lunpack_tobject(L, reader, &value, depth + 1)))
+                    return error;
+                if (ttype(&key) == LUA_T_NIL) return "invalid data";
+                if (ttype(&value) == LUA_T_NIL) continue;
+                *luaH_set(L, hash, &key) = value;
+            }
+            return NULL;
+        default:
+            break;
+    }
+    return "invalid data";
+}
+
+/**
+ * Decodes the next value and pushes it (as lua_push*).
+ * Returns the error message or NULL.
+**/
+const char *lunpack_lua(lua_State *L, lpack_reader *reader) {
+    TObject o;
+    const char *error = lunpack_tobject(L, reader, &o, 0);
+    if (!error) luaA_pushobject(L, &o);
+    return error;
+}
+
+/*
+ * Snapshots
+ */
+int lpack_header(lpack_buffer *buf) {
+    char header[LPACK_HEADER_SIZE] = {LPACK_MAGIC[0], LPACK_MAGIC[1], LPACK_MAGIC[2], LPACK_VERSION};
+    return lpack_put(buf, header, sizeof(header));
+}
+
+/* Checks the header of the snapshot. Returns the error message or NULL. */
+const char *lunpack_header(lpack_reader *reader) {
+    const char *header = lpack_get(reader, LPACK_HEADER_SIZE);
+    if (!header || memcmp(header, LPACK_MAGIC, sizeof(LPACK_MAGIC) - 1) != 0)
+        return "not a packed snapshot";
+    if (header[3] != LPACK_VERSION)
+        return "snapshot version not supported";
+    return NULL;
+}
+
+/* Reader over the bytes of the object (str, bytearray, mmap, ...). Returns -1 with the Python error set. */
+int lpack_reader_buffer(lpack_reader *reader, PyObject *obj, Py_buffer *view) {
+    view->obj = NULL;
+    if (PyObject_CheckBuffer(obj)) {
+        if (PyObject_GetBuffer(obj, view, PyBUF_SIMPLE) != 0)
+            return -1;
+        lpack_reader_init(reader, view->buf, (size_t) view->len);
+        return 0;
+    }
+#if PY_MAJOR_VERSION < 3
+    const void *data;
+    Py_ssize_t size;
+    if (PyObject_AsReadBuffer(obj, &data, &size) != 0)
+        return -1;
+    lpack_reader_init(reader, data, (size_t) size);
+    return 0;
+#else
+    PyErr_SetString(PyExc_TypeError, "buffer expected");
+    return -1;
+#endif
+}
+
+void lpack_reader_release(Py_buffer *view) {
+    if (view->obj) PyBuffer_Release(view);
+}
+
+/**
+ * Maps the file (read only) in the reader: the snapshot is decoded straight
+ * from the pages of the file. Returns -1 with errno set.
+ **/
+int lpack_reader_map(lpack_reader *reader, const char *path) {
+#ifndef _WIN32
+    struct stat st;
+    void *data = NULL;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (st.st_size > 0) {
+        data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+        posix_madvise(data, (size_t) st.st_size, POSIX_MADV_SEQUENTIAL);  // one pass
+    }
+    close(fd);
+    lpack_reader_init(reader, data, (size_t) st.st_size);
+    return 0;
+#else
+    FILE *file = fopen(path, "rb");
+    long size;
+    char *data;
+    if (!file)
+        return -1;
+    if (fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < 0 ||
+        fseek(file, 0, SEEK_SET) != 0 || !(data = malloc(size ? (size_t) size : 1))) {
+        fclose(file);
+        return -1;
+    }
+    if (fread(data, 1, (size_t) size, file) != (size_t) size) {
+        free(data);
+        fclose(file);
+        return -1;
+    }
+    fclose(file);
+    lpack_reader_init(reader, data, (size_t) size);
+    return 0;
+#endif
+}
+
+void lpack_reader_unmap(lpack_reader *reader) {
+#ifndef _WIN32
+    if (reader->size > 0) munmap((void *) reader->data, reader->size);
+#else
+    free((void *) reader->data);
+#endif
+    lpack_reader_init(reader, NULL, 0);
+}
+
+static void lpack_error(lua_State *L, const char *prefix, const char *error) {
+    char message[256];
+    snprintf(message, sizeof(message), "%s: %s", prefix, error);
+    lua_error(L, message);
+}
+
+/* python.pack(value): snapshot (string) of the value (Lua value or python container) */
+void py_pack(lua_State *L) {
+    lua_Object lobj = lua_getparam(L, 1);
+    const char *error = NULL;
+    lpack_buffer buf;
+    if (lobj == LUA_NOOBJECT)
+        luaL_argerror(L, 1, "value expected");
+    lpack_buffer_init(&buf);
+    if (lpack_header(&buf) != 0) {
+        error = "not enough memory";
+    } else if (is_object_container(L, lobj)) {
+        PyObject *obj = get_pobject(L, lobj);
+        if (lpack_python(&buf, obj) != 0) {
+            lpack_buffer_free(&buf);
+            lua_raise_error(L, "pack: failed to encode \"%s\"", obj);
+        }
+    } else {
+        error = lpack_lua(L, &buf, lobj);
+    }
+    if (error) {
+        lpack_buffer_free(&buf);
+        lpack_error(L, "pack", error);
+    }
+    lua_pushlstring(L, buf.data, (long) buf.size);
+    lpack_buffer_free(&buf);
+}
+
+/* python.unpack(snapshot): value of the snapshot (string or python buffer, e.g. mmap) */
+void py_unpack(lua_State *L) {
+    lua_Object lobj = lua_getparam(L, 1);
+    lpack_reader reader;
+    Py_buffer view;
+    const char *error;
+    view.obj = NULL;
+    if (lua_isstring(L, lobj) && !lua_isnumber(L, lobj)) {
+        lpack_reader_init(&reader, lua_getstring(L, lobj), (size_t) lua_strlen(L, lobj));
+    } else if (is_object_container(L, lobj)) {
+        if (lpack_reader_buffer(&reader, get_pobject(L, lobj), &view) != 0)
+            lua_raise_error(L, "unpack: \"%s\" is not a buffer", get_pobject(L, lobj));
+    } else {
+        luaL_argerror(L, 1, "string or python buffer expected");
+    }
+    if (!(error = lunpack_header(&reader)))
+        error = lunpack_lua(L, &reader);
+    lpack_reader_release(&view);
+    if (error) lpack_error(L, "unpack", error);
+}
+
+static void lpack_mapping_release(PyObject *capsule) {
+    lpack_reader *reader = PyCapsule_GetPointer(capsule, "lpack_reader");
+    lpack_reader_unmap(reader);
+    free(reader);
+}
+
+/* python.unpack_file(path): value of the snapshot file (memory mapped) */
+void py_unpack_file(lua_State *L) {
+    char *path = luaL_check_string(L, 1);
+    lpack_reader *reader = malloc(sizeof(lpack_reader));
+    const char *error;
+    if (!reader)
+        lua_error(L, "unpack_file: not enough memory");
+    if (lpack_reader_map(reader, path) != 0) {
+        error = strerror(errno);
+        free(reader);
+        lpack_error(L, "unpack_file", error);
+    }
+    PyObject *mapping = PyCapsule_New(reader, "lpack_reader", lpack_mapping_release);
+    if (!mapping) {
+        PyErr_Clear();
+        lpack_reader_unmap(reader);
+        free(reader);
+        lua_error(L, "unpack_file: not enough memory");
+    }
+    // unmapped when the function returns, also when the decoding raises a Lua error
+    lua_cleanup_push(L, mapping);
+    if (!(error = lunpack_header(reader)))
+        error = lunpack_lua(L, reader);
+    if (error) lpack_error(L, "unpack_file", error);
+}
@@ -0,0 +1,63 @@
+//
+// Created by alex on 19/10/2026.
+//
+// Compact binary encoding of the values converted by the bridge:
+// nil, numbers, strings, array tables and hash tables.
+
+#ifndef LUNATIC_LPACK_H
+#define LUNATIC_LPACK_H
+
+#include <Python.h>
+#include <lua.h>
+#include <stddef.h>
+
+#define LPACK_NIL 'n'
+#define LPACK_NUMBER 'd'   // double
+#define LPACK_STRING 's'   // uint32 size + bytes
+#define LPACK_ARRAY 'a'    // uint32 count + values (t[1] .. t[count])
+#define LPACK_HASH 'h'     // uint32 count + key/value pairs
+
+// Nesting limit (also stops tables referencing themselves)
+#define LPACK_MAX_DEPTH 200
+
+// Header of the snapshots (python.pack / Interpreter.pack): magic + format version
+#define LPACK_MAGIC "LPK"
+#define LPACK_VERSION 1
+#define LPACK_HEADER_SIZE 4
+
+typedef struct {
+    char *data;
+    size_t size;
+    size_t capacity;
+} lpack_buffer;
+
+typedef struct {
+    const char *data;
+    size_t size;
+    size_t pos;
+} lpack_reader;
+
+void lpack_buffer_init(lpack_buffer *buf);
+void lpack_buffer_free(lpack_buffer *buf);
+int lpack_put(lpack_buffer *buf, const void *data, size_t size);
+const char *lpack_get(lpack_reader *reader, size_t size);
+void lpack_reader_init(lpack_reader *reader, const char *data, size_t size);
+
+int lpack_python(lpack_buffer *buf, PyObject *obj);
+PyObject *lunpack_python(lpack_reader *reader);
+
+const char *lpack_lua(lua_State *L, lpack_buffer *buf, lua_Object lobj);
+const char *lunpack_lua(lua_State *L, lpack_reader *reader);
+
+int lpack_header(lpack_buffer *buf);
+const char *lunpack_header(lpack_reader *reader);
+int lpack_reader_buffer(lpack_reader *reader, PyObject *obj, Py_buffer *view);
+void lpack_reader_release(Py_buffer *view);
+int lpack_reader_map(lpack_reader *reader, const char *path);
+void lpack_reader_unmap(lpack_reader *reader);
+
+void py_pack(lua_State *L);
+void py_unpack(lua_State *L);
+void py_unpack_file(lua_State *L);
+
+#endif //LUNATIC_LPACK_H
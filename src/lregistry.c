@@ -0,0 +1,103 @@
+//
+// Created by alex on 19/10/2026.
+//
+#include <Python.h>
+#include <lua.h>
+#include <lstring.h>
+
+#if defined(_WIN32)
+#include "lapi.h"
+#else
+#include "lshared.h"
+#endif
+
+#include "lregistry.h"
+#include "constants.h"
+#include "utils.h"
+
+/* Table of the references (reachable by the collector through the api python) */
+Hash *lregistry_table(lua_State *L) {
+    TObject *python = &luaS_new(L, PY_API_NAME)->u.s.globalval, key, *registry;
+    if (ttype(python) != LUA_T_ARRAY)
+        return NULL;
+    ttype(&key) = LUA_T_STRING;
+    tsvalue(&key) = luaS_new(L, PY_REF_REGISTRY);
+    registry = luaH_get(L, avalue(python), &key);
+    return ttype(registry) == LUA_T_ARRAY ? avalue(registry) : NULL;
+}
+
+/* Number stored in the slot (zero if not a number) */
+static int lregistry_slot(lua_State *L, Hash *hash, int slot) {
+    TObject *o = luaH_getint(L, hash, slot);
+    return ttype(o) == LUA_T_NUMBER ? (int) nvalue(o) : 0;
+}
+
+static void lregistry_setslot(lua_State *L, Hash *hash, int slot, TObject *value) {
+    TObject key;
+    ttype(&key) = LUA_T_NUMBER;
+    nvalue(&key) = slot;
+    *luaH_set(L, hash, &key) = *value;  // value is copied before the rehash
+}
+
+/* Creates the table of the references in the api python (kept by reset) */
+void lregistry_open(lua_State *L, lua_Object python) {
+    lua_Object registry = lua_createtable(L);
+    set_table_object(L, python, PY_REF_REGISTRY, registry);
+}
+
+/**
+ * Reference of the object (like lua_ref(L, 1)): the last released slot or a new one.
+ * Returns LREGISTRY_REFNIL for nil.
+**/
+int lregistry_ref(lua_State *L, lua_Object lobj) {
+    Hash *hash;
+    TObject value, next;
+    int ref;
+    if (lobj == LUA_NOOBJECT || lua_isnil(L, lobj) || !(hash = lregistry_table(L)))
+        return LREGISTRY_REFNIL;
+    value = *lapi_address(L, lobj);
+    ttype(&next) = LUA_T_NUMBER;
+    if ((ref = lregistry_slot(L, hash, LREGISTRY_FREE)) > 0) {
+        // pop: the free slot holds the one below it
+        nvalue(&next) = lregistry_slot(L, hash, ref);
+        lregistry_setslot(L, hash, LREGISTRY_FREE, &next);
+    } else {
+        ref = lregistry_slot(L, hash, LREGISTRY_SIZE) + 1;
+        nvalue(&next) = ref;
+        lregistry_setslot(L, hash, LREGISTRY_SIZE, &next);
+    }
+    lregistry_setslot(L, hash, ref, &value);
+    return ref;
+}
+
+/* Slot of the reference (NULL if there is none) */
+TObject *lregistry_object(lua_State *L, int ref) {
+    Hash *hash;
+    TObject *o;
+    if (ref <= 0 || !(hash = lregistry_table(L)))
+        return NULL;
+    o = luaH_getint(L, hash, ref);
+    return ttype(o) == LUA_T_NIL ? NULL : o;
+}
+
+/* Object of the reference (like lua_getref), LUA_NOOBJECT if there is none */
+lua_Object lregistry_get(lua_State *L, int ref) {
+    TObject *o = lregistry_object(L, ref);
+    if (!o)
+        return LUA_NOOBJECT;
+    luaA_pushobject(L, o);
+    return lua_pop(L);
+}
+
+/* Releases the object of the reference: its slot goes to the top of the free stack */
+void lregistry_unref(lua_State *L, int ref) {
+    Hash *hash;
+    TObject top;
+    if (ref <= 0 || !(hash = lregistry_table(L)))
+        return;
+    ttype(&top) = LUA_T_NUMBER;
+    nvalue(&top) = lregistry_slot(L, hash, LREGISTRY_FREE);
+    lregistry_setslot(L, hash, ref, &top);
+    nvalue(&top) = ref;
+    lregistry_setslot(L, hash, LREGISTRY_FREE, &top);
+}
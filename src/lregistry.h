@@ -0,0 +1,27 @@
+//
+// Created by alex on 19/10/2026.
+//
+// References of the LuaObject wrappers: a table of the state (python._refs)
+// with a free stack threaded through its slots, so that taking and releasing
+// a reference is constant time (lua_ref searches the whole array of refs).
+
+#ifndef LUNATIC_LREGISTRY_H
+#define LUNATIC_LREGISTRY_H
+
+#include <lua.h>
+
+// Slots with the top of the free stack and the number of slots created
+#define LREGISTRY_FREE 0
+#define LREGISTRY_SIZE (-1)
+
+// Reference of nil (or without the registry), lua_getref returns LUA_NOOBJECT
+#define LREGISTRY_REFNIL (-1)
+
+void lregistry_open(lua_State *L, lua_Object python);
+struct Hash *lregistry_table(lua_State *L);
+struct TObject *lregistry_object(lua_State *L, int ref);
+int lregistry_ref(lua_State *L, lua_Object lobj);
+lua_Object lregistry_get(lua_State *L, int ref);
+void lregistry_unref(lua_State *L, int ref);
+
+#endif //LUNATIC_LREGISTRY_H
@@ -2,6 +2,8 @@
 // Created by alex on 08/05/2016.
 //
 
+#include <math.h>
+#include <string.h>
 #include "lshared.h"
 
 /* lua next optimized */
@@ -17,4 +19,33 @@ int lraw_next(lua_State *L, lua_Object lobj, int index, Node **n) {
         index++;
     }
     return 0;  /* no more elements */
-}
\ No newline at end of file
+}
+
+/**
+ * Number of elements when the keys are 1..n, -1 otherwise.
+ * The field "n" (tinsert, varargs) is part of the array only when it is that size.
+**/
+int lraw_array_size(lua_State *L, Hash *hash) {
+    int index, size = 0;
+    double max = 0;
+    TObject *nfield = NULL;
+    for (index = 0; index < nhash(L, hash); index++) {
+        Node *n = node(L, hash, index);
+        TObject *key = ref(L, n);
+        if (ttype(val(L, n)) == LUA_T_NIL) continue;
+        if (ttype(key) == LUA_T_NUMBER) {
+            if (nvalue(key) < 1 || rint(nvalue(key)) != nvalue(key)) return -1;
+            if (nvalue(key) > max) max = nvalue(key);
+            size++;
+        } else if (ttype(key) == LUA_T_STRING && strcmp(svalue(key), "n") == 0) {
+            nfield = val(L, n);
+        } else {
+            return -1;
+        }
+    }
+    if (max != size)  // unique keys
+        return -1;
+    if (nfield && (ttype(nfield) != LUA_T_NUMBER || nvalue(nfield) != size))
+        return -1;  // the "n" is data (kept by the hash)
+    return size;
+}
@@ -9,6 +9,10 @@
 #include "ltable.h"
 
 int lraw_next(lua_State *L, lua_Object lobj, int index, Node **n);
+int lraw_array_size(lua_State *L, Hash *hash);
+
+// Lua internals (exported by the library)
+void luaA_pushobject(lua_State *L, TObject *o);
 
 #define lapi_address(L, lo) ((lo)+L->stack.stack-1)
 
@@ -0,0 +1,137 @@
+//
+// Created by alex on 19/10/2026.
+//
+
+#include "lthread.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define mpsc_exchange(ptr, value) _InterlockedExchangePointer((void *volatile *) (ptr), (value))
+#define mpsc_store(ptr, value) (_ReadWriteBarrier(), *(ptr) = (value))
+#define mpsc_load(ptr) (*(ptr))
+#else
+#define mpsc_exchange(ptr, value) __atomic_exchange_n((ptr), (value), __ATOMIC_ACQ_REL)
+#define mpsc_store(ptr, value) __atomic_store_n((ptr), (value), __ATOMIC_RELEASE)
+#define mpsc_load(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#endif
+
+/**
+ * Thread state saved while the current thread runs Lua without the GIL.
+ * A Lua error (longjmp) can leave a callback holding the GIL again,
+ * so NULL means that the GIL is already held by this thread.
+**/
+static LUA_THREAD_LOCAL PyThreadState *gil_released = NULL;
+
+/* Releases the GIL before running Lua code */
+void lua_gil_release(void) {
+    gil_released = PyEval_SaveThread();
+}
+
+/* Takes the GIL back after running Lua code */
+void lua_gil_restore(void) {
+    PyThreadState *tstate = gil_released;
+    if (tstate) {
+        gil_released = NULL;
+        PyEval_RestoreThread(tstate);
+    }
+}
+
+/**
+ * Takes the GIL when Lua (running without it) calls into Python.
+ * Returns the state to be passed to 'python_gil_leave' (NULL: nothing to do).
+**/
+PyThreadState *python_gil_enter(void) {
+    PyThreadState *tstate = gil_released;
+    if (tstate) {
+        gil_released = NULL;
+        PyEval_RestoreThread(tstate);
+    }
+    return tstate;
+}
+
+/* Releases the GIL taken by 'python_gil_enter' back to Lua */
+void python_gil_leave(PyThreadState *tstate) {
+    if (tstate) gil_released = PyEval_SaveThread();
+}
+
+/* Returns zero on success */
+int lua_state_lock_init(lua_state_lock *slock) {
+    slock->owner = 0;
+    slock->depth = 0;
+    slock->lock = PyThread_allocate_lock();
+    return slock->lock ? 0 : -1;
+}
+
+void lua_state_lock_free(lua_state_lock *slock) {
+    if (slock->lock) {
+        PyThread_free_lock(slock->lock);
+        slock->lock = NULL;
+    }
+}
+
+/**
+ * Acquires the lock of the state (called with the GIL held).
+ * The GIL is released while another thread is using the state.
+**/
+void lua_state_lock_acquire(lua_state_lock *slock) {
+    long ident = PyThread_get_thread_ident();
+    if (slock->depth > 0 && slock->owner == ident) {
+        slock->depth++; // Lua -> Python -> Lua
+        return;
+    }
+    if (!PyThread_acquire_lock(slock->lock, NOWAIT_LOCK)) {
+        Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(slock->lock, WAIT_LOCK);
+        Py_END_ALLOW_THREADS
+    }
+    slock->owner = ident;
+    slock->depth = 1;
+}
+
+void lua_state_lock_release(lua_state_lock *slock) {
+    if (--slock->depth == 0) {
+        slock->owner = 0;
+        PyThread_release_lock(slock->lock);
+    }
+}
+
+void lua_mpsc_init(lua_mpsc *queue) {
+    queue->stub.next = NULL;
+    queue->head = &queue->stub;
+    queue->tail = &queue->stub;
+}
+
+/* Safe from any thread */
+void lua_mpsc_push(lua_mpsc *queue, lua_mpsc_node *node) {
+    lua_mpsc_node *prev;
+    node->next = NULL;
+    prev = (lua_mpsc_node *) mpsc_exchange(&queue->head, node);
+    mpsc_store(&prev->next, node);
+}
+
+/**
+ * Consumer thread only.
+ * Returns NULL when empty (or when a push is not yet linked).
+**/
+lua_mpsc_node *lua_mpsc_pop(lua_mpsc *queue) {
+    lua_mpsc_node *tail = queue->tail;
+    lua_mpsc_node *next = mpsc_load(&tail->next);
+    if (tail == &queue->stub) {
+        if (!next) return NULL;
+        queue->tail = next;
+        tail = next;
+        next = mpsc_load(&next->next);
+    }
+    if (next) {
+        queue->tail = next;
+        return tail;
+    }
+    if (tail != mpsc_load(&queue->head)) return NULL;
+    lua_mpsc_push(queue, &queue->stub);
+    next = mpsc_load(&tail->next);
+    if (next) {
+        queue->tail = next;
+        return tail;
+    }
+    return NULL;
+}
@@ -0,0 +1,72 @@
+//
+// Created by alex on 19/10/2026.
+//
+// Lua code running without the GIL (worker threads).
+
+#ifndef LUNATIC_LTHREAD_H
+#define LUNATIC_LTHREAD_H
+
+#include <Python.h>
+#include <pythread.h>
+#include <lua.h>
+
+#include "lcleanup.h"
+
+#if defined(_MSC_VER)
+#define LUA_THREAD_LOCAL __declspec(thread)
+#else
+#define LUA_THREAD_LOCAL __thread
+#endif
+
+/* Node of the queue (embedded as first member of the items) */
+typedef struct lua_mpsc_node {
+    struct lua_mpsc_node *volatile next;
+} lua_mpsc_node;
+
+/* Lock-free queue: many producers, one consumer (intrusive, D. Vyukov) */
+typedef struct {
+    lua_mpsc_node *volatile head;  // last pushed
+    lua_mpsc_node *tail;           // next to pop (consumer only)
+    lua_mpsc_node stub;
+} lua_mpsc;
+
+void lua_mpsc_init(lua_mpsc *queue);
+void lua_mpsc_push(lua_mpsc *queue, lua_mpsc_node *node);
+lua_mpsc_node *lua_mpsc_pop(lua_mpsc *queue);
+
+/* Reentrant lock of a Lua state shared by threads */
+typedef struct {
+    PyThread_type_lock lock;
+    long owner;  // thread holding the lock
+    int depth;   // acquisitions of the owner
+} lua_state_lock;
+
+int lua_state_lock_init(lua_state_lock *slock);
+void lua_state_lock_free(lua_state_lock *slock);
+void lua_state_lock_acquire(lua_state_lock *slock);
+void lua_state_lock_release(lua_state_lock *slock);
+
+void lua_gil_release(void);
+void lua_gil_restore(void);
+PyThreadState *python_gil_enter(void);
+void python_gil_leave(PyThreadState *tstate);
+
+/* Runs Lua code releasing the GIL (like Py_BEGIN_ALLOW_THREADS) */
+#define LUA_BEGIN_ALLOW_THREADS lua_gil_release();
+#define LUA_END_ALLOW_THREADS lua_gil_restore();
+
+/**
+ * Defines fn##_gil: the Lua C function fn called with the GIL held.
+ * All the entry points of Lua in Python are registered through it
+ * (the temporaries of fn are released on return, see lcleanup.h).
+**/
+#define LUA_GIL_FUNC(fn) \
+    static void fn##_gil(lua_State *L) { \
+        PyThreadState *tstate = python_gil_enter(); \
+        int frame = lua_cleanup_enter(L); \
+        fn(L); \
+        lua_cleanup_leave(frame); \
+        python_gil_leave(tstate); \
+    }
+
+#endif //LUNATIC_LTHREAD_H
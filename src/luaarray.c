@@ -0,0 +1,261 @@
+//
+// Created by alex on 19/10/2026.
+//
+#include <Python.h>
+#include <lua.h>
+#include <lauxlib.h>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+
+#include "luaarray.h"
+#include "pyconv.h"
+#include "utils.h"
+
+double lua_array_get(LuaArrayObject *array, Py_ssize_t index) {
+    if (array->format[0] == 'd')
+        return ((double *) array->data)[index];
+    return ((int *) array->data)[index];
+}
+
+/* Error of a value that the array can not store (NULL: valid) */
+const char *lua_array_check(LuaArrayObject *array, double value) {
+    if (array->format[0] == 'd')
+        return NULL;
+    if (rint(value) != value)  // also NaN
+        return "array value must be an integer";
+    if (value < INT_MIN || value > INT_MAX)
+        return "array value out of the integer range";
+    return NULL;
+}
+
+/* Stores the value (checked by lua_array_check) */
+void lua_array_set(LuaArrayObject *array, Py_ssize_t index, double value) {
+    if (array->format[0] == 'd') {
+        ((double *) array->data)[index] = value;
+    } else {
+        ((int *) array->data)[index] = (int) value;
+    }
+}
+
+/* New array (zeros) of the typecode "d" or "i" */
+PyObject *LuaArray_New(Py_ssize_t size, char typecode) {
+    if (size < 0 || (typecode != 'd' && typecode != 'i')) {
+        PyErr_SetString(PyExc_ValueError, "size >= 0 and typecode \"d\" or \"i\" expected");
+        return NULL;
+    }
+    LuaArrayObject *array = PyObject_New(LuaArrayObject, &LuaArrayObject_Type);
+    if (!array)
+        return NULL;
+    array->format[0] = typecode;
+    array->format[1] = '\0';
+    array->size = size;
+    array->itemsize = typecode == 'd' ? sizeof(double) : sizeof(int);
+    if (!(array->data = calloc((size_t) (size ? size : 1), (size_t) array->itemsize))) {
+        array->size = 0;
+        Py_DECREF(array);
+        return PyErr_NoMemory();
+    }
+    return (PyObject *) array;
+}
+
+static PyObject *LuaArray_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+    static char *kwlist[] = {"size", "typecode", NULL};
+    Py_ssize_t size;
+    char typecode = 'd';
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "n|c:LuaArray", kwlist, &size, &typecode))
+        return NULL;
+    return LuaArray_New(size, typecode);
+}
+
+static void LuaArray_dealloc(LuaArrayObject *self) {
+    free(self->data);
+    PyObject_Del(self);
+}
+
+static PyObject *LuaArray_repr(LuaArrayObject *self) {
+    return PyString_FromFormat("<LuaArray '%s' size %zd>", self->format, self->size);
+}
+
+static Py_ssize_t LuaArray_length(LuaArrayObject *self) {
+    return self->size;
+}
+
+static PyObject *LuaArray_item(LuaArrayObject *self, Py_ssize_t index) {
+    if (index < 0 || index >= self->size) {
+        PyErr_SetString(PyExc_IndexError, "array index out of range");
+        return NULL;
+    }
+    if (self->format[0] == 'd')
+        return PyFloat_FromDouble(((double *) self->data)[index]);
+    return PyInt_FromLong(((int *) self->data)[index]);
+}
+
+static int LuaArray_ass_item(LuaArrayObject *self, Py_ssize_t index, PyObject *value) {
+    if (index < 0 || index >= self->size) {
+        PyErr_SetString(PyExc_IndexError, "array assignment index out of range");
+        return -1;
+    } else if (value == NULL) {
+        PyErr_SetString(PyExc_TypeError, "array items can not be deleted");
+        return -1;
+    }
+    if (self->format[0] == 'd') {
+        double number = PyFloat_AsDouble(value);
+        if (number == -1.0 && PyErr_Occurred())
+            return -1;
+        lua_array_set(self, index, number);
+        return 0;
+    }
+    if (PyFloat_Check(value)) {  // as array.array
+        PyErr_SetString(PyExc_TypeError, "integer argument expected, got float");
+        return -1;
+    }
+    long number = PyInt_AsLong(value);
+    if (number == -1 && PyErr_Occurred())
+        return -1;
+    if (number < INT_MIN || number > INT_MAX) {
+        PyErr_SetString(PyExc_OverflowError, "array value out of the integer range");
+        return -1;
+    }
+    ((int *) self->data)[index] = (int) number;
+    return 0;
+}
+
+static int LuaArray_getbuffer(LuaArrayObject *self, Py_buffer *view, int flags) {
+    if (PyBuffer_FillInfo(view, (PyObject *) self, self->data,
+                          self->size * self->itemsize, 0, flags) != 0)
+        return -1;
+    view->itemsize = self->itemsize;
+    if (flags & PyBUF_FORMAT)
+        view->format = self->format;
+    if (flags & PyBUF_ND)
+        view->shape = &self->size;
+    if (flags & PyBUF_STRIDES)
+        view->strides = &view->itemsize;
+    return 0;
+}
+
+#if PY_MAJOR_VERSION < 3
+static Py_ssize_t LuaArray_getreadbuffer(LuaArrayObject *self, Py_ssize_t segment, void **ptr) {
+    if (segment != 0) {
+        PyErr_SetString(PyExc_SystemError, "accessing non-existent array segment");
+        return -1;
+    }
+    *ptr = self->data;
+    return self->size * self->itemsize;
+}
+
+static Py_ssize_t LuaArray_getsegcount(LuaArrayObject *self, Py_ssize_t *len) {
+    if (len) *len = self->size * self->itemsize;
+    return 1;
+}
+#endif
+
+static PySequenceMethods LuaArray_as_sequence = {
+    (lenfunc) LuaArray_length,                  /* sq_length */
+    0,                                          /* sq_concat */
+    0,                                          /* sq_repeat */
+    (ssizeargfunc) LuaArray_item,               /* sq_item */
+    0,                                          /* sq_slice */
+    (ssizeobjargproc) LuaArray_ass_item,        /* sq_ass_item */
+};
+
+static PyBufferProcs LuaArray_as_buffer = {
+#if PY_MAJOR_VERSION < 3
+    (readbufferproc) LuaArray_getreadbuffer,    /* bf_getreadbuffer */
+    (writebufferproc) LuaArray_getreadbuffer,   /* bf_getwritebuffer */
+    (segcountproc) LuaArray_getsegcount,        /* bf_getsegcount */
+    0,                                          /* bf_getcharbuffer */
+#endif
+    (getbufferproc) LuaArray_getbuffer,         /* bf_getbuffer */
+    0,                                          /* bf_releasebuffer */
+};
+
+#if PY_MAJOR_VERSION < 3
+#define LUA_ARRAY_FLAGS (Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER)
+#else
+#define LUA_ARRAY_FLAGS Py_TPFLAGS_DEFAULT
+#endif
+
+PyTypeObject LuaArrayObject_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "lua.LuaArray",                             /* tp_name */
+    sizeof(LuaArrayObject),                     /* tp_basicsize */
+    0,                                          /* tp_itemsize */
+    (destructor) LuaArray_dealloc,              /* tp_dealloc */
+    0,                                          /* tp_print */
+    0,                                          /* tp_getattr */
+    0,                                          /* tp_setattr */
+    0,                                          /* tp_reserved */
+    (reprfunc) LuaArray_repr,                   /* tp_repr */
+    0,                                          /* tp_as_number */
+    &LuaArray_as_sequence,                      /* tp_as_sequence */
+    0,                                          /* tp_as_mapping */
+    0,                                          /* tp_hash */
+    0,                                          /* tp_call */
+    0,                                          /* tp_str */
+    PyObject_GenericGetAttr,                    /* tp_getattro */
+    0,                                          /* tp_setattro */
+    &LuaArray_as_buffer,                        /* tp_as_buffer */
+    LUA_ARRAY_FLAGS,                            /* tp_flags */
+    "LuaArray(size, typecode='d'): numeric array shared with Lua (buffer protocol)", /* tp_doc */
+    0,                                          /* tp_traverse */
+    0,                                          /* tp_clear */
+    0,                                          /* tp_richcompare */
+    0,                                          /* tp_weaklistoffset */
+    0,                                          /* tp_iter */
+    0,                                          /* tp_iternext */
+    0,                                          /* tp_methods */
+    0,                                          /* tp_members */
+    0,                                          /* tp_getset */
+    0,                                          /* tp_base */
+    0,                                          /* tp_dict */
+    0,                                          /* tp_descr_get */
+    0,                                          /* tp_descr_set */
+    0,                                          /* tp_dictoffset */
+    0,                                          /* tp_init */
+    0,                                          /* tp_alloc */
+    LuaArray_new,                               /* tp_new */
+};
+
+/* python.array(n [, "d"|"i"]): new array of n zeros */
+void py_array(lua_State *L) {
+    int size = luaL_check_int(L, 1);
+    char *typecode = luaL_opt_string(L, 2, "d");
+    if (size < 0) lua_error(L, "#1 size must be positive");
+    if (strcmp(typecode, "d") != 0 && strcmp(typecode, "i") != 0)
+        lua_error(L, "#2 typecode must be \"d\" or \"i\"");
+    PyObject *array = LuaArray_New(size, typecode[0]);
+    if (!array) lua_new_error(L, "failed to create the array");
+    push_pyobject_container(L, array, true);
+}
+
+/* array[i] (1..n) and array.n read directly from the buffer */
+void lua_array_index_get(lua_State *L, LuaArrayObject *array, lua_Object lkey) {
+    if (lua_isnumber(L, lkey)) {
+        double index = lua_getnumber(L, lkey);
+        if (index >= 1 && index <= array->size && index == (Py_ssize_t) index) {
+            lua_pushnumber(L, lua_array_get(array, (Py_ssize_t) index - 1));
+        } else {
+            lua_pushnil(L);
+        }
+    } else if (lua_isstring(L, lkey) && strcmp(lua_getstring(L, lkey), "n") == 0) {
+        lua_pushnumber(L, array->size);
+    } else {
+        lua_pushnil(L);
+    }
+}
+
+/* array[i] = number (1..n) written directly in the buffer */
+void lua_array_index_set(lua_State *L, LuaArrayObject *array, lua_Object lkey, lua_Object lvalue) {
+    double index = lua_isnumber(L, lkey) ? lua_getnumber(L, lkey) : 0;
+    if (index < 1 || index > array->size || index != (Py_ssize_t) index)
+        lua_error(L, "array index out of range");
+    if (!lua_isnumber(L, lvalue))
+        lua_error(L, "array value must be a number");
+    double value = lua_getnumber(L, lvalue);
+    const char *error = lua_array_check(array, value);
+    if (error)
+        lua_error(L, (char *) error);
+    lua_array_set(array, (Py_ssize_t) index - 1, value);
+}
@@ -0,0 +1,35 @@
+//
+// Created by alex on 19/10/2026.
+//
+// Typed numeric array (contiguous C buffer) shared by Lua and Python:
+// indexed by Lua through the tag methods of the python objects and seen
+// by Python through the buffer protocol (memoryview, numpy, ...).
+
+#ifndef LUNATIC_LUAARRAY_H
+#define LUNATIC_LUAARRAY_H
+
+#include <Python.h>
+#include <lua.h>
+
+typedef struct {
+    PyObject_HEAD
+    char format[2];      // typecode: "d" (double) or "i" (int)
+    Py_ssize_t size;
+    Py_ssize_t itemsize;
+    char *data;
+} LuaArrayObject;
+
+extern PyTypeObject LuaArrayObject_Type;
+
+#define LuaArray_Check(op) PyObject_TypeCheck(op, &LuaArrayObject_Type)
+
+PyObject *LuaArray_New(Py_ssize_t size, char typecode);
+double lua_array_get(LuaArrayObject *array, Py_ssize_t index);
+const char *lua_array_check(LuaArrayObject *array, double value);
+void lua_array_set(LuaArrayObject *array, Py_ssize_t index, double value);
+
+void py_array(lua_State *L);
+void lua_array_index_get(lua_State *L, LuaArrayObject *array, lua_Object lkey);
+void lua_array_index_set(lua_State *L, LuaArrayObject *array, lua_Object lkey, lua_Object lvalue);
+
+#endif //LUNATIC_LUAARRAY_H
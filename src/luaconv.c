@@ -5,6 +5,8 @@
 
 #include <lua.h>
 #include <lauxlib.h>
+#include <limits.h>
+#include <math.h>
 
 #if defined(_WIN32)
 #include "lapi.h"
@@ -17,13 +19,88 @@
 #include "pyconv.h"
 #include "utils.h"
 #include "constants.h"
+#include "ucodec.h"
+#include "lregistry.h"
+#include "freelist.h"
+#include "lcleanup.h"
 
 
+/**
+ * Address that identifies the value (table, function or userdata).
+ * Returns NULL for the values without identity (numbers, strings, nil).
+**/
+void *lua_object_identity(lua_State *L, lua_Object lobj) {
+    if (lobj == LUA_NOOBJECT)
+        return NULL;
+    TObject *o = lapi_address(L, lobj);
+    switch (ttype(o)) {
+        case LUA_T_ARRAY:
+            return avalue(o);
+        case LUA_T_CLOSURE:
+            return clvalue(o);
+        case LUA_T_PROTO:
+            return tfvalue(o);
+        case LUA_T_CPROTO:
+            return (void *) fvalue(o);
+        case LUA_T_USERDATA:
+            return tsvalue(o);
+        default:
+            return NULL;
+    }
+}
+
+/* Live wrapper of the value in the cache of the interpreter (new reference) or NULL */
+static PyObject *LuaObject_cached(InterpreterObject *interpreter, PyObject *key) {
+    PyObject *wref = PyDict_GetItem(interpreter->wrappers, key);
+    PyObject *obj = wref ? PyWeakref_GET_OBJECT(wref) : NULL;
+    if (!obj || obj == Py_None || Py_REFCNT(obj) <= 0)  // dead or in dealloc
+        return NULL;
+    Py_INCREF(obj);
+    return obj;
+}
+
+/* Removes the wrapper (obj or dead) of the value from the cache, unless it was already replaced */
+void lua_object_uncache(InterpreterObject *interpreter, void *identity, PyObject *obj) {
+    PyObject *wrappers = interpreter->wrappers, *key, *wref;
+    if (!wrappers || !(key = PyLong_FromVoidPtr(identity))) {
+        PyErr_Clear();
+        return;
+    }
+    wref = PyDict_GetItem(wrappers, key);
+    if (wref && (PyWeakref_GET_OBJECT(wref) == Py_None || PyWeakref_GET_OBJECT(wref) == obj) &&
+        PyDict_DelItem(wrappers, key) != 0)
+        PyErr_Clear();
+    Py_DECREF(key);
+}
+
+/**
+ * Wrapper of the Lua value. Tables, functions and userdata keep a single
+ * wrapper per interpreter while it is alive (weak cache by identity).
+**/
 PyObject *LuaObject_New(InterpreterObject *interpreter, lua_Object lobj) {
-    LuaObject *obj = PyObject_New(LuaObject, &LuaObject_Type);
+    void *identity = interpreter->isPyType && interpreter->wrappers ?
+                     lua_object_identity(interpreter->L, lobj) : NULL;
+    PyObject *key = NULL, *cached;
+    if (identity) {
+        if (!(key = PyLong_FromVoidPtr(identity))) {
+            PyErr_Clear();
+            identity = NULL;
+        } else if ((cached = LuaObject_cached(interpreter, key))) {
+            Py_DECREF(key);
+            if (lua_istable(interpreter->L, lobj))  // may have changed in Lua
+                ((LuaObject *) cached)->indexed = is_indexed_array(interpreter->L, lobj);
+            return cached;
+        }
+    }
+    LuaObject *obj = (LuaObject *) lua_freelist_pop(&LuaObject_freelist);
+    if (!obj)
+        obj = PyObject_GC_New(LuaObject, &LuaObject_Type);
     if (obj) {
-        lua_pushobject(interpreter->L, lobj);
-        obj->ref = lua_ref(interpreter->L, 1);
+        obj->identity = identity;
+        obj->weakreflist = NULL;
+        obj->reach = NULL;
+        obj->nreach = 0;
+        obj->ref = lregistry_ref(interpreter->L, lobj);
         obj->indexed = lua_istable(interpreter->L, lobj) ? is_indexed_array(interpreter->L, lobj) : false;
         obj->refiter = 0;
         if (interpreter->isPyType) {
@@ -40,7 +117,15 @@ PyObject *LuaObject_New(InterpreterObject *interpreter, lua_Object lobj) {
             obj->interpreter->isPyType = false;  // fake type
 #pragma clang diagnostic pop
         }
+        PyObject *wref = key ? PyWeakref_NewRef((PyObject *) obj, NULL) : NULL;
+        if (key && (!wref || PyDict_SetItem(interpreter->wrappers, key, wref) != 0)) {
+            obj->identity = NULL;  // not cached
+            PyErr_Clear();
+        }
+        Py_XDECREF(wref);
+        PyObject_GC_Track(obj);
     }
+    Py_XDECREF(key);
     return (PyObject*) obj;
 }
 
@@ -104,7 +189,7 @@ bool is_indexed_array(lua_State *L, lua_Object ltable) {
  **/
 PyObject *ltable_convert_tuple(lua_State *L, lua_Object ltable) {
     int nargs = lua_tablesize(L, ltable);
-    PyObject *tuple = PyTuple_New(nargs);
+    PyObject *tuple = lua_cleanup_push(L, PyTuple_New(nargs));
     if (!tuple) lua_new_error(L, "#4 failed to create arguments tuple");
     set_table_nil(L, ltable, "n"); // remove "n"
     int nextindex = lua_next(L, ltable, 0);
@@ -113,20 +198,18 @@ PyObject *ltable_convert_tuple(lua_State *L, lua_Object ltable) {
     while (nextindex > 0) {
         arg = lua_stack_convert(L, stackpos);
         if (!arg) {
-            Py_DECREF(tuple);
             char *format = "failed to convert argument #%d";
             char buff[strlen(format) + 32];
             sprintf(buff, format, index + 1);
             lua_new_error(L, &buff[0]);
         }
-        if (PyTuple_SetItem(tuple, index, arg) != 0) {
-            Py_XDECREF(arg);
-            Py_DECREF(tuple);
+        if (PyTuple_SetItem(tuple, index, arg) != 0) { // steals arg (also on error)
             lua_new_error(L, "failed to set item in tuple");
         }
         nextindex = lua_next(L, ltable, nextindex);
         index++;
     }
+    Py_INCREF(tuple); // the temporary is released with the function
     return tuple;
 }
 
@@ -134,7 +217,7 @@ PyObject *ltable_convert_tuple(lua_State *L, lua_Object ltable) {
  * Convert a lua table for python tuple
  **/
 PyObject *ltable2list(lua_State *L, lua_Object ltable) {
-    PyObject *list = PyList_New(0);
+    PyObject *list = lua_cleanup_push(L, PyList_New(0));
     if (!list) lua_new_error(L, "failed to create list");
     set_table_nil(L, ltable, "n"); // remove "n"
     int nextindex = lua_next(L, ltable, 0);
@@ -143,7 +226,6 @@ PyObject *ltable2list(lua_State *L, lua_Object ltable) {
     while (nextindex > 0) {
         arg = lua_stack_convert(L, stackpos);
         if (!arg) {
-            Py_DECREF(list);
             char *format = "failed to convert argument #%d";
             char buff[strlen(format) + 32];
             sprintf(buff, format, index + 1);
@@ -151,19 +233,20 @@ PyObject *ltable2list(lua_State *L, lua_Object ltable) {
         }
         if (PyList_Append(list, arg) != 0) {
             Py_DECREF(arg);
-            Py_DECREF(list);
             lua_new_error(L, "failed to set item in list");
         }
+        Py_DECREF(arg); // PyList_Append does not steal
         nextindex = lua_next(L, ltable, nextindex);
         index++;
     }
+    Py_INCREF(list);
     return list;
 }
 
 /* Convert arguments in the stack lua to tuple */
 PyObject *get_py_tuple(lua_State *L, int stackpos) {
     int nargs = lua_gettop(L) - stackpos;
-    PyObject *tuple = PyTuple_New(nargs);
+    PyObject *tuple = lua_cleanup_push(L, PyTuple_New(nargs));
     if (!tuple) lua_new_error(L, "#2 failed to create arguments tuple");
     int index, pos;
     PyObject *arg;
@@ -171,34 +254,32 @@ PyObject *get_py_tuple(lua_State *L, int stackpos) {
         pos = index + stackpos + 1;
         arg = lua_stack_convert(L, pos);
         if (!arg) {
-            Py_DECREF(tuple);
             char *format = "failed to convert argument #%d";
             char buff[strlen(format) + 32];
             sprintf(buff, format, index + 1);
             lua_new_error(L, &buff[0]);
         }
-        if (PyTuple_SetItem(tuple, index, arg) != 0) {
-            Py_XDECREF(arg);
-            Py_DECREF(tuple);
+        if (PyTuple_SetItem(tuple, index, arg) != 0) { // steals arg (also on error)
             lua_new_error(L, "failed to set item in tuple");
         }
     }
+    Py_INCREF(tuple);
     return tuple;
 }
 
 /* Converts the list of arguments in the stack for python args: fn(*args) */
 void py_args(lua_State *L) {
-    python_setnumber(L, PY_LUA_TABLE_CONVERT, 1);
+    lua_cleanup_flag(L, PY_LUA_TABLE_CONVERT, 1);
     PyObject *tuple = get_py_tuple(L, 0);
     py_object *pobj = py_object_container(L, tuple, 1);
     lua_pushusertag(L, pobj, python_api_tag(L));
     pobj->isargs = true;
-    python_setnumber(L, PY_LUA_TABLE_CONVERT, 0);
+    lua_cleanup_flag(L, PY_LUA_TABLE_CONVERT, 0);
 }
 
 /* Convert a table or a tuple for python args: fn(*args) */
 void py_args_array(lua_State *L) {
-    python_setnumber(L, PY_LUA_TABLE_CONVERT, 1);
+    lua_cleanup_flag(L, PY_LUA_TABLE_CONVERT, 1);
     lua_Object lobj = lua_getparam(L, 1);
     PyObject *obj;
     if (is_object_container(L, lobj)) {
@@ -222,7 +303,7 @@ void py_args_array(lua_State *L) {
     py_object *pobj = py_object_container(L, obj, 1);
     lua_pushusertag(L, pobj, python_api_tag(L));
     pobj->isargs = true;
-    python_setnumber(L, PY_LUA_TABLE_CONVERT, 0);
+    lua_cleanup_flag(L, PY_LUA_TABLE_CONVERT, 0);
 }
 
 
@@ -248,7 +329,7 @@ static void raise_key_error(lua_State *L, char *format,
 
 /* convert to kwargs python: fn(**kwargs) */
 PyObject *get_py_dict(lua_State *L, lua_Object ltable) {
-    PyObject *dict = PyDict_New();
+    PyObject *dict = lua_cleanup_push(L, PyDict_New());
     if (!dict) lua_new_error(L, "failed to create key words arguments dict");
     PyObject *key, *value;
     int index = lua_next(L, ltable, 0);
@@ -259,37 +340,33 @@ PyObject *get_py_dict(lua_State *L, lua_Object ltable) {
         lkey = lua_getparam(L, stackpos);
         key = lua_object_convert(L, lkey);
         if (!key) {
-            Py_DECREF(dict);
             raise_key_error(L, "failed to convert key \"%s\"", lkey);
         }
         stackpos = 2;
         value = lua_stack_convert(L, stackpos);
         if (!value) {
             Py_DECREF(key);
-            Py_DECREF(dict);
             raise_key_error(L, "failed to convert value of key \"%s\"", lkey);
         }
-        if (PyDict_SetItem(dict, key, value) != 0) {
-            Py_DECREF(key);
-            Py_DECREF(value);
-            Py_DECREF(dict);
+        int status = PyDict_SetItem(dict, key, value);
+        Py_DECREF(key);
+        Py_DECREF(value);
+        if (status != 0) {
             lua_new_error(L, "failed to set item in dict");
-        } else {
-            Py_DECREF(key);
-            Py_DECREF(value);
         }
         index = lua_next(L, ltable, index);
     }
+    Py_INCREF(dict);
     return dict;
 }
 
 void py_kwargs(lua_State *L) {
-    python_setnumber(L, PY_LUA_TABLE_CONVERT, 1);
+    lua_cleanup_flag(L, PY_LUA_TABLE_CONVERT, 1);
     PyObject *dict = get_py_dict(L, luaL_tablearg(L, 1));
     py_object *pobj = py_object_container(L, dict, 1);
     pobj->iskwargs = true;
     lua_pushusertag(L, pobj, python_api_tag(L));
-    python_setnumber(L, PY_LUA_TABLE_CONVERT, 0);
+    lua_cleanup_flag(L, PY_LUA_TABLE_CONVERT, 0);
 }
 
 /**
@@ -308,19 +385,45 @@ PyObject *get_pobject(lua_State *L, lua_Object userdata) {
     return (get_py_object(L, userdata))->object;
 }
 
-static void lnumber_convert(InterpreterObject *interpreter, lua_Object lobj, PyObject **ret) {
-    double num = lua_getnumber(interpreter->L, lobj);
-    if (rintf((float) num) == num) {  // is int?
-        *ret = PyInt_FromLong((long) num);
+/* Python int when the number is integral and fits a long (-2^(bits-1) exact), float otherwise */
+PyObject *lua_number_convert(double num) {
+    if (rint(num) == num && num >= (double) LONG_MIN && num < -(double) LONG_MIN) {  // is int?
+        return PyInt_FromLong((long) num);
     } else {
-        *ret = PyFloat_FromDouble(num);
+        return PyFloat_FromDouble(num);
     }
 }
 
+static void lnumber_convert(InterpreterObject *interpreter, lua_Object lobj, PyObject **ret) {
+    *ret = lua_number_convert(lua_getnumber(interpreter->L, lobj));
+}
+
+/* Decoding of the strings (python.set_unicode_decoding), codec -1 keeps them as str */
+typedef struct {
+    int codec;
+    char *encoding;
+    char *errors;
+} lstring_codec;
+
+static void lstring_codec_get(lua_State *L, lstring_codec *codec) {
+    python_unicode_settings *settings = python_unicode(L);
+    codec->codec = settings->decoding ? settings->codec : -1;
+    codec->encoding = settings->encoding;  // strings of the python table
+    codec->errors = settings->errors;
+}
+
+static PyObject *lstring_new(lstring_codec *codec, const char *s, Py_ssize_t len) {
+    if (codec->codec < 0)
+        return PyString_FromStringAndSize(s, len);
+    return ucodec_decode(codec->codec, codec->encoding, codec->errors, s, len);
+}
+
 static void lstring_convert(InterpreterObject *interpreter, lua_Object lobj, PyObject **ret) {
     const char *s = lua_getstring(interpreter->L, lobj);
     int len = lua_strlen(interpreter->L, lobj);
-    *ret = PyString_FromStringAndSize(s, len);
+    lstring_codec codec;
+    lstring_codec_get(interpreter->L, &codec);
+    *ret = lstring_new(&codec, s, len);
 }
 
 static void ltable_convert(InterpreterObject *interpreter, lua_Object lobj, PyObject **ret) {
@@ -328,10 +431,9 @@ static void ltable_convert(InterpreterObject *interpreter, lua_Object lobj, PyOb
     if (!python_getnumber(interpreter->L, PY_API_IS_EMBEDDED) && // Lua inside Python
         !python_getnumber(interpreter->L, PY_LUA_TABLE_CONVERT)){
         *ret = LuaObject_New(interpreter, lobj);
-    } else if (is_indexed_array(interpreter->L, lobj)) { //  Python inside Lua
-        *ret = ltable_convert_tuple(interpreter->L, lobj);
-    } else {
-        *ret = get_py_dict(interpreter->L, lobj);
+    } else { //  Python inside Lua
+        *ret = lua_interpreter_deep_convert(interpreter, lapi_address(interpreter->L, lobj),
+                                            python_getnumber(interpreter->L, PY_LUA_TABLE_DEPTH));
     }
     lua_endblock(interpreter->L);
 }
@@ -389,6 +491,280 @@ PyObject *lua_interpreter_stack_convert(InterpreterObject *interpreter, int stac
     return lua_interpreter_object_convert(interpreter, lua_getparam(interpreter->L, stackpos));
 }
 
+/* Converts an internal object (e.g. a table node) through the C stack of the block */
+PyObject *lua_interpreter_tobject_convert(InterpreterObject *interpreter, TObject *o) {
+    luaA_pushobject(interpreter->L, o);
+    return lua_interpreter_object_convert(interpreter, lua_pop(interpreter->L));
+}
+
+/* Table being filled by the deep conversion */
+typedef struct {
+    Hash *hash;
+    PyObject *container;  // tuple (keys 1..size) or dict
+    int size;
+    int index;  // next array index or hash node
+    int depth;
+} lconv_frame;
+
+typedef struct {
+    lconv_frame *frames;
+    int count;
+    int capacity;
+    lstring_codec codec;
+} lconv_stack;
+
+/* Non-table values (and the tables below the max depth) */
+static PyObject *lconv_leaf(InterpreterObject *interpreter, lconv_stack *stack, TObject *o) {
+    switch (ttype(o)) {
+        case LUA_T_NUMBER:
+            return lua_number_convert(nvalue(o));
+        case LUA_T_STRING:
+            return lstring_new(&stack->codec, svalue(o), tsvalue(o)->u.s.len);
+        case LUA_T_NIL:
+            Py_RETURN_NONE;
+        case LUA_T_ARRAY:
+            luaA_pushobject(interpreter->L, o);
+            return LuaObject_New(interpreter, lua_pop(interpreter->L));
+        default:
+            return lua_interpreter_tobject_convert(interpreter, o);
+    }
+}
+
+/* Creates the container of the table (registered in the memo) and pushes its frame */
+static PyObject *lconv_open(InterpreterObject *interpreter, lconv_stack *stack,
+                            PyObject *memo, Hash *hash, int depth) {
+    if (stack->count == stack->capacity) {
+        int capacity = stack->capacity ? stack->capacity * 2 : 16;
+        lconv_frame *frames = realloc(stack->frames, capacity * sizeof(lconv_frame));
+        if (!frames)
+            return PyErr_NoMemory();
+        stack->frames = frames;
+        stack->capacity = capacity;
+    }
+    int size = lraw_array_size(interpreter->L, hash);
+    PyObject *container = size >= 0 ? PyTuple_New(size) : PyDict_New();
+    if (!container)
+        return NULL;
+    PyObject *key = PyLong_FromVoidPtr(hash);
+    if (!key || PyDict_SetItem(memo, key, container) != 0) {
+        Py_XDECREF(key);
+        Py_DECREF(container);
+        return NULL;
+    }
+    Py_DECREF(key);
+    lconv_frame *frame = &stack->frames[stack->count++];
+    frame->hash = hash;
+    frame->container = container;
+    frame->size = size;
+    frame->index = 0;
+    frame->depth = depth;
+    return container;
+}
+
+/* Converts a value of the table in the depth given (tables already converted come from the memo) */
+static PyObject *lconv_value(InterpreterObject *interpreter, lconv_stack *stack, PyObject *memo,
+                             TObject *o, int depth, int max_depth) {
+    if (ttype(o) != LUA_T_ARRAY || (max_depth > 0 && depth > max_depth))
+        return lconv_leaf(interpreter, stack, o);
+    PyObject *key = PyLong_FromVoidPtr(avalue(o));
+    if (!key)
+        return NULL;
+    PyObject *container = PyDict_GetItem(memo, key);
+    Py_DECREF(key);
+    if (container) {
+        Py_INCREF(container);
+        return container;
+    }
+    container = lconv_open(interpreter, stack, memo, avalue(o), depth);
+    Py_XINCREF(container);  // the memo keeps the other reference
+    return container;
+}
+
+/* Fills the container of the frame at the top until a new table is opened */
+static int lconv_fill(InterpreterObject *interpreter, lconv_stack *stack, PyObject *memo, int max_depth) {
+    int top = stack->count - 1;
+    lconv_frame *frame = &stack->frames[top];
+    lua_State *L = interpreter->L;
+    while (stack->count == top + 1) {
+        frame = &stack->frames[top];  // the stack may have been reallocated
+        PyObject *value;
+        if (frame->size >= 0) {
+            if (frame->index >= frame->size) {
+                stack->count--;
+                break;
+            }
+            TObject *o = luaH_getint(L, frame->hash, frame->index + 1);
+            if (!(value = lconv_value(interpreter, stack, memo, o, frame->depth + 1, max_depth)))
+                return -1;
+            frame = &stack->frames[top];
+            PyTuple_SET_ITEM(frame->container, frame->index++, value);
+        } else {
+            while (frame->index < nhash(L, frame->hash) &&
+                   ttype(val(L, node(L, frame->hash, frame->index))) == LUA_T_NIL)
+                frame->index++;
+            if (frame->index >= nhash(L, frame->hash)) {
+                stack->count--;
+                break;
+            }
+            Node *n = node(L, frame->hash, frame->index++);
+            PyObject *key = lconv_leaf(interpreter, stack, ref(L, n));
+            if (!key)
+                return -1;
+            if (!(value = lconv_value(interpreter, stack, memo, val(L, n), frame->depth + 1, max_depth))) {
+                Py_DECREF(key);
+                return -1;
+            }
+            frame = &stack->frames[top];
+            int status = PyDict_SetItem(frame->container, key, value);
+            Py_DECREF(key);
+            Py_DECREF(value);
+            if (status != 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Converts the table and its subtables (up to max_depth, 0 unlimited) with an explicit stack.
+ * Arrays (keys 1..n) become tuples and the other tables dicts. A table referenced
+ * several times (or cyclic) is converted once, into the same object.
+ **/
+PyObject *lua_interpreter_deep_convert(InterpreterObject *interpreter, TObject *o, int max_depth) {
+    lconv_stack stack = {NULL, 0, 0};
+    lstring_codec_get(interpreter->L, &stack.codec);
+    if (ttype(o) != LUA_T_ARRAY)
+        return lconv_leaf(interpreter, &stack, o);
+    PyObject *memo = PyDict_New();
+    if (!memo)
+        return NULL;
+    PyObject *ret = lconv_value(interpreter, &stack, memo, o, 1, max_depth);
+    while (ret && stack.count > 0) {
+        if (lconv_fill(interpreter, &stack, memo, max_depth) != 0)
+            Py_CLEAR(ret);
+    }
+    free(stack.frames);
+    Py_DECREF(memo);
+    return ret;
+}
+
+/* Column of the records (the key is converted once) */
+typedef struct {
+    TaggedString *key;
+    PyObject *list;  // borrowed (kept by the dict)
+} lconv_column;
+
+typedef struct {
+    lconv_column *items;
+    int count;
+    int capacity;
+    int last;  // column of the previous field (the records share the node order)
+    int size;  // rows
+    PyObject *dict;
+} lconv_columns;
+
+/* Column of the key (created presized with None) or NULL */
+static lconv_column *lconv_column_get(lconv_columns *columns, lconv_stack *stack, TaggedString *key) {
+    int index, column;
+    for (index = 1; index <= columns->count; index++) {
+        column = (columns->last + index) % columns->count;
+        if (columns->items[column].key == key) {  // Lua strings are unique
+            columns->last = column;
+            return &columns->items[column];
+        }
+    }
+    if (columns->count == columns->capacity) {
+        int capacity = columns->capacity ? columns->capacity * 2 : 8;
+        lconv_column *items = realloc(columns->items, capacity * sizeof(lconv_column));
+        if (!items) {
+            PyErr_NoMemory();
+            return NULL;
+        }
+        columns->items = items;
+        columns->capacity = capacity;
+    }
+    PyObject *list = PyList_New(columns->size);
+    if (!list)
+        return NULL;
+    for (index = 0; index < columns->size; index++) {
+        Py_INCREF(Py_None);
+        PyList_SET_ITEM(list, index, Py_None);
+    }
+    PyObject *name = lstring_new(&stack->codec, key->str, key->u.s.len);
+    int status = name ? PyDict_SetItem(columns->dict, name, list) : -1;
+    Py_XDECREF(name);
+    Py_DECREF(list);
+    if (status != 0)
+        return NULL;
+    columns->last = columns->count;
+    lconv_column *column_item = &columns->items[columns->count++];
+    column_item->key = key;
+    column_item->list = list;
+    return column_item;
+}
+
+/* Moves the fields of the record (row) to the columns */
+static int lconv_record(InterpreterObject *interpreter, lconv_stack *stack,
+                        lconv_columns *columns, Hash *fields, int row) {
+    lua_State *L = interpreter->L;
+    int index;
+    for (index = 0; index < nhash(L, fields); index++) {
+        Node *n = node(L, fields, index);
+        if (ttype(val(L, n)) == LUA_T_NIL)
+            continue;
+        if (ttype(ref(L, n)) != LUA_T_STRING) {
+            PyErr_Format(PyExc_TypeError, "string keys expected (record at index %d)", row + 1);
+            return -1;
+        }
+        lconv_column *column = lconv_column_get(columns, stack, tsvalue(ref(L, n)));
+        PyObject *value;
+        if (!column || !(value = lconv_leaf(interpreter, stack, val(L, n))))
+            return -1;
+        Py_DECREF(PyList_GET_ITEM(column->list, row));
+        PyList_SET_ITEM(column->list, row, value);
+    }
+    return 0;
+}
+
+/**
+ * Converts the array of records ({{ts=1, v=2}, ...}) to a dict of lists (one per key,
+ * None where the record has no such field), in one pass over the records.
+ **/
+PyObject *lua_interpreter_columns_convert(InterpreterObject *interpreter, TObject *o) {
+    lua_State *L = interpreter->L;
+    int size = ttype(o) == LUA_T_ARRAY ? lraw_array_size(L, avalue(o)) : -1, row;
+    if (size < 0) {
+        PyErr_SetString(PyExc_TypeError, "array of records expected (table with the keys 1..n)");
+        return NULL;
+    }
+    lconv_stack stack = {NULL, 0, 0};
+    lstring_codec_get(L, &stack.codec);
+    lconv_columns columns = {NULL, 0, 0, 0, size, PyDict_New()};
+    for (row = 0; columns.dict && row < size; row++) {
+        TObject *record = luaH_getint(L, avalue(o), row + 1);
+        if (ttype(record) != LUA_T_ARRAY) {
+            PyErr_Format(PyExc_TypeError, "record (table) expected at index %d", row + 1);
+            Py_CLEAR(columns.dict);
+        } else if (lconv_record(interpreter, &stack, &columns, avalue(record), row) != 0) {
+            Py_CLEAR(columns.dict);
+        }
+    }
+    free(columns.items);
+    return columns.dict;
+}
+
+/* python.columns(records): dict of lists (one per field) */
+void py_columns(lua_State *L) {
+    lua_Object ltable = lua_getparam(L, 1);
+    luaL_arg_check(L, lua_istable(L, ltable), 1, "table expected");
+    InterpreterObject interpreter;
+    interpreter.isPyType = false;
+    interpreter.L = L;
+    PyObject *dict = lua_interpreter_columns_convert(&interpreter, lapi_address(L, ltable));
+    if (!dict) lua_new_error(L, "failed to convert the records to columns");
+    push_pyobject_container(L, dict, true);
+}
+
 PyObject *lua_object_convert(lua_State *L, lua_Object lobj) {
     InterpreterObject interpreter;
     interpreter.isPyType = false;
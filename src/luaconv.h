@@ -13,8 +13,12 @@ typedef struct {
     bool asindx;
     bool isargs;
     bool iskwargs;
+    bool optional;  // missing index/attribute is nil (python.optional)
 } py_object;
 
+PyObject *LuaObject_New(InterpreterObject *interpreter, lua_Object lobj);
+void *lua_object_identity(lua_State *L, lua_Object lobj);
+void lua_object_uncache(InterpreterObject *interpreter, void *identity, PyObject *obj);
 int lua_gettop(lua_State *L);
 PyObject *get_pobject(lua_State *L, lua_Object userdata);
 py_object *get_py_object(lua_State *L, lua_Object userdata);
@@ -32,10 +36,18 @@ void py_args_array(lua_State *L);
 void py_kwargs(lua_State *L);
 void py_args(lua_State *L);
 
+PyObject *lua_number_convert(double num);
 PyObject *lua_object_convert(lua_State *L, lua_Object lobj);
 PyObject *lua_stack_convert(lua_State *L, int stackpos);
 PyObject *lua_interpreter_object_convert(InterpreterObject *interpreter,
                                          lua_Object lobj);
 PyObject *lua_interpreter_stack_convert(InterpreterObject *interpreter,
                                         int stackpos);
+PyObject *lua_interpreter_tobject_convert(InterpreterObject *interpreter,
+                                          struct TObject *o);
+PyObject *lua_interpreter_deep_convert(InterpreterObject *interpreter,
+                                       struct TObject *o, int max_depth);
+PyObject *lua_interpreter_columns_convert(InterpreterObject *interpreter,
+                                          struct TObject *o);
+void py_columns(lua_State *L);
 #endif //LUNATIC_LUACONV_H
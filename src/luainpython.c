@@ -27,7 +27,22 @@
 #include "luainpython.h"
 #include "pyconv.h"
 #include "utils.h"
+#include "constants.h"
 #include "lshared.h"
+#include "pool.h"
+#include "recycle.h"
+#include "bytecode.h"
+#include "owner.h"
+#include "process.h"
+#include "luaview.h"
+#include "pydispatch.h"
+#include "luaarray.h"
+#include "lnumeric.h"
+#include "schema.h"
+#include "lpack.h"
+#include "lregistry.h"
+#include "freelist.h"
+#include "lcycle.h"
 
 #if defined(_WIN32)
 #include "lapi.h"
@@ -40,10 +55,11 @@
 #endif
 
 
-static PyObject *LuaCall(LuaObject *self, lua_Object lobj, PyObject *args) {
+/* Pushes the items of the tuple as arguments of a Lua call */
+int LuaPushArgs(InterpreterObject *interpreter, PyObject *args) {
     if (!PyTuple_Check(args)) {
         PyErr_SetString(PyExc_TypeError, "tuple expected");
-        return NULL;
+        return -1;
     }
     PyObject *arg;
     int nargs, index;
@@ -52,9 +68,9 @@ static PyObject *LuaCall(LuaObject *self, lua_Object lobj, PyObject *args) {
         arg = PyTuple_GetItem(args, index); // Borrowed reference.
         if (arg == NULL) {
             PyErr_Format(PyExc_TypeError, "failed to get tuple item #%d", index);
-            return NULL;
+            return -1;
         }
-        switch (py_convert(self->interpreter->L, arg)) {
+        switch (py_convert(interpreter->L, arg)) {
             case WRAPPED: // The object is being managed by the Lua
                 Py_INCREF(arg); // PyTuple_GetItem (Borrowed reference)
                 break;
@@ -62,23 +78,19 @@ static PyObject *LuaCall(LuaObject *self, lua_Object lobj, PyObject *args) {
                 break; // nop
             default:
                 PyErr_Format(PyExc_TypeError, "failed to convert argument #%d", index);
-                return NULL;
+                return -1;
         }
     }
-    if (lua_callfunction(self->interpreter->L, lobj)) {
-        char *name;  // get function name
-        lua_getobjname(self->interpreter->L, lobj, &name);
-        name = name ? name : "?";
-        char *format = "call function lua (%s)";
-        char buff[buffsize_calc(2, format, name)];
-        sprintf(buff, format, name);
-        python_new_error(PyExc_RuntimeError, &buff[0]);
-        return NULL;
-    }
-    PyObject *ret;
-    nargs = lua_gettop(self->interpreter->L);
+    return 0;
+}
+
+/* Converts the results of a Lua call (None, value or tuple of values) */
+PyObject *LuaResults(InterpreterObject *interpreter) {
+    PyObject *ret, *arg;
+    int nargs, index;
+    nargs = lua_gettop(interpreter->L);
     if (nargs == 1) {
-        ret = lua_interpreter_stack_convert(self->interpreter, 1);
+        ret = lua_interpreter_stack_convert(interpreter, 1);
         if (!ret) {
             PyErr_SetString(PyExc_TypeError, "failed to convert return");
             return NULL;
@@ -90,7 +102,7 @@ static PyObject *LuaCall(LuaObject *self, lua_Object lobj, PyObject *args) {
             return NULL;
         }
         for (index = 0; index < nargs; index++) {
-            arg = lua_interpreter_stack_convert(self->interpreter, index + 1);
+            arg = lua_interpreter_stack_convert(interpreter, index + 1);
             if (!arg) {
                 PyErr_Format(PyExc_TypeError, "failed to convert return #%d", index);
                 Py_DECREF(ret);
@@ -105,87 +117,152 @@ static PyObject *LuaCall(LuaObject *self, lua_Object lobj, PyObject *args) {
     return ret;
 }
 
+static PyObject *LuaCall(LuaObject *self, lua_Object lobj, PyObject *args) {
+    if (LuaPushArgs(self->interpreter, args) != 0)
+        return NULL;
+    if (lua_callfunction(self->interpreter->L, lobj)) {
+        char *name;  // get function name
+        lua_getobjname(self->interpreter->L, lobj, &name);
+        name = name ? name : "?";
+        char *format = "call function lua (%s)";
+        char buff[buffsize_calc(2, format, name)];
+        sprintf(buff, format, name);
+        python_new_error(PyExc_RuntimeError, &buff[0]);
+        return NULL;
+    }
+    return LuaResults(self->interpreter);
+}
+
 static void LuaObject_dealloc(LuaObject *self) {
+    PyObject_GC_UnTrack(self);
+    if (self->weakreflist)
+        PyObject_ClearWeakRefs((PyObject *) self);
+    if (self->identity)  // cached (interpreter python)
+        lua_object_uncache(self->interpreter, self->identity, NULL);
+    free(self->reach);
     if (self->interpreter) { // blocked in init ?
-        lua_unref(self->interpreter->L, self->ref);
-        if (!self->interpreter->isPyType) {
+        if (LUA_OWNER_OTHER(self->interpreter)) {
+            lua_owner_unref(self->interpreter, self->ref); // releases the interpreter
+        } else if (!self->interpreter->isPyType) {
+            lregistry_unref(self->interpreter->L, self->ref);
             self->interpreter->L = NULL;
             free(self->interpreter);
         } else {
+            LUA_STATE_ACQUIRE(self->interpreter);
+            lregistry_unref(self->interpreter->L, self->ref);
+            LUA_STATE_RELEASE(self->interpreter);
             Py_DECREF(self->interpreter);
         }
     }
-    Py_TYPE(self)->tp_free((PyObject *)self);
+    if (Py_TYPE(self) != &LuaObject_Type || !lua_freelist_push(&LuaObject_freelist, (PyObject *) self))
+        Py_TYPE(self)->tp_free((PyObject *)self);
 }
 
-static PyObject *LuaObject_getattr(LuaObject *self, PyObject *attr) {
+static PyObject *LuaObject_getitem(LuaObject *self, PyObject *attr, bool attribute) {
+    LUA_STATE_ACQUIRE(self->interpreter);
     lua_beginblock(self->interpreter->L);
-    lua_Object ltable = lua_getref(self->interpreter->L, self->ref);
+    PyObject *ret = NULL;
+    lua_Object ltable = lregistry_get(self->interpreter->L, self->ref);
     if (lua_isnil(self->interpreter->L, ltable)) {
         PyErr_SetString(PyExc_RuntimeError, "lost reference");
-        return NULL;
     } else if (!lua_istable(self->interpreter->L, ltable) &&
                !lua_isuserdata(self->interpreter->L, ltable)) {
         PyErr_SetString(PyExc_RuntimeError, "not an indexable value");
-        return NULL;
-    }
-    PyObject *ret = NULL;
-    lua_pushobject(self->interpreter->L, ltable); // push table
-    if (py_convert(self->interpreter->L, attr) != UNCHANGED) { // push key
-        lua_Object lobj = lua_gettable(self->interpreter->L);
-        ret = lua_interpreter_object_convert(self->interpreter, lobj); // convert
     } else {
-        PyErr_SetString(PyExc_ValueError, "can't convert attr/key");
+        lua_pushobject(self->interpreter->L, ltable); // push table
+        if (py_convert(self->interpreter->L, attr) != UNCHANGED) { // push key
+            lua_Object lobj = lua_gettable(self->interpreter->L);
+            ret = lua_interpreter_object_convert(self->interpreter, lobj); // convert
+        } else {
+            PyErr_SetString(PyExc_ValueError, "can't convert attr/key");
+        }
     }
     lua_endblock(self->interpreter->L);
+    LUA_STATE_RELEASE(self->interpreter);
+    if (attribute && ret == Py_None) { // methods (items, keys, ...) when the field is nil
+        PyObject *method = PyObject_GenericGetAttr((PyObject *) self, attr);
+        if (method) {
+            Py_DECREF(ret);
+            ret = method;
+        } else if (PyErr_ExceptionMatches(PyExc_AttributeError)) {
+            PyErr_Clear();
+        } else {
+            Py_CLEAR(ret);
+        }
+    }
     return ret;
 }
 
+static PyObject *LuaObject_getattr(LuaObject *self, PyObject *attr) {
+    LUA_OWNER_CALL(self->interpreter, LuaObject_getattr, self, attr, NULL);
+    return LuaObject_getitem(self, attr, true);
+}
+
+static PyObject *LuaObject_setattr_owner(LuaObject *self, PyObject *attr, PyObject *value);
+
 static int LuaObject_setattr(LuaObject *self, PyObject *attr, PyObject *value) {
+    if (LUA_OWNER_OTHER(self->interpreter)) {
+        PyObject *res = lua_owner_call(self->interpreter, (lua_owner_fn) LuaObject_setattr_owner,
+                                       (PyObject *) self, attr, value);
+        Py_XDECREF(res);
+        return res ? 0 : -1;
+    }
+    LUA_STATE_ACQUIRE(self->interpreter);
     lua_beginblock(self->interpreter->L);
     int ret = -1;
-    lua_Object ltable = lua_getref(self->interpreter->L, self->ref);
+    lua_Object ltable = lregistry_get(self->interpreter->L, self->ref);
     if (lua_isnil(self->interpreter->L, ltable)) {
         PyErr_SetString(PyExc_RuntimeError, "lost reference");
-        return ret;
     } else if (!lua_istable(self->interpreter->L, ltable) &&
                !lua_isuserdata(self->interpreter->L, ltable)) {
         PyErr_SetString(PyExc_TypeError, "Lua object is not a table");
-        return ret;
-    }
-    lua_pushobject(self->interpreter->L, ltable); // push table
-    Conversion res = py_convert(self->interpreter->L, attr);
-    if (isvalidstatus(res)) {
-        if (value == NULL) {
-            lua_pushnil(self->interpreter->L);
-            res = CONVERTED;
-        } else {
-            res = py_convert(self->interpreter->L, value); // push value ?
-        }
+    } else {
+        lua_pushobject(self->interpreter->L, ltable); // push table
+        Conversion res = py_convert(self->interpreter->L, attr);
         if (isvalidstatus(res)) {
-            lua_settable(self->interpreter->L);
-            self->indexed = is_indexed_array(self->interpreter->L, ltable);
-            ret = 0;
+            if (value == NULL) {
+                lua_pushnil(self->interpreter->L);
+                res = CONVERTED;
+            } else {
+                res = py_convert(self->interpreter->L, value); // push value ?
+            }
+            if (isvalidstatus(res)) {
+                lua_settable(self->interpreter->L);
+                self->indexed = is_indexed_array(self->interpreter->L, ltable);
+                ret = 0;
+            } else {
+                PyErr_SetString(PyExc_ValueError, "can't convert value");
+            }
         } else {
-            PyErr_SetString(PyExc_ValueError, "can't convert value");
+            PyErr_SetString(PyExc_ValueError, "can't convert key/attr");
         }
-    } else {
-        PyErr_SetString(PyExc_ValueError, "can't convert key/attr");
     }
     lua_endblock(self->interpreter->L);
+    LUA_STATE_RELEASE(self->interpreter);
     return ret;
 }
 
+/* LuaObject_setattr executed by the owner thread */
+static PyObject *LuaObject_setattr_owner(LuaObject *self, PyObject *attr, PyObject *value) {
+    if (LuaObject_setattr(self, attr, value) != 0)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
 static PyObject *LuaObject_str(LuaObject *self) {
+    LUA_OWNER_CALL(self->interpreter, LuaObject_str, self, NULL, NULL);
+    LUA_STATE_ACQUIRE(self->interpreter);
     lua_beginblock(self->interpreter->L);
-    lua_Object lobj = lua_getref(self->interpreter->L, self->ref);
+    lua_Object lobj = lregistry_get(self->interpreter->L, self->ref);
     TObject *o = lapi_address(self->interpreter->L, lobj);
     char buff[64];
     switch (ttype(o)) { // Lua 3.2 source code builtin.c
         case LUA_T_NUMBER:
-            return PyString_FromFormat("<Lua number %ld>", (long) lua_getnumber(self->interpreter->L, lobj));
+            sprintf(buff, "<Lua number %ld>", (long) lua_getnumber(self->interpreter->L, lobj));
+            break;
         case LUA_T_STRING:
-            return PyString_FromFormat("<Lua string size %ld>", lua_strlen(self->interpreter->L, lobj));
+            sprintf(buff, "<Lua string size %ld>", lua_strlen(self->interpreter->L, lobj));
+            break;
         case LUA_T_ARRAY:
             sprintf(buff, "<Lua table at %p>", (void *)o->value.a);
             break;
@@ -202,19 +279,24 @@ static PyObject *LuaObject_str(LuaObject *self) {
             sprintf(buff, "<Lua userdata at %p>", o->value.ts->u.d.v);
             break;
         case LUA_T_NIL:
-            return PyString_FromString("nil");
+            strcpy(buff, "nil");
+            break;
         default:
-            return PyString_FromString("invalid type");
+            strcpy(buff, "invalid type");
     }
     lua_endblock(self->interpreter->L);
+    LUA_STATE_RELEASE(self->interpreter);
     return PyString_FromString(buff);
 }
 
 static PyObject *LuaObject_call(LuaObject *self, PyObject *args) {
+    LUA_OWNER_CALL(self->interpreter, LuaObject_call, self, args, NULL);
+    LUA_STATE_ACQUIRE(self->interpreter);
     lua_beginblock(self->interpreter->L);
-    lua_Object lobj = lua_getref(self->interpreter->L, self->ref);
+    lua_Object lobj = lregistry_get(self->interpreter->L, self->ref);
     PyObject *ret = LuaCall(self, lobj, args);
     lua_endblock(self->interpreter->L);
+    LUA_STATE_RELEASE(self->interpreter);
     return ret;
 }
 
@@ -225,34 +307,40 @@ typedef struct {
     Py_ssize_t refiter;
 } luaiterobject;
 
+extern PyTypeObject LuaObjectIter_Type;
+
 static PyObject *LuaObjectIter_next(luaiterobject *li) {
-    lua_State *L = li->luaobject->interpreter->L;
+    InterpreterObject *interpreter = li->luaobject->interpreter;
+    lua_State *L = interpreter->L;
+    PyObject *ret = NULL;
+    LUA_OWNER_CALL(interpreter, LuaObjectIter_next, li, NULL, NULL);
+    LUA_STATE_ACQUIRE(interpreter);
     lua_beginblock(L);
-    lua_Object ltable = lua_getref(L, li->luaobject->ref);
+    lua_Object ltable = lregistry_get(L, li->luaobject->ref);
     if (lua_isnil(L, ltable)) {
         PyErr_SetString(PyExc_RuntimeError, "lost reference");
-        return NULL;
     } else if (!lua_istable(L, ltable) && !lua_isuserdata(L, ltable)) {
         PyErr_SetString(PyExc_TypeError, "Lua object is not iterable!");
-        return NULL;
-    }
-    PyObject *ret = NULL;
-    /* Save key for next iteration. */
-    li->refiter = lua_next(L, ltable, li->refiter);
-    if (li->refiter > 0) {
-        int argn = li->luaobject->indexed ? 2 : 1;
-        ret = lua_interpreter_stack_convert(li->luaobject->interpreter, argn);  // value / key
     } else {
-        /* Raising of standard StopIteration exception with empty value. */
-        PyErr_SetNone(PyExc_StopIteration);
+        /* Save key for next iteration. */
+        li->refiter = lua_next(L, ltable, li->refiter);
+        if (li->refiter > 0) {
+            int argn = li->luaobject->indexed ? 2 : 1;
+            ret = lua_interpreter_stack_convert(interpreter, argn);  // value / key
+        } else {
+            /* Raising of standard StopIteration exception with empty value. */
+            PyErr_SetNone(PyExc_StopIteration);
+        }
     }
     lua_endblock(L);
+    LUA_STATE_RELEASE(interpreter);
     return ret;
 }
 
 static void LuaObjectIter_dealloc(luaiterobject *li) {
     Py_XDECREF(li->luaobject);
-    PyObject_GC_Del(li);
+    if (Py_TYPE(li) != &LuaObjectIter_Type || !lua_freelist_push(&LuaObjectIter_freelist, (PyObject *) li))
+        PyObject_GC_Del(li);
 }
 
 PyTypeObject LuaObjectIter_Type = {
@@ -288,8 +376,11 @@ PyTypeObject LuaObjectIter_Type = {
 };
 
 static PyObject *LuaObjectIter_new(LuaObject *luaobject, PyTypeObject *itertype) {
-    luaiterobject *li;
-    li = PyObject_GC_New(luaiterobject, itertype);
+    luaiterobject *li = NULL;
+    if (itertype == &LuaObjectIter_Type)
+        li = (luaiterobject *) lua_freelist_pop(&LuaObjectIter_freelist);
+    if (li == NULL)
+        li = PyObject_GC_New(luaiterobject, itertype);
     if (li == NULL)
         return NULL;
     Py_INCREF(luaobject);
@@ -302,10 +393,20 @@ static PyObject *LuaObject_iter(LuaObject *self) {
     return LuaObjectIter_new(self, &LuaObjectIter_Type);
 }
 
+static PyObject *LuaObject_length_owner(LuaObject *self);
+
 static int LuaObject_length(LuaObject *self) {
+    if (LUA_OWNER_OTHER(self->interpreter)) {
+        PyObject *res = lua_owner_call(self->interpreter, (lua_owner_fn) LuaObject_length_owner,
+                                       (PyObject *) self, NULL, NULL);
+        int len = res ? (int) PyInt_AsLong(res) : 0;
+        Py_XDECREF(res);
+        return len;
+    }
+    LUA_STATE_ACQUIRE(self->interpreter);
     lua_beginblock(self->interpreter->L);
     int len = 0;
-    lua_Object lobj = lua_getref(self->interpreter->L, self->ref);
+    lua_Object lobj = lregistry_get(self->interpreter->L, self->ref);
     if (lua_isfunction(self->interpreter->L, lobj)) {
         len = 1;  // 1 is True
     } else if (lua_isstring(self->interpreter->L, lobj)) {
@@ -314,17 +415,148 @@ static int LuaObject_length(LuaObject *self) {
         len = lua_tablesize(self->interpreter->L, lobj);
     }
     lua_endblock(self->interpreter->L);
+    LUA_STATE_RELEASE(self->interpreter);
     return len;
 }
 
+/* LuaObject_length executed by the owner thread */
+static PyObject *LuaObject_length_owner(LuaObject *self) {
+    return PyInt_FromLong(LuaObject_length(self));
+}
+
 static PyObject *LuaObject_subscript(LuaObject *self, PyObject *key) {
-    return LuaObject_getattr(self, key);
+    LUA_OWNER_CALL(self->interpreter, LuaObject_subscript, self, key, NULL);
+    return LuaObject_getitem(self, key, false);
 }
 
 static int LuaObject_ass_subscript(LuaObject *self, PyObject *key, PyObject *value) {
     return LuaObject_setattr(self, key, value);
 }
 
+/* Copy of the value in Python objects (tables as tuples / dicts up to max_depth) */
+static PyObject *LuaObject_to_python(LuaObject *self, PyObject *args, PyObject *kwargs) {
+    LUA_OWNER_CALL(self->interpreter, LuaObject_to_python, self, args, kwargs);
+    static char *kwlist[] = {"deep", "max_depth", NULL};
+    PyObject *deep = Py_True;
+    int max_depth = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|Oi:to_python", kwlist, &deep, &max_depth))
+        return NULL;
+    if (max_depth < 0) {
+        PyErr_SetString(PyExc_ValueError, "max_depth must be positive (0 unlimited)");
+        return NULL;
+    }
+    if (!PyObject_IsTrue(deep))
+        max_depth = 1;  // the subtables as LuaObject
+    LUA_STATE_ACQUIRE(self->interpreter);
+    lua_beginblock(self->interpreter->L);
+    lua_Object lobj = lregistry_get(self->interpreter->L, self->ref);
+    PyObject *ret = lua_interpreter_deep_convert(self->interpreter,
+                                                 lapi_address(self->interpreter->L, lobj), max_depth);
+    lua_endblock(self->interpreter->L);
+    LUA_STATE_RELEASE(self->interpreter);
+    return ret;
+}
+
+static PyObject *LuaObject_to_array(LuaObject *self, PyObject *args) {
+    LUA_OWNER_CALL(self->interpreter, LuaObject_to_array, self, args, NULL);
+    const char *typecode = "d";
+    if (!PyArg_ParseTuple(args, "|s:to_array", &typecode))
+        return NULL;
+    LUA_STATE_ACQUIRE(self->interpreter);
+    lua_beginblock(self->interpreter->L);
+    lua_Object lobj = lregistry_get(self->interpreter->L, self->ref);
+    PyObject *ret = NULL;
+    if (lua_istable(self->interpreter->L, lobj)) {
+        ret = lnum_table_array(self->interpreter->L, avalue(lapi_address(self->interpreter->L, lobj)), typecode);
+    } else {
+        PyErr_SetString(PyExc_TypeError, "table expected");
+    }
+    lua_endblock(self->interpreter->L);
+    LUA_STATE_RELEASE(self->interpreter);
+    return ret;
+}
+
+static PyObject *LuaObject_to_columns(LuaObject *self, PyObject *args) {
+    LUA_OWNER_CALL(self->interpreter, LuaObject_to_columns, self, args, NULL);
+    LUA_STATE_ACQUIRE(self->interpreter);
+    lua_beginblock(self->interpreter->L);
+    lua_Object lobj = lregistry_get(self->interpreter->L, self->ref);
+    PyObject *ret = lua_interpreter_columns_convert(self->interpreter,
+                                                    lapi_address(self->interpreter->L, lobj));
+    lua_endblock(self->interpreter->L);
+    LUA_STATE_RELEASE(self->interpreter);
+    return ret;
+}
+
+static PyObject *LuaObject_items(LuaObject *self) {
+    return LuaObjectView_New(self, LUA_VIEW_ITEMS);
+}
+
+static PyObject *LuaObject_keys(LuaObject *self) {
+    return LuaObjectView_New(self, LUA_VIEW_KEYS);
+}
+
+static PyObject *LuaObject_values(LuaObject *self) {
+    return LuaObjectView_New(self, LUA_VIEW_VALUES);
+}
+
+static PyMethodDef LuaObject_methods[] = {
+    {"to_python", (PyCFunction) LuaObject_to_python, METH_VARARGS | METH_KEYWORDS,
+     "Converts the table and its subtables (shared or cyclic tables are converted once)."},
+    {"to_array", (PyCFunction) LuaObject_to_array, METH_VARARGS,
+     "Converts the numeric array (keys 1..n) to array.array(typecode='d') in one pass."},
+    {"to_columns", (PyCFunction) LuaObject_to_columns, METH_NOARGS,
+     "Converts the array of records to a dict of lists (one per field)."},
+    {"items", (PyCFunction) LuaObject_items, METH_NOARGS,
+     "View of the (key, value) pairs of the table (arrays in index order)."},
+    {"keys", (PyCFunction) LuaObject_keys, METH_NOARGS,
+     "View of the keys of the table."},
+    {"values", (PyCFunction) LuaObject_values, METH_NOARGS,
+     "View of the values of the table."},
+    {NULL, NULL}
+};
+
+/* Objects of the containers reachable only from its value (set by Interpreter.collect) */
+static int LuaObject_traverse(LuaObject *self, visitproc visit, void *arg) {
+    Py_ssize_t index;
+    for (index = 0; index < self->nreach; index++)
+        Py_VISIT(self->reach[index]);
+    return 0;
+}
+
+/* Breaks a cycle found by the Python collector: the Lua value is released */
+static int LuaObject_clear(LuaObject *self) {
+    free(self->reach);
+    self->reach = NULL;
+    self->nreach = 0;
+    if (self->identity) {
+        lua_object_uncache(self->interpreter, self->identity, (PyObject *) self);
+        self->identity = NULL;
+    }
+    if (self->interpreter && self->interpreter->isPyType && !LUA_OWNER_OTHER(self->interpreter)) {
+        LUA_STATE_ACQUIRE(self->interpreter);
+        lregistry_unref(self->interpreter->L, self->ref);
+        self->ref = LREGISTRY_REFNIL;
+        LUA_STATE_RELEASE(self->interpreter);
+    }
+    return 0;
+}
+
+/* Wrappers of the same table, function or userdata are equal (identity) */
+static PyObject *LuaObject_richcompare(PyObject *self, PyObject *other, int op) {
+    if ((op != Py_EQ && op != Py_NE) || !LuaObject_Check(other)) {
+        Py_INCREF(Py_NotImplemented);
+        return Py_NotImplemented;
+    }
+    void *identity = ((LuaObject *) self)->identity;
+    bool equal = self == other || (identity && identity == ((LuaObject *) other)->identity);
+    return PyBool_FromLong(op == Py_EQ ? equal : !equal);
+}
+
+static long LuaObject_hash(LuaObject *self) {
+    return _Py_HashPointer(self->identity ? self->identity : (void *) self);
+}
+
 static int LuaObject_init(LuaObject *self, PyObject *args, PyObject *kwargs) {
     self->interpreter = NULL;
     PyErr_SetString(PyExc_NotImplementedError,
@@ -357,21 +589,21 @@ PyTypeObject LuaObject_Type = {
     0,                        /*tp_as_number*/
     0,                        /*tp_as_sequence*/
     &LuaObject_as_mapping,    /*tp_as_mapping*/
-    0,                        /*tp_hash*/
+    (hashfunc) LuaObject_hash, /*tp_hash*/
     (ternaryfunc) LuaObject_call, /*tp_call*/
     (reprfunc) LuaObject_str, /*tp_str*/
     (getattrofunc) LuaObject_getattr, /*tp_getattro*/
     (setattrofunc) LuaObject_setattr, /*tp_setattro*/
     0,                        /*tp_as_buffer*/
-    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE, /*tp_flags*/
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_HAVE_GC, /*tp_flags*/
     "custom lua object",      /*tp_doc*/
-    0,                        /*tp_traverse*/
-    0,                        /*tp_clear*/
-    0,                        /*tp_richcompare*/
-    0,                        /*tp_weaklistoffset*/
+    (traverseproc) LuaObject_traverse, /*tp_traverse*/
+    (inquiry) LuaObject_clear, /*tp_clear*/
+    LuaObject_richcompare,    /*tp_richcompare*/
+    offsetof(LuaObject, weakreflist), /*tp_weaklistoffset*/
     (getiterfunc) LuaObject_iter, /*tp_iter*/
     0,                        /*tp_iternext*/
-    0,                        /*tp_methods*/
+    LuaObject_methods,        /*tp_methods*/
     0,                        /*tp_members*/
     0,                        /*tp_getset*/
     0,                        /*tp_base*/
@@ -382,13 +614,12 @@ PyTypeObject LuaObject_Type = {
     (initproc) LuaObject_init,/*tp_init*/
     PyType_GenericAlloc,      /*tp_alloc*/
     PyType_GenericNew,        /*tp_new*/
-    PyObject_Del,             /*tp_free*/
+    PyObject_GC_Del,          /*tp_free*/
     0,                        /*tp_is_gc*/
 };
 
 
 PyObject *Lua_run(InterpreterObject *self, PyObject *args, int eval) {
-    lua_beginblock(self->L);
     PyObject *ret = NULL;
     char *buf = NULL;
     char *s;
@@ -397,6 +628,8 @@ PyObject *Lua_run(InterpreterObject *self, PyObject *args, int eval) {
     if (!PyArg_ParseTuple(args, "s#", &s, &len))
         return NULL;
 
+    LUA_STATE_ACQUIRE(self);
+    lua_beginblock(self->L);
     if (eval) {
         char *prefix = "return ";
         buf = (char *) malloc(strlen(prefix) + len + 1);
@@ -411,6 +644,8 @@ PyObject *Lua_run(InterpreterObject *self, PyObject *args, int eval) {
         sprintf(buff, format, s);
         python_new_error(PyExc_RuntimeError, &buff[0]);
         if (eval) free(buf);
+        lua_endblock(self->L);
+        LUA_STATE_RELEASE(self);
         return NULL;
     }
     if (eval) free(buf);
@@ -423,6 +658,7 @@ PyObject *Lua_run(InterpreterObject *self, PyObject *args, int eval) {
         ret = Py_None;
     }
     lua_endblock(self->L);
+    LUA_STATE_RELEASE(self);
     return ret;
 }
 
@@ -431,60 +667,201 @@ PyObject *Lua_setglobal(InterpreterObject *self, PyObject *args) {
     const char *name = NULL;
     PyObject *pyObject = NULL;
 
+    LUA_OWNER_CALL(self, Lua_setglobal, self, args, NULL);
+
     if (!PyArg_ParseTuple(args, "sO", &name, &pyObject))
         return NULL;
 
+    LUA_STATE_ACQUIRE(self);
     push_pyobject_container(self->L, pyObject, check_pyobject_index(pyObject));
     Py_INCREF(pyObject); // lua ref
 
     lua_setglobal(self->L, (char *) name);
+    LUA_STATE_RELEASE(self);
     Py_RETURN_NONE;
 }
 
 
 PyObject *Interpreter_execute(InterpreterObject *self, PyObject *args) {
+    LUA_OWNER_CALL(self, Interpreter_execute, self, args, NULL);
     return Lua_run(self, args, 0);
 }
 
 PyObject *Interpreter_eval(InterpreterObject *self, PyObject *args) {
+    LUA_OWNER_CALL(self, Interpreter_eval, self, args, NULL);
     return Lua_run(self, args, 1);
 }
 
 PyObject *Interpreter_globals(InterpreterObject *self, PyObject *args) {
     PyObject *ret = NULL;
+    LUA_OWNER_CALL(self, Interpreter_globals, self, args, NULL);
+    LUA_STATE_ACQUIRE(self);
+    lua_beginblock(self->L);
     lua_Object lobj = lua_getglobal(self->L, "_G");
     if (lua_isnil(self->L, lobj)) {
         PyErr_SetString(PyExc_RuntimeError, "lost globals reference");
-        return NULL;
-    }
-    ret = lua_interpreter_stack_convert(self, 1);
-    if (!ret)
+    } else if (!(ret = lua_interpreter_object_convert(self, lobj))) {
         PyErr_Format(PyExc_TypeError, "failed to convert globals table");
+    }
+    lua_endblock(self->L);
+    LUA_STATE_RELEASE(self);
     return ret;
 }
 
 static PyObject *Interpreter_dofile(InterpreterObject *self, PyObject *args) {
-    lua_beginblock(self->L);
     const char *command = NULL;
+    LUA_OWNER_CALL(self, Interpreter_dofile, self, args, NULL);
 
     if (!PyArg_ParseTuple(args, "s", &command))
         return NULL;
 
-    int ret = lua_dofile(self->L, (char *) command);
-    if (ret) {
-        if (!PyErr_GivenExceptionMatches(PyErr_Occurred(), PyExc_SystemExit)) {
-            python_new_error(PyExc_ImportError, (char *) command);
-        }
+    char cached[1024];
+    const char *filename = lua_bytecode_cache_lookup(command, cached, sizeof(cached));
+    LUA_STATE_ACQUIRE(self);
+    lua_beginblock(self->L);
+    int ret = lua_dofile(self->L, (char *) filename);
+    if (ret && !PyErr_GivenExceptionMatches(PyErr_Occurred(), PyExc_SystemExit)) {
+        python_new_error(PyExc_ImportError, (char *) command);
+    }
+    lua_endblock(self->L);
+    LUA_STATE_RELEASE(self);
+    return ret ? NULL : PyInt_FromLong(ret);
+}
+
+/* Converts the dict, list or tuple (and its containers) into a new table */
+static PyObject *Interpreter_to_lua(InterpreterObject *self, PyObject *obj) {
+    PyObject *ret = NULL;
+    LUA_OWNER_CALL(self, Interpreter_to_lua, self, obj, NULL);
+    LUA_STATE_ACQUIRE(self);
+    lua_beginblock(self->L);
+    lua_Object ltable = py_object_table(self->L, obj);
+    if (ltable != LUA_NOOBJECT)
+        ret = LuaObject_New(self, ltable);
+    lua_endblock(self->L);
+    LUA_STATE_RELEASE(self);
+    return ret;
+}
+
+static PyObject *Interpreter_schema(InterpreterObject *self, PyObject *args) {
+    PyObject *cls, *fields;
+    if (!PyArg_ParseTuple(args, "O!O:schema", &PyType_Type, &cls, &fields))
+        return NULL;
+    PyObject *schema = Schema_New((PyTypeObject *) cls, fields, self);
+    if (schema && schema_register((SchemaObject *) schema) != 0)
+        Py_CLEAR(schema);
+    return schema;
+}
+
+/* Snapshot (bytes) of the Lua value (LuaObject) or of the python data */
+static PyObject *Interpreter_pack(InterpreterObject *self, PyObject *obj) {
+    LUA_OWNER_CALL(self, Interpreter_pack, self, obj, NULL);
+    PyObject *ret = NULL;
+    const char *error = NULL;
+    lpack_buffer buf;
+    lpack_buffer_init(&buf);
+    if (lpack_header(&buf) != 0) {
+        error = "not enough memory";
+    } else if (LuaObject_Check(obj)) {
+        LUA_STATE_ACQUIRE(self);
+        lua_beginblock(self->L);
+        error = lpack_lua(self->L, &buf, lregistry_get(self->L, ((LuaObject *) obj)->ref));
+        lua_endblock(self->L);
+        LUA_STATE_RELEASE(self);
+    } else if (lpack_python(&buf, obj) != 0) {
+        lpack_buffer_free(&buf);
         return NULL;
     }
+    if (error) {
+        PyErr_Format(PyExc_ValueError, "pack: %s", error);
+    } else {
+        ret = PyBytes_FromStringAndSize(buf.data, (Py_ssize_t) buf.size);
+    }
+    lpack_buffer_free(&buf);
+    return ret;
+}
+
+/* Decodes the snapshot in the state (no python objects in the middle) */
+static PyObject *Interpreter_unpack_reader(InterpreterObject *self, lpack_reader *reader) {
+    PyObject *ret = NULL;
+    const char *error = lunpack_header(reader);
+    if (error) {
+        PyErr_Format(PyExc_ValueError, "unpack: %s", error);
+        return NULL;
+    }
+    LUA_STATE_ACQUIRE(self);
+    lua_beginblock(self->L);
+    if ((error = lunpack_lua(self->L, reader))) {
+        PyErr_Format(PyExc_ValueError, "unpack: %s", error);
+    } else {
+        ret = lua_interpreter_object_convert(self, lua_pop(self->L));
+    }
     lua_endblock(self->L);
-    return PyInt_FromLong(ret);
+    LUA_STATE_RELEASE(self);
+    return ret;
+}
+
+static PyObject *Interpreter_unpack(InterpreterObject *self, PyObject *data) {
+    LUA_OWNER_CALL(self, Interpreter_unpack, self, data, NULL);
+    lpack_reader reader;
+    Py_buffer view;
+    if (lpack_reader_buffer(&reader, data, &view) != 0)
+        return NULL;
+    PyObject *ret = Interpreter_unpack_reader(self, &reader);
+    lpack_reader_release(&view);
+    return ret;
+}
+
+static PyObject *Interpreter_unpack_file(InterpreterObject *self, PyObject *args) {
+    LUA_OWNER_CALL(self, Interpreter_unpack_file, self, args, NULL);
+    lpack_reader reader;
+    char *path;
+    if (!PyArg_ParseTuple(args, "s:unpack_file", &path))
+        return NULL;
+    if (lpack_reader_map(&reader, path) != 0)
+        return PyErr_SetFromErrnoWithFilename(PyExc_IOError, path);
+    PyObject *ret = Interpreter_unpack_reader(self, &reader);
+    lpack_reader_unmap(&reader);
+    return ret;
+}
+
+/* unicode_decoding=True: the Lua strings are converted to unicode */
+static void Interpreter_decoding_init(InterpreterObject *self) {
+    if (self->decoding) python_setnumber(self->L, PY_UNICODE_DECODING, 1);
+    python_unicode_changed();
+}
+
+/* owner_thread=True: the state is used only by the executor thread (started now) */
+static int Interpreter_owner_init(InterpreterObject *self, PyObject *kwargs) {
+    PyObject *owner_thread = kwargs ? PyDict_GetItemString(kwargs, "owner_thread") : NULL;
+    if (owner_thread && PyObject_IsTrue(owner_thread)) {
+        if (!(self->executor = InterpreterPool_Executor(self)))
+            return -1;
+        self->owner = InterpreterPool_Thread(self->executor);
+    }
+    return 0;
+}
+
+/* Keyword options of the state (new or recycled) */
+static int Interpreter_options_init(InterpreterObject *self, PyObject *kwargs) {
+    PyObject *decoding = kwargs ? PyDict_GetItemString(kwargs, "unicode_decoding") : NULL;
+    self->decoding = decoding && PyObject_IsTrue(decoding);
+    Interpreter_decoding_init(self);
+    return Interpreter_owner_init(self, kwargs);
 }
 
 /*
  * Initialization function environment.
  */
 static int Interpreter_init(InterpreterObject *self, PyObject *args, PyObject *kwargs) {
+    PyObject *recycle = kwargs ? PyDict_GetItemString(kwargs, "recycle") : NULL;
+    self->recycle = recycle && PyObject_IsTrue(recycle);
+    self->isPyType = true;
+    lua_mpsc_init(&self->calls);
+    if (!(self->wrappers = PyDict_New()) || lua_state_lock_init(&self->lock) != 0) {
+        PyErr_NoMemory();
+        self->L = NULL;
+        return -1;
+    }
 #ifdef CGILUA_ENV
     const char *argv = NULL;
 
@@ -493,9 +870,18 @@ static int Interpreter_init(InterpreterObject *self, PyObject *args, PyObject *k
         self->L = NULL;
         return -1;
     }
+    self->argv = strdup(argv);
+
+    // recycled state (already initialized)
+    if (self->recycle && (self->L = lua_recycled_take(argv, &self->baseline)))
+        return Interpreter_options_init(self, kwargs);
 
     self->L = lua_setup(argv);
 #else
+    // recycled state (already initialized)
+    if (self->recycle && (self->L = lua_recycled_take(NULL, &self->baseline)))
+        return Interpreter_options_init(self, kwargs);
+
     self->L = lua_open();
 
     // default libs
@@ -503,19 +889,142 @@ static int Interpreter_init(InterpreterObject *self, PyObject *args, PyObject *k
     lua_strlibopen(self->L);
     lua_mathlibopen(self->L);
 #endif
-    self->isPyType = true;
     luaopen_python(self->L);
-    return 0;
+    self->baseline = lua_baseline_record(self->L);
+    return Interpreter_options_init(self, kwargs);
 };
 
 static void Interpreter_dealloc(InterpreterObject *self) {
+    if (self->weakreflist)  // schemas (Interpreter.schema)
+        PyObject_ClearWeakRefs((PyObject *) self);
+    if (self->executor) { // the pending jobs hold references
+        InterpreterPool_Shutdown(self->executor);
+        Py_CLEAR(self->executor);
+    }
+    Py_CLEAR(self->wrappers);
+    lua_freelist_clear(&LuaObject_freelist);
+    lua_freelist_clear(&LuaObjectIter_freelist);
     if (self->L) {
-        lua_close(self->L);
+#ifdef CGILUA_ENV
+        char *argv = self->argv;
+#else
+        char *argv = NULL;
+#endif
+        if (!self->recycle || !lua_recycled_put(self->L, argv, self->baseline)) {
+            lua_close(self->L);
+        }
         self->L = NULL; // lua_State(NULL)
+        python_unicode_changed();
     }
+#ifdef CGILUA_ENV
+    free(self->argv);
+#endif
+    lua_state_lock_free(&self->lock);
     Py_TYPE(self)->tp_free((PyObject*)self);
 }
 
+/*
+ * Collects the cycles between Lua values and python objects. The containers reachable
+ * only from the value of one LuaObject are reported to the Python collector, which
+ * breaks the cycles; then the Lua collector frees the tables and their containers.
+ * Returns the number of unreachable python objects found.
+ */
+static PyObject *Interpreter_collect(InterpreterObject *self) {
+    LUA_OWNER_CALL(self, Interpreter_collect, self, NULL, NULL);
+    Py_ssize_t collected = -1;
+    LUA_STATE_ACQUIRE(self);
+    if (lcycle_attribute(self) >= 0) {
+        collected = PyGC_Collect();
+        lcycle_release(self);
+        lua_collectgarbage(self->L, 0);
+    }
+    LUA_STATE_RELEASE(self);
+    return collected < 0 ? NULL : PyInt_FromSsize_t(collected);
+}
+
+/* {LuaObject: (objects, ...)} of the python objects reachable only from each Lua value */
+static PyObject *Interpreter_reachable(InterpreterObject *self) {
+    LUA_OWNER_CALL(self, Interpreter_reachable, self, NULL, NULL);
+    LUA_STATE_ACQUIRE(self);
+    PyObject *report = lcycle_report(self);
+    LUA_STATE_RELEASE(self);
+    return report;
+}
+
+/* Restores the state recorded after the initialization */
+static PyObject *Interpreter_reset(InterpreterObject *self) {
+    LUA_OWNER_CALL(self, Interpreter_reset, self, NULL, NULL);
+    LUA_STATE_ACQUIRE(self);
+    int status = lua_baseline_restore(self->L, self->baseline);
+    if (status == 0)
+        Interpreter_decoding_init(self);
+    LUA_STATE_RELEASE(self);
+    if (status != 0) {
+        python_new_error(PyExc_RuntimeError, "failed to reset the interpreter state");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+/*
+ * Queues the job in the executor of the interpreter (started on demand).
+ * The jobs run in order, in a thread that releases the GIL while Lua is running.
+ */
+static PyObject *Interpreter_submit(InterpreterObject *self, PyObject *code, PyObject *args, PyObject *loop) {
+    PyObject *future, *asyncio, *wrap_future, *kwargs, *wargs;
+    if (!self->executor && !(self->executor = InterpreterPool_Executor(self)))
+        return NULL;
+    future = InterpreterPool_Submit(self->executor, code, args);
+    if (!future || !loop || loop == Py_None)
+        return future;
+    // asyncio.wrap_future(future, loop=loop)
+    wrap_future = NULL;
+    if ((asyncio = PyImport_ImportModule("asyncio"))) {
+        wrap_future = PyObject_GetAttrString(asyncio, "wrap_future");
+        Py_DECREF(asyncio);
+    }
+    wargs = PyTuple_Pack(1, future);
+    kwargs = Py_BuildValue("{s:O}", "loop", loop);
+    Py_DECREF(future);
+    future = NULL;
+    if (wrap_future && wargs && kwargs) {
+        future = PyObject_Call(wrap_future, wargs, kwargs);
+    }
+    Py_XDECREF(wrap_future);
+    Py_XDECREF(wargs);
+    Py_XDECREF(kwargs);
+    return future;
+}
+
+static PyObject *Interpreter_execute_async(InterpreterObject *self, PyObject *args, PyObject *kwargs) {
+    static char *kwlist[] = {"code", "loop", NULL};
+    PyObject *code, *loop = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "S|O", kwlist, &code, &loop))
+        return NULL;
+
+    return Interpreter_submit(self, code, NULL, loop);
+}
+
+static PyObject *Interpreter_call_async(InterpreterObject *self, PyObject *args, PyObject *kwargs) {
+    PyObject *name, *fargs, *loop = kwargs ? PyDict_GetItemString(kwargs, "loop") : NULL;
+    Py_ssize_t nargs = PyTuple_Size(args);
+
+    if (kwargs && PyDict_Size(kwargs) > (loop ? 1 : 0)) {
+        PyErr_SetString(PyExc_TypeError, "call_async() accepts only the keyword argument 'loop'");
+        return NULL;
+    }
+    if (nargs < 1 || !PyString_Check(name = PyTuple_GET_ITEM(args, 0))) {
+        PyErr_SetString(PyExc_TypeError, "call_async() requires the name of the global function");
+        return NULL;
+    }
+    if (!(fargs = PyTuple_GetSlice(args, 1, nargs)))
+        return NULL;
+    PyObject *future = Interpreter_submit(self, name, fargs, loop);
+    Py_DECREF(fargs);
+    return future;
+}
+
 #ifdef CGILUA_ENV
 static PyObject *Interpreter_ungbreak(InterpreterObject *self) {
     self->L->gbreak = 0;
@@ -534,6 +1043,28 @@ static PyMethodDef Interpreter_methods[] = {
             "returns the list of global variables."},
     {"require", (PyCFunction) Interpreter_dofile,  METH_VARARGS,
             "loads and executes the script."},
+    {"to_lua",  (PyCFunction) Interpreter_to_lua,  METH_O,
+            "converts the dict, list or tuple (shared or cyclic containers once) into a table."},
+    {"pack",    (PyCFunction) Interpreter_pack,    METH_O,
+            "snapshot (bytes) of the Lua value (LuaObject) or of the python data (versioned binary format)."},
+    {"unpack",  (PyCFunction) Interpreter_unpack,  METH_O,
+            "value of the snapshot (str, bytearray, mmap, ...) created in the state."},
+    {"unpack_file", (PyCFunction) Interpreter_unpack_file, METH_VARARGS,
+            "value of the snapshot file (memory mapped, decoded in one pass)."},
+    {"schema",  (PyCFunction) Interpreter_schema,  METH_VARARGS,
+            "compiles the converter of the records of the class (fields): schema(table), schema.to_lua(record)."},
+    {"collect", (PyCFunction) Interpreter_collect, METH_NOARGS,
+            "collects the cycles between Lua tables and python objects (Python and Lua collectors)."},
+    {"reachable", (PyCFunction) Interpreter_reachable, METH_NOARGS,
+            "{LuaObject: objects}: python objects held only through the Lua value of each wrapper."},
+    {"reset",   (PyCFunction) Interpreter_reset,   METH_NOARGS,
+            "restores globals, python api and tag methods to the state after the initialization."},
+    {"execute_async", (PyCFunction) Interpreter_execute_async, METH_VARARGS | METH_KEYWORDS,
+            "execute_async(code, loop=None): executes the code in the thread of the interpreter. "
+            "Returns a future (asyncio future when loop is given)."},
+    {"call_async", (PyCFunction) Interpreter_call_async, METH_VARARGS | METH_KEYWORDS,
+            "call_async(name, *args, loop=None): calls the global function in the thread of the "
+            "interpreter. Returns a future (asyncio future when loop is given)."},
 #ifdef CGILUA_ENV
     {"ungbreak", (PyCFunction) Interpreter_ungbreak,  METH_VARARGS,
             "ungbreak exit lock"},
@@ -547,7 +1078,7 @@ static PyObject *lua_get_version(InterpreterObject *self, PyObject *args) {
 
 }
 
-static PyTypeObject InterpreterObject_Type = {
+PyTypeObject InterpreterObject_Type = {
     PyObject_HEAD_INIT(NULL)
     0,                         /*ob_size*/
     "lua.Interpreter",      /*tp_name*/
@@ -573,7 +1104,7 @@ static PyTypeObject InterpreterObject_Type = {
     0,		                  /* tp_traverse */
     0,		                  /* tp_clear */
     0,		                  /* tp_richcompare */
-    0,		                  /* tp_weaklistoffset */
+    offsetof(InterpreterObject, weakreflist), /* tp_weaklistoffset */
     0,		                  /* tp_iter */
     0,		                  /* tp_iternext */
     Interpreter_methods,      /* tp_methods */
@@ -591,9 +1122,69 @@ static PyTypeObject InterpreterObject_Type = {
     0,                         /*tp_is_gc*/
 };
 
+/* Closes the states kept by the interpreters created with recycle=True */
+static PyObject *lua_clear_recycled(PyObject *self, PyObject *args) {
+    return PyInt_FromLong(lua_recycled_clear());
+}
+
+/* Enables (or disables with None) the cache of precompiled chunks of require */
+static PyObject *lua_set_bytecode_cache(PyObject *self, PyObject *args) {
+    const char *directory = NULL, *compiler = NULL;
+
+    if (!PyArg_ParseTuple(args, "z|s", &directory, &compiler))
+        return NULL;
+
+    if (lua_bytecode_cache_set(directory, compiler) != 0) {
+        PyErr_Format(PyExc_ValueError, "\"%s\" is not a directory", directory);
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+/* Compiles all the scripts of the directory into the cache */
+static PyObject *lua_prewarm_bytecode_cache(PyObject *self, PyObject *args) {
+    const char *directory = NULL;
+    int count;
+
+    if (!PyArg_ParseTuple(args, "s", &directory))
+        return NULL;
+
+    if ((count = lua_bytecode_cache_prewarm(directory)) < 0)
+        return NULL;
+    return PyInt_FromLong(count);
+}
+
+/* Registers the converter of the type (and subclasses) used to push its objects to Lua */
+static PyObject *lua_register_converter(PyObject *self, PyObject *args) {
+    PyObject *type, *converter;
+
+    if (!PyArg_ParseTuple(args, "OO", &type, &converter))
+        return NULL;
+
+    if (py_dispatch_register(type, converter) != 0)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+/* Counters and sizes of the free lists */
+static PyObject *lua_get_freelist_stats(PyObject *self) {
+    return lua_freelist_stats();
+}
+
 static PyMethodDef lua_methods[] = {
     {"get_version", (PyCFunction) lua_get_version, METH_VARARGS,
             "return version of the lua extension"},
+    {"clear_recycled", (PyCFunction) lua_clear_recycled, METH_NOARGS,
+            "closes the recycled states, returning how many were closed"},
+    {"set_bytecode_cache", (PyCFunction) lua_set_bytecode_cache, METH_VARARGS,
+            "set_bytecode_cache(directory[, luac]): cache of precompiled chunks used by require"},
+    {"prewarm_bytecode_cache", (PyCFunction) lua_prewarm_bytecode_cache, METH_VARARGS,
+            "compiles the scripts (*.lua) of the directory into the bytecode cache"},
+    {"register_converter", (PyCFunction) lua_register_converter, METH_VARARGS,
+            "register_converter(type, converter): converter(obj) returns the value pushed to Lua "
+            "(containers as tables). None removes the converter"},
+    {"freelist_stats", (PyCFunction) lua_get_freelist_stats, METH_NOARGS,
+            "hits, misses and size of the free lists of LuaObject and its iterator"},
     {NULL, NULL}
 };
 
@@ -625,6 +1216,26 @@ PyMODINIT_FUNC PyInit_lua(void) {
     if (PyType_Ready(&LuaObjectIter_Type) < 0)
         return;
 
+    if (PyType_Ready(&LuaObjectView_Type) < 0)
+        return;
+
+    if (PyType_Ready(&LuaObjectViewIter_Type) < 0)
+        return;
+
+    if (PyType_Ready(&InterpreterPoolObject_Type) < 0)
+        return;
+
+    if (PyType_Ready(&LuaArrayObject_Type) < 0)
+        return;
+
+    if (PyType_Ready(&SchemaObject_Type) < 0)
+        return;
+
+#ifndef _WIN32
+    if (PyType_Ready(&ProcessPoolObject_Type) < 0)
+        return;
+#endif
+
     m = Py_InitModule3("lua", lua_methods,
                        "Lunatic-Python Python-Lua bridge");
     if (m == NULL) return;
@@ -632,9 +1243,19 @@ PyMODINIT_FUNC PyInit_lua(void) {
 
     Py_INCREF(&LuaObject_Type);
     Py_INCREF(&InterpreterObject_Type);
+    Py_INCREF(&InterpreterPoolObject_Type);
+    Py_INCREF(&LuaArrayObject_Type);
+    Py_INCREF(&SchemaObject_Type);
 
     PyModule_AddObject(m, "Interpreter", (PyObject *)&InterpreterObject_Type);
     PyModule_AddObject(m, "LuaObject", (PyObject *)&LuaObject_Type);
+    PyModule_AddObject(m, "InterpreterPool", (PyObject *)&InterpreterPoolObject_Type);
+    PyModule_AddObject(m, "LuaArray", (PyObject *)&LuaArrayObject_Type);
+    PyModule_AddObject(m, "Schema", (PyObject *)&SchemaObject_Type);
+#ifndef _WIN32
+    Py_INCREF(&ProcessPoolObject_Type);
+    PyModule_AddObject(m, "ProcessPool", (PyObject *)&ProcessPoolObject_Type);
+#endif
 
 #if PY_MAJOR_VERSION >= 3
     return m;
@@ -26,14 +26,39 @@
 #define LUA_EXT_VERSION "2.1.5"
 
 #include <stdbool.h>
+#include "lthread.h"
 
 typedef struct {
     PyObject_HEAD
     lua_State *L;
     bool isPyType;
+    bool recycle;  // state reused by a new interpreter after dealloc
+    bool decoding; // unicode_decoding=True (kept by reset)
+    int baseline;  // reference of the state after the initialization
+    lua_state_lock lock;  // shared with the executor thread
+    PyObject *executor;   // worker of execute_async / call_async
+    long owner;           // executor thread (owner_thread=True) or zero
+    lua_mpsc calls;       // calls sent to the owner by other threads
+    PyObject *wrappers;   // {identity: weakref(LuaObject)}
+    PyObject *weakreflist;
+#ifdef CGILUA_ENV
+    char *argv;
+#endif
 } InterpreterObject;
 
 extern PyTypeObject LuaObject_Type;
+extern PyTypeObject InterpreterObject_Type;
+
+/* Serializes the access to the state of a Python interpreter object (and bounds its temporaries) */
+#define LUA_STATE_ACQUIRE(interpreter) do { \
+    if ((interpreter)->isPyType) lua_state_lock_acquire(&(interpreter)->lock); \
+    lua_cleanup_barrier(); } while (0)
+#define LUA_STATE_RELEASE(interpreter) do { \
+    lua_cleanup_unwind(); \
+    if ((interpreter)->isPyType) lua_state_lock_release(&(interpreter)->lock); } while (0)
+
+int LuaPushArgs(InterpreterObject *interpreter, PyObject *args);
+PyObject *LuaResults(InterpreterObject *interpreter);
 
 #if PY_MAJOR_VERSION < 3
 #define PyInit_lua initlua
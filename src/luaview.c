@@ -0,0 +1,274 @@
+//
+// Created by alex on 19/10/2026.
+//
+#include <Python.h>
+#include <lua.h>
+
+#if defined(_WIN32)
+#include "lapi.h"
+#else
+#include "lshared.h"
+#endif
+
+#include "luaview.h"
+#include "owner.h"
+#include "lregistry.h"
+
+// Array size not computed yet (first chunk)
+#define LUA_ITER_UNKNOWN (-2)
+
+typedef struct {
+    PyObject_HEAD
+    LuaObject *luaobject;
+    LuaViewKind kind;
+} LuaObjectView;
+
+typedef struct {
+    PyObject_HEAD
+    LuaObject *luaobject;
+    LuaViewKind kind;
+    int index;  // next array index or hash node
+    int size;   // keys 1..size walked in order or -1 (hash order)
+    bool done;  // no more entries in the table
+    int count;  // converted entries in the buffer
+    int pos;    // next entry returned from the buffer
+    PyObject *buffer[LUA_ITER_CHUNK];
+} LuaObjectViewIter;
+
+static PyObject *LuaObjectViewIter_item(InterpreterObject *interpreter, LuaViewKind kind,
+                                        TObject *key, TObject *value) {
+    if (kind == LUA_VIEW_KEYS) {
+        return lua_interpreter_tobject_convert(interpreter, key);
+    } else if (kind == LUA_VIEW_VALUES) {
+        return lua_interpreter_tobject_convert(interpreter, value);
+    }
+    PyObject *item = PyTuple_New(2);
+    if (item == NULL)
+        return NULL;
+    PyObject *object = lua_interpreter_tobject_convert(interpreter, key);
+    if (object == NULL) {
+        Py_DECREF(item);
+        return NULL;
+    }
+    PyTuple_SET_ITEM(item, 0, object);
+    if (!(object = lua_interpreter_tobject_convert(interpreter, value))) {
+        Py_DECREF(item);
+        return NULL;
+    }
+    PyTuple_SET_ITEM(item, 1, object);
+    return item;
+}
+
+/* Converts the next chunk of entries of the table (one block in the state) */
+static PyObject *LuaObjectViewIter_fill(LuaObjectViewIter *it) {
+    InterpreterObject *interpreter = it->luaobject->interpreter;
+    lua_State *L = interpreter->L;
+    PyObject *ret = NULL;
+    LUA_OWNER_CALL(interpreter, LuaObjectViewIter_fill, it, NULL, NULL);
+    LUA_STATE_ACQUIRE(interpreter);
+    lua_beginblock(L);
+    lua_Object ltable = lregistry_get(L, it->luaobject->ref);
+    if (lua_isnil(L, ltable)) {
+        PyErr_SetString(PyExc_RuntimeError, "lost reference");
+    } else if (!lua_istable(L, ltable)) {
+        PyErr_SetString(PyExc_TypeError, "Lua object is not a table");
+    } else {
+        Hash *hash = avalue(lapi_address(L, ltable));
+        if (it->size == LUA_ITER_UNKNOWN)
+            it->size = lraw_array_size(L, hash);
+        ret = Py_None;
+        while (it->count < LUA_ITER_CHUNK) {
+            TObject *key, *value, number;
+            if (it->size >= 0) { // index order
+                if (it->index >= it->size) {
+                    it->done = true;
+                    break;
+                }
+                it->index++;
+                value = luaH_getint(L, hash, it->index);
+                if (ttype(value) == LUA_T_NIL)
+                    continue;  // removed during the iteration
+                ttype(&number) = LUA_T_NUMBER;
+                nvalue(&number) = it->index;
+                key = &number;
+            } else {
+                Node *n;
+                if (!(it->index = lraw_next(L, ltable, it->index, &n))) {
+                    it->done = true;
+                    break;
+                }
+                key = ref(L, n);
+                value = val(L, n);
+            }
+            PyObject *item = LuaObjectViewIter_item(interpreter, it->kind, key, value);
+            if (item == NULL) {
+                ret = NULL;
+                break;
+            }
+            it->buffer[it->count++] = item;
+        }
+        Py_XINCREF(ret);
+    }
+    lua_endblock(L);
+    LUA_STATE_RELEASE(interpreter);
+    return ret;
+}
+
+static PyObject *LuaObjectViewIter_next(LuaObjectViewIter *it) {
+    if (it->pos == it->count) {
+        it->pos = it->count = 0;
+        if (it->done)
+            return NULL;
+        PyObject *res = LuaObjectViewIter_fill(it);
+        if (res == NULL)
+            return NULL;
+        Py_DECREF(res);
+        if (it->count == 0)
+            return NULL;  // StopIteration
+    }
+    PyObject *item = it->buffer[it->pos];
+    it->buffer[it->pos++] = NULL;
+    return item;
+}
+
+static void LuaObjectViewIter_dealloc(LuaObjectViewIter *it) {
+    int index;
+    for (index = it->pos; index < it->count; index++)
+        Py_XDECREF(it->buffer[index]);
+    Py_XDECREF(it->luaobject);
+    PyObject_Del(it);
+}
+
+PyTypeObject LuaObjectViewIter_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "LuaObject_view_iterator",                  /* tp_name */
+    sizeof(LuaObjectViewIter),                  /* tp_basicsize */
+    0,                                          /* tp_itemsize */
+    (destructor) LuaObjectViewIter_dealloc,     /* tp_dealloc */
+    0,                                          /* tp_print */
+    0,                                          /* tp_getattr */
+    0,                                          /* tp_setattr */
+    0,                                          /* tp_reserved */
+    0,                                          /* tp_repr */
+    0,                                          /* tp_as_number */
+    0,                                          /* tp_as_sequence */
+    0,                                          /* tp_as_mapping */
+    0,                                          /* tp_hash */
+    0,                                          /* tp_call */
+    0,                                          /* tp_str */
+    PyObject_GenericGetAttr,                    /* tp_getattro */
+    0,                                          /* tp_setattro */
+    0,                                          /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                         /* tp_flags */
+    0,                                          /* tp_doc */
+    0,                                          /* tp_traverse */
+    0,                                          /* tp_clear */
+    0,                                          /* tp_richcompare */
+    0,                                          /* tp_weaklistoffset */
+    PyObject_SelfIter,                          /* tp_iter */
+    (iternextfunc) LuaObjectViewIter_next,      /* tp_iternext */
+    0,                                          /* tp_methods */
+    0,
+};
+
+static PyObject *LuaObjectView_iter(LuaObjectView *view) {
+    LuaObjectViewIter *it = PyObject_New(LuaObjectViewIter, &LuaObjectViewIter_Type);
+    if (it == NULL)
+        return NULL;
+    Py_INCREF(view->luaobject);
+    it->luaobject = view->luaobject;
+    it->kind = view->kind;
+    it->index = 0;
+    it->size = LUA_ITER_UNKNOWN;
+    it->done = false;
+    it->count = it->pos = 0;
+    return (PyObject *) it;
+}
+
+static PyObject *LuaObjectView_length_owner(LuaObjectView *view);
+
+/* Entries of the table (as iterated: the keys 1..n of an array, all the non-nil nodes otherwise) */
+static Py_ssize_t LuaObjectView_length(LuaObjectView *view) {
+    InterpreterObject *interpreter = view->luaobject->interpreter;
+    lua_State *L = interpreter->L;
+    if (LUA_OWNER_OTHER(interpreter)) {
+        PyObject *res = lua_owner_call(interpreter, (lua_owner_fn) LuaObjectView_length_owner,
+                                       (PyObject *) view, NULL, NULL);
+        Py_ssize_t len = res ? PyInt_AsSsize_t(res) : -1;
+        Py_XDECREF(res);
+        return len;
+    }
+    Py_ssize_t len = -1;
+    LUA_STATE_ACQUIRE(interpreter);
+    lua_beginblock(L);
+    lua_Object ltable = lregistry_get(L, view->luaobject->ref);
+    if (lua_isnil(L, ltable)) {
+        PyErr_SetString(PyExc_RuntimeError, "lost reference");
+    } else if (!lua_istable(L, ltable)) {
+        PyErr_SetString(PyExc_TypeError, "Lua object is not a table");
+    } else if ((len = lraw_array_size(L, avalue(lapi_address(L, ltable)))) < 0) {
+        Node *n;
+        int index = 0;
+        for (len = 0; (index = lraw_next(L, ltable, index, &n)); len++);
+    }
+    lua_endblock(L);
+    LUA_STATE_RELEASE(interpreter);
+    return len;
+}
+
+/* LuaObjectView_length executed by the owner thread */
+static PyObject *LuaObjectView_length_owner(LuaObjectView *view) {
+    Py_ssize_t len = LuaObjectView_length(view);
+    return len < 0 ? NULL : PyInt_FromSsize_t(len);
+}
+
+static void LuaObjectView_dealloc(LuaObjectView *view) {
+    Py_XDECREF(view->luaobject);
+    PyObject_Del(view);
+}
+
+static PySequenceMethods LuaObjectView_as_sequence = {
+    (lenfunc) LuaObjectView_length,             /* sq_length */
+};
+
+PyTypeObject LuaObjectView_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "LuaObject_view",                           /* tp_name */
+    sizeof(LuaObjectView),                      /* tp_basicsize */
+    0,                                          /* tp_itemsize */
+    (destructor) LuaObjectView_dealloc,         /* tp_dealloc */
+    0,                                          /* tp_print */
+    0,                                          /* tp_getattr */
+    0,                                          /* tp_setattr */
+    0,                                          /* tp_reserved */
+    0,                                          /* tp_repr */
+    0,                                          /* tp_as_number */
+    &LuaObjectView_as_sequence,                 /* tp_as_sequence */
+    0,                                          /* tp_as_mapping */
+    0,                                          /* tp_hash */
+    0,                                          /* tp_call */
+    0,                                          /* tp_str */
+    PyObject_GenericGetAttr,                    /* tp_getattro */
+    0,                                          /* tp_setattro */
+    0,                                          /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                         /* tp_flags */
+    0,                                          /* tp_doc */
+    0,                                          /* tp_traverse */
+    0,                                          /* tp_clear */
+    0,                                          /* tp_richcompare */
+    0,                                          /* tp_weaklistoffset */
+    (getiterfunc) LuaObjectView_iter,           /* tp_iter */
+    0,                                          /* tp_iternext */
+    0,                                          /* tp_methods */
+    0,
+};
+
+PyObject *LuaObjectView_New(LuaObject *luaobject, LuaViewKind kind) {
+    LuaObjectView *view = PyObject_New(LuaObjectView, &LuaObjectView_Type);
+    if (view == NULL)
+        return NULL;
+    Py_INCREF(luaobject);
+    view->luaobject = luaobject;
+    view->kind = kind;
+    return (PyObject *) view;
+}
@@ -0,0 +1,27 @@
+//
+// Created by alex on 19/10/2026.
+//
+// items() / keys() / values() of a LuaObject (table). The iterators convert
+// LUA_ITER_CHUNK entries per access to the state and keep them in a buffer.
+
+#ifndef LUNATIC_LUAVIEW_H
+#define LUNATIC_LUAVIEW_H
+
+#include <Python.h>
+#include "pyconv.h"
+
+// Entries converted by each access of the iterator to the state
+#define LUA_ITER_CHUNK 64
+
+typedef enum {
+    LUA_VIEW_KEYS = 0,
+    LUA_VIEW_VALUES = 1,
+    LUA_VIEW_ITEMS = 2
+} LuaViewKind;
+
+extern PyTypeObject LuaObjectView_Type;
+extern PyTypeObject LuaObjectViewIter_Type;
+
+PyObject *LuaObjectView_New(LuaObject *luaobject, LuaViewKind kind);
+
+#endif //LUNATIC_LUAVIEW_H
@@ -0,0 +1,93 @@
+//
+// Created by alex on 19/10/2026.
+//
+
+#include <Python.h>
+#include <pythread.h>
+#include <lua.h>
+
+#include "owner.h"
+#include "pool.h"
+#include "lthread.h"
+#include "lregistry.h"
+
+typedef struct {
+    lua_mpsc_node node;
+    lua_owner_fn fn;  // NULL releases the reference (no one waits)
+    PyObject *self;
+    PyObject *arg1;
+    PyObject *arg2;
+    int ref;
+    PyObject *ret;
+    PyObject *ptype, *pvalue, *ptraceback;
+    PyThread_type_lock done;  // released by the owner
+} lua_owner_task;
+
+/* Completion of the calls of the thread (one at a time) */
+static LUA_THREAD_LOCAL PyThread_type_lock completion = NULL;
+
+/**
+ * Sends the call to the owner thread and waits for it without the GIL.
+ * The arguments are borrowed (the caller keeps them alive while waiting).
+**/
+PyObject *lua_owner_call(InterpreterObject *interpreter, lua_owner_fn fn,
+                         PyObject *self, PyObject *arg1, PyObject *arg2) {
+    lua_owner_task task = {{NULL}, fn, self, arg1, arg2};
+    if (!completion && !(completion = PyThread_allocate_lock()))
+        return PyErr_NoMemory();
+    PyThread_acquire_lock(completion, WAIT_LOCK);
+    task.done = completion;
+    lua_mpsc_push(&interpreter->calls, &task.node);
+    InterpreterPool_Wakeup(interpreter->executor);
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(completion, WAIT_LOCK);
+    Py_END_ALLOW_THREADS
+    PyThread_release_lock(completion);
+    if (!task.ret) {
+        PyErr_Restore(task.ptype, task.pvalue, task.ptraceback);
+    }
+    return task.ret;
+}
+
+/* Releases the Lua reference in the owner thread (steals the reference of the interpreter) */
+void lua_owner_unref(InterpreterObject *interpreter, int ref) {
+    lua_owner_task *task = calloc(1, sizeof(lua_owner_task));
+    if (!task) { // leaks the Lua reference
+        Py_DECREF(interpreter);
+        return;
+    }
+    task->ref = ref;
+    lua_mpsc_push(&interpreter->calls, &task->node);
+    InterpreterPool_Wakeup(interpreter->executor);
+}
+
+/**
+ * Runs the pending calls (owner thread, with the GIL held).
+ * Returns how many were executed.
+**/
+int lua_owner_run(InterpreterObject *interpreter) {
+    lua_mpsc_node *node;
+    int count = 0, released = 0;
+    while ((node = lua_mpsc_pop(&interpreter->calls))) {
+        lua_owner_task *task = (lua_owner_task *) node;
+        count++;
+        if (task->fn) {
+            task->ret = task->fn(task->self, task->arg1, task->arg2);
+            if (!task->ret) {
+                PyErr_Fetch(&task->ptype, &task->pvalue, &task->ptraceback);
+            }
+            PyThread_release_lock(task->done);
+        } else {
+            LUA_STATE_ACQUIRE(interpreter);
+            lregistry_unref(interpreter->L, task->ref);
+            LUA_STATE_RELEASE(interpreter);
+            free(task);
+            released++;
+        }
+    }
+    // the last reference closes the interpreter
+    while (released-- > 0) {
+        Py_DECREF(interpreter);
+    }
+    return count;
+}
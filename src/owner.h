@@ -0,0 +1,32 @@
+//
+// Created by alex on 19/10/2026.
+//
+// Interpreters created with owner_thread=True: the state is used only by
+// the thread of its executor, the other threads send their calls to it.
+
+#ifndef LUNATIC_OWNER_H
+#define LUNATIC_OWNER_H
+
+#include <Python.h>
+#include <pythread.h>
+#include "luainpython.h"
+
+typedef PyObject *(*lua_owner_fn)(PyObject *self, PyObject *arg1, PyObject *arg2);
+
+/* The current thread is not the owner of the state */
+#define LUA_OWNER_OTHER(interpreter) \
+    ((interpreter)->isPyType && (interpreter)->owner && \
+     (interpreter)->owner != PyThread_get_thread_ident())
+
+/* Returns fn(self, arg1, arg2) executed by the owner thread when called from another one */
+#define LUA_OWNER_CALL(interpreter, fn, self, arg1, arg2) \
+    if (LUA_OWNER_OTHER(interpreter)) \
+        return lua_owner_call((interpreter), (lua_owner_fn) (fn), (PyObject *) (self), \
+                              (PyObject *) (arg1), (PyObject *) (arg2))
+
+PyObject *lua_owner_call(InterpreterObject *interpreter, lua_owner_fn fn,
+                         PyObject *self, PyObject *arg1, PyObject *arg2);
+void lua_owner_unref(InterpreterObject *interpreter, int ref);
+int lua_owner_run(InterpreterObject *interpreter);
+
+#endif //LUNATIC_OWNER_H
@@ -0,0 +1,591 @@
+//
+// Created by alex on 19/10/2026.
+//
+// Pool of Lua interpreters, each one running in its own thread.
+// A pool of one worker bound to an existing interpreter is its executor
+// (Interpreter.execute_async).
+
+#include <Python.h>
+#include <pythread.h>
+#include <lua.h>
+#include <stdbool.h>
+
+#include "luainpython.h"
+#include "luaconv.h"
+#include "pyconv.h"
+#include "utils.h"
+#include "constants.h"
+#include "lthread.h"
+#include "pool.h"
+#include "owner.h"
+
+typedef struct pool_job {
+    struct pool_job *next;
+    struct pool_job *prev;
+    PyObject *future;
+    PyObject *code;  // Lua code or name of the global function
+    PyObject *args;  // function arguments (NULL executes the code)
+    PyObject *interpreter;  // keeps the state of an executor alive
+} pool_job;
+
+typedef struct {
+    pool_job *head;
+    pool_job *tail;
+} pool_deque;
+
+struct InterpreterPoolObject;
+
+typedef struct {
+    struct InterpreterPoolObject *pool;
+    InterpreterObject *interpreter;
+    pool_deque jobs;
+    PyThread_type_lock wakeup;  // locked while the worker sleeps
+    bool sleeping;
+    PyObject *error;  // initialization failure
+    int index;
+    long thread;
+    bool borrowed;  // executor: the interpreter belongs to the caller
+} pool_worker;
+
+typedef struct InterpreterPoolObject {
+    PyObject_HEAD
+    InterpreterObject *interpreter;  // executor state (borrowed, NULL after shutdown)
+    pool_worker *workers;
+    int size;
+    int next;      // worker receiving the next job
+    int starting;  // workers being initialized
+    int alive;     // running workers
+    bool closing;
+    bool orphan;   // released while a worker was running a job: freed by the last worker
+    PyObject *init_script;
+    PyObject *args;  // Interpreter(*args)
+    PyObject *future_type;
+    PyThread_type_lock ready;     // released when the workers are initialized
+    PyThread_type_lock finished;  // released when the workers are finished
+} InterpreterPoolObject;
+
+/* Jobs queue: the owner takes from the head, the others steal from the tail. */
+static void pool_deque_push(pool_deque *deque, pool_job *job) {
+    job->next = NULL;
+    job->prev = deque->tail;
+    if (deque->tail) {
+        deque->tail->next = job;
+    } else {
+        deque->head = job;
+    }
+    deque->tail = job;
+}
+
+static pool_job *pool_deque_pop_head(pool_deque *deque) {
+    pool_job *job = deque->head;
+    if (job) {
+        deque->head = job->next;
+        if (deque->head) {
+            deque->head->prev = NULL;
+        } else {
+            deque->tail = NULL;
+        }
+    }
+    return job;
+}
+
+static pool_job *pool_deque_pop_tail(pool_deque *deque) {
+    pool_job *job = deque->tail;
+    if (job) {
+        deque->tail = job->prev;
+        if (deque->tail) {
+            deque->tail->next = NULL;
+        } else {
+            deque->head = NULL;
+        }
+    }
+    return job;
+}
+
+static void pool_job_free(pool_job *job) {
+    Py_XDECREF(job->future);
+    Py_XDECREF(job->code);
+    Py_XDECREF(job->args);
+    Py_XDECREF(job->interpreter);
+    free(job);
+}
+
+/* The workers access the jobs queues only with the GIL held. */
+static pool_job *pool_worker_take(pool_worker *worker) {
+    InterpreterPoolObject *pool = worker->pool;
+    pool_job *job = pool_deque_pop_head(&worker->jobs);
+    int index;
+    for (index = 1; !job && index < pool->size; index++) { // work stealing
+        job = pool_deque_pop_tail(&pool->workers[(worker->index + index) % pool->size].jobs);
+    }
+    return job;
+}
+
+static void pool_worker_sleep(pool_worker *worker) {
+    worker->sleeping = true;
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(worker->wakeup, WAIT_LOCK);
+    Py_END_ALLOW_THREADS
+}
+
+static void pool_worker_wakeup(pool_worker *worker) {
+    if (worker->sleeping) {
+        worker->sleeping = false;
+        PyThread_release_lock(worker->wakeup);
+    }
+}
+
+/* Runs the job in the worker state, releasing the GIL while Lua is running */
+static PyObject *pool_job_run(pool_worker *worker, pool_job *job) {
+    InterpreterObject *interpreter = worker->interpreter;
+    // Tables of the pool states are copied, the state belongs to the worker thread.
+    bool convert = !worker->borrowed;
+    lua_State *L = interpreter->L;
+    char *s = PyString_AS_STRING(job->code);
+    PyObject *ret = NULL;
+    int status;
+    lua_state_lock_acquire(&interpreter->lock);
+    lua_cleanup_barrier();
+    lua_beginblock(L);
+    if (job->args) {
+        lua_Object lobj = lua_getglobal(L, s);
+        if (!lua_isfunction(L, lobj)) {
+            PyErr_Format(PyExc_TypeError, "global \"%s\" is not a function", s);
+            goto done;
+        }
+        if (LuaPushArgs(interpreter, job->args) != 0) {
+            goto done;
+        }
+        LUA_BEGIN_ALLOW_THREADS
+        status = lua_callfunction(L, lobj);
+        LUA_END_ALLOW_THREADS
+    } else {
+        LUA_BEGIN_ALLOW_THREADS
+        status = lua_dobuffer(L, s, (int) PyString_GET_SIZE(job->code), "<pool>");
+        LUA_END_ALLOW_THREADS
+    }
+    if (status) {
+        char *format = job->args ? "call function lua (%s)" : "eval code (%s)";
+        char buff[buffsize_calc(2, format, s)];
+        sprintf(buff, format, s);
+        python_new_error(PyExc_RuntimeError, &buff[0]);
+    } else {
+        int previous = python_getnumber(L, PY_LUA_TABLE_CONVERT);  // value of the caller
+        if (convert) python_setnumber(L, PY_LUA_TABLE_CONVERT, 1);
+        if (job->args) {
+            ret = LuaResults(interpreter);
+        } else if (lua_gettop(L) > 0) {
+            ret = lua_interpreter_stack_convert(interpreter, 1);
+        } else {
+            Py_INCREF(Py_None);
+            ret = Py_None;
+        }
+        if (convert) python_setnumber(L, PY_LUA_TABLE_CONVERT, previous);
+    }
+done:
+    lua_endblock(L);
+    lua_cleanup_unwind();
+    lua_state_lock_release(&interpreter->lock);
+    return ret;
+}
+
+/* Sets the job result (or exception) in its future */
+static void pool_job_done(pool_job *job, PyObject *ret) {
+    PyObject *res;
+    if (ret) {
+        res = PyObject_CallMethod(job->future, "set_result", "(O)", ret);
+        Py_DECREF(ret);
+    } else {
+        PyObject *ptype, *pvalue, *ptraceback;
+        PyErr_Fetch(&ptype, &pvalue, &ptraceback);
+        PyErr_NormalizeException(&ptype, &pvalue, &ptraceback);
+        res = PyObject_CallMethod(job->future, "set_exception", "(O)", pvalue ? pvalue : Py_None);
+        Py_XDECREF(ptype);
+        Py_XDECREF(pvalue);
+        Py_XDECREF(ptraceback);
+    }
+    if (res) {
+        Py_DECREF(res);
+    } else {
+        PyErr_WriteUnraisable(job->future);
+    }
+}
+
+static void pool_job_execute(pool_worker *worker, pool_job *job) {
+    PyObject *running = PyObject_CallMethod(job->future, "set_running_or_notify_cancel", NULL);
+    if (!running) {
+        PyErr_WriteUnraisable(job->future);
+    } else if (PyObject_IsTrue(running)) { // not cancelled
+        pool_job_done(job, pool_job_run(worker, job));
+    }
+    Py_XDECREF(running);
+}
+
+/* Creates the worker state: Interpreter(*args) and the init script */
+static int pool_worker_init(pool_worker *worker) {
+    InterpreterPoolObject *pool = worker->pool;
+    worker->thread = PyThread_get_thread_ident();
+    if (pool->interpreter) { // executor
+        worker->interpreter = pool->interpreter;
+        worker->borrowed = true;
+        return 0;
+    }
+    worker->interpreter = (InterpreterObject *) PyObject_CallObject((PyObject *) &InterpreterObject_Type,
+                                                                     pool->args);
+    if (worker->interpreter && pool->init_script != Py_None) {
+        PyObject *ret = PyObject_CallMethod((PyObject *) worker->interpreter, "execute", "(O)",
+                                            pool->init_script);
+        Py_XDECREF(ret);
+    }
+    if (PyErr_Occurred()) {
+        PyObject *ptype, *pvalue, *ptraceback;
+        PyErr_Fetch(&ptype, &pvalue, &ptraceback);
+        PyErr_NormalizeException(&ptype, &pvalue, &ptraceback);
+        worker->error = pvalue;
+        Py_XDECREF(ptype);
+        Py_XDECREF(ptraceback);
+        return -1;
+    }
+    return 0;
+}
+
+static void pool_free(InterpreterPoolObject *self);
+
+static void pool_worker_main(void *arg) {
+    pool_worker *worker = (pool_worker *) arg;
+    InterpreterPoolObject *pool = worker->pool;
+    PyGILState_STATE gstate = PyGILState_Ensure();
+    int status = pool_worker_init(worker);
+    pool_job *job;
+    if (--pool->starting == 0) {
+        PyThread_release_lock(pool->ready);
+    }
+    while (status == 0) {
+        if (pool->interpreter && lua_owner_run(pool->interpreter) > 0) {
+            continue; // calls of other threads (owner_thread=True)
+        } else if ((job = pool_worker_take(worker))) {
+            pool_job_execute(worker, job);
+            pool_job_free(job);
+        } else if (pool->closing) {
+            break;
+        } else {
+            pool_worker_sleep(worker);
+        }
+    }
+    if (worker->borrowed) {
+        worker->interpreter = NULL;
+    } else {
+        Py_CLEAR(worker->interpreter); // lua_close
+    }
+    if (--pool->alive == 0) {
+        if (pool->orphan) {
+            pool_free(pool);
+        } else {
+            PyThread_release_lock(pool->finished);
+        }
+    }
+    PyGILState_Release(gstate);
+}
+
+/* A worker can't wait for itself (e.g. the last reference released by a job) */
+static void pool_shutdown(InterpreterPoolObject *self, bool wait) {
+    long thread = PyThread_get_thread_ident();
+    int index;
+    self->closing = true;
+    for (index = 0; index < self->size; index++) {
+        pool_worker_wakeup(&self->workers[index]);
+        if (self->workers[index].thread == thread) wait = false;
+    }
+    if (wait && self->finished) {
+        Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(self->finished, WAIT_LOCK);
+        PyThread_release_lock(self->finished);
+        Py_END_ALLOW_THREADS
+    }
+}
+
+/* Queues the job (args NULL executes the code). Returns the future. */
+static PyObject *pool_submit(InterpreterPoolObject *self, PyObject *code, PyObject *fargs) {
+    int index;
+    if (self->closing) {
+        PyErr_SetString(PyExc_RuntimeError, "cannot submit jobs after shutdown");
+        return NULL;
+    }
+    pool_job *job = calloc(1, sizeof(pool_job));
+    if (!job) return PyErr_NoMemory();
+    if (fargs && !(job->args = PySequence_Tuple(fargs))) {
+        pool_job_free(job);
+        return NULL;
+    }
+    if (!(job->future = PyObject_CallObject(self->future_type, NULL))) {
+        pool_job_free(job);
+        return NULL;
+    }
+    Py_INCREF(code);
+    job->code = code;
+    if (self->interpreter) {
+        Py_INCREF(self->interpreter);
+        job->interpreter = (PyObject *) self->interpreter;
+    }
+    Py_INCREF(job->future);
+    PyObject *future = job->future;
+
+    pool_worker *worker = &self->workers[self->next];
+    self->next = (self->next + 1) % self->size;
+    pool_deque_push(&worker->jobs, job);
+    if (worker->sleeping) {
+        pool_worker_wakeup(worker);
+    } else { // an idle worker can steal the job
+        for (index = 0; index < self->size; index++) {
+            if (self->workers[index].sleeping) {
+                pool_worker_wakeup(&self->workers[index]);
+                break;
+            }
+        }
+    }
+    return future;
+}
+
+static PyObject *InterpreterPool_submit(InterpreterPoolObject *self, PyObject *args, PyObject *kwargs) {
+    static char *kwlist[] = {"code", "args", NULL};
+    PyObject *code, *fargs = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "S|O", kwlist, &code, &fargs))
+        return NULL;
+
+    return pool_submit(self, code, fargs != Py_None ? fargs : NULL);
+}
+
+static PyObject *InterpreterPool_shutdown(InterpreterPoolObject *self, PyObject *args, PyObject *kwargs) {
+    static char *kwlist[] = {"wait", NULL};
+    PyObject *wait = Py_True;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O", kwlist, &wait))
+        return NULL;
+
+    pool_shutdown(self, PyObject_IsTrue(wait));
+    Py_RETURN_NONE;
+}
+
+static PyObject *InterpreterPool_enter(InterpreterPoolObject *self) {
+    Py_INCREF(self);
+    return (PyObject *) self;
+}
+
+static PyObject *InterpreterPool_exit(InterpreterPoolObject *self, PyObject *args) {
+    pool_shutdown(self, true);
+    Py_RETURN_FALSE;
+}
+
+/*
+ * Initialization function environment.
+ */
+/* Starts the workers and waits for their initialization */
+static int pool_start(InterpreterPoolObject *self, int size) {
+    PyObject *futures;
+    int index;
+
+    if (!(futures = PyImport_ImportModule("concurrent.futures")))
+        return -1;
+    self->future_type = PyObject_GetAttrString(futures, "Future");
+    Py_DECREF(futures);
+    if (!self->future_type)
+        return -1;
+
+    self->workers = calloc((size_t) size, sizeof(pool_worker));
+    self->ready = PyThread_allocate_lock();
+    self->finished = PyThread_allocate_lock();
+    if (!self->workers || !self->ready || !self->finished) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    PyThread_acquire_lock(self->ready, WAIT_LOCK);
+    PyThread_acquire_lock(self->finished, WAIT_LOCK);
+    self->size = size;
+
+    PyEval_InitThreads();
+    for (index = 0; index < size; index++) {
+        pool_worker *worker = &self->workers[index];
+        worker->pool = self;
+        worker->index = index;
+        if (!(worker->wakeup = PyThread_allocate_lock())) {
+            PyErr_NoMemory();
+            break;
+        }
+        PyThread_acquire_lock(worker->wakeup, WAIT_LOCK);
+        if (PyThread_start_new_thread(pool_worker_main, worker) == -1) {
+            PyErr_SetString(PyExc_RuntimeError, "can't start new thread");
+            break;
+        }
+        self->starting++;
+        self->alive++;
+    }
+    if (self->alive == 0) {
+        PyThread_release_lock(self->finished);
+    }
+    if (self->starting > 0) { // waiting for the initialization of the workers
+        Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(self->ready, WAIT_LOCK);
+        Py_END_ALLOW_THREADS
+    }
+    for (index = 0; index < size && !PyErr_Occurred(); index++) {
+        PyObject *error = self->workers[index].error;
+        if (error) PyErr_SetObject((PyObject *) Py_TYPE(error), error);
+    }
+    if (PyErr_Occurred()) {
+        PyObject *ptype, *pvalue, *ptraceback;
+        PyErr_Fetch(&ptype, &pvalue, &ptraceback);
+        pool_shutdown(self, true);
+        PyErr_Restore(ptype, pvalue, ptraceback);
+        return -1;
+    }
+    return 0;
+}
+
+static int InterpreterPool_init(InterpreterPoolObject *self, PyObject *args, PyObject *kwargs) {
+    static char *kwlist[] = {"size", "init_script", "args", NULL};
+    PyObject *init_script = Py_None, *iargs = NULL;
+    int size;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "i|OO!", kwlist, &size, &init_script,
+                                     &PyTuple_Type, &iargs))
+        return -1;
+
+    if (self->workers) {
+        PyErr_SetString(PyExc_RuntimeError, "pool already initialized");
+        return -1;
+    }
+    if (size < 1) {
+        PyErr_SetString(PyExc_ValueError, "pool size must be greater than zero");
+        return -1;
+    }
+    Py_INCREF(init_script);
+    self->init_script = init_script;
+    self->args = iargs ? iargs : PyTuple_New(0);
+    Py_XINCREF(iargs);
+    return pool_start(self, size);
+}
+
+/* Executor of the interpreter: a worker thread running the jobs in order */
+PyObject *InterpreterPool_Executor(InterpreterObject *interpreter) {
+    InterpreterPoolObject *self;
+    self = (InterpreterPoolObject *) PyType_GenericAlloc(&InterpreterPoolObject_Type, 0);
+    if (!self) return NULL;
+    self->interpreter = interpreter;
+    if (pool_start(self, 1) != 0) {
+        Py_DECREF(self);
+        return NULL;
+    }
+    return (PyObject *) self;
+}
+
+PyObject *InterpreterPool_Submit(PyObject *pool, PyObject *code, PyObject *args) {
+    return pool_submit((InterpreterPoolObject *) pool, code, args);
+}
+
+/* Stops the executor: the interpreter is being closed */
+void InterpreterPool_Shutdown(PyObject *pool) {
+    ((InterpreterPoolObject *) pool)->interpreter = NULL;
+    pool_shutdown((InterpreterPoolObject *) pool, true);
+}
+
+void InterpreterPool_Wakeup(PyObject *pool) {
+    pool_worker_wakeup(&((InterpreterPoolObject *) pool)->workers[0]);
+}
+
+/* Thread of the executor */
+long InterpreterPool_Thread(PyObject *pool) {
+    return ((InterpreterPoolObject *) pool)->workers[0].thread;
+}
+
+static void pool_free(InterpreterPoolObject *self) {
+    int index;
+    pool_job *job;
+    if (self->workers) { // workers are finished
+        for (index = 0; index < self->size; index++) {
+            pool_worker *worker = &self->workers[index];
+            while ((job = pool_deque_pop_head(&worker->jobs))) {
+                pool_job_free(job);
+            }
+            if (worker->wakeup) PyThread_free_lock(worker->wakeup);
+            Py_XDECREF(worker->error);
+        }
+        free(self->workers);
+    }
+    if (self->ready) PyThread_free_lock(self->ready);
+    if (self->finished) PyThread_free_lock(self->finished);
+    Py_XDECREF(self->init_script);
+    Py_XDECREF(self->args);
+    Py_XDECREF(self->future_type);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+/**
+ * The workers do not hold the pool: a pool released without shutdown stops them
+ * (pending jobs are finished first, as concurrent.futures).
+**/
+static void InterpreterPool_dealloc(InterpreterPoolObject *self) {
+    if (self->alive > 0) {
+        pool_shutdown(self, true);
+        if (self->alive > 0) {  // released by a job of a worker (it can't wait for itself)
+            self->orphan = true;
+            return;
+        }
+    }
+    pool_free(self);
+}
+
+static PyMethodDef InterpreterPool_methods[] = {
+    {"submit",    (PyCFunction) InterpreterPool_submit,   METH_VARARGS | METH_KEYWORDS,
+            "submit(code[, args]): executes the code (or calls the global function with args) "
+            "in a worker. Returns a future."},
+    {"shutdown",  (PyCFunction) InterpreterPool_shutdown, METH_VARARGS | METH_KEYWORDS,
+            "finishes the pending jobs and stops the workers."},
+    {"__enter__", (PyCFunction) InterpreterPool_enter,    METH_NOARGS, NULL},
+    {"__exit__",  (PyCFunction) InterpreterPool_exit,     METH_VARARGS, NULL},
+    {NULL,         NULL}
+};
+
+PyTypeObject InterpreterPoolObject_Type = {
+    PyObject_HEAD_INIT(NULL)
+    0,                         /*ob_size*/
+    "lua.InterpreterPool",     /*tp_name*/
+    sizeof(InterpreterPoolObject), /*tp_basicsize*/
+    0,                         /*tp_itemsize*/
+    (destructor) InterpreterPool_dealloc, /*tp_dealloc*/
+    0,                         /*tp_print*/
+    0,                         /*tp_getattr*/
+    0,                         /*tp_setattr*/
+    0,                         /*tp_compare*/
+    0,                         /*tp_repr*/
+    0,                         /*tp_as_number*/
+    0,                         /*tp_as_sequence*/
+    0,                         /*tp_as_mapping*/
+    0,                         /*tp_hash */
+    0,                         /*tp_call*/
+    0,                         /*tp_str*/
+    0,                         /*tp_getattro*/
+    0,                         /*tp_setattro*/
+    0,                         /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,/*tp_flags*/
+    "Pool of Lua interpreters running in threads", /* tp_doc */
+    0,                         /* tp_traverse */
+    0,                         /* tp_clear */
+    0,                         /* tp_richcompare */
+    0,                         /* tp_weaklistoffset */
+    0,                         /* tp_iter */
+    0,                         /* tp_iternext */
+    InterpreterPool_methods,   /* tp_methods */
+    0,                         /* tp_members */
+    0,                         /* tp_getset */
+    0,                         /* tp_base */
+    0,                         /* tp_dict */
+    0,                         /* tp_descr_get */
+    0,                         /* tp_descr_set */
+    0,                         /* tp_dictoffset */
+    (initproc)InterpreterPool_init, /* tp_init */
+    PyType_GenericAlloc,       /* tp_alloc */
+    PyType_GenericNew,         /* tp_new */
+    PyObject_Del,              /*tp_free*/
+    0,                         /*tp_is_gc*/
+};
@@ -0,0 +1,19 @@
+//
+// Created by alex on 19/10/2026.
+//
+
+#ifndef LUNATIC_POOL_H
+#define LUNATIC_POOL_H
+
+#include <Python.h>
+#include "luainpython.h"
+
+extern PyTypeObject InterpreterPoolObject_Type;
+
+PyObject *InterpreterPool_Executor(InterpreterObject *interpreter);
+PyObject *InterpreterPool_Submit(PyObject *pool, PyObject *code, PyObject *args);
+void InterpreterPool_Shutdown(PyObject *pool);
+void InterpreterPool_Wakeup(PyObject *pool);
+long InterpreterPool_Thread(PyObject *pool);
+
+#endif //LUNATIC_POOL_H
@@ -0,0 +1,790 @@
+//
+// Created by alex on 19/10/2026.
+//
+// Pool of forked processes, each one with a copy of a warm interpreter.
+// Requests and results pass through rings in shared memory, encoded with
+// lpack: the workers convert directly between the bytes and Lua values.
+
+#ifndef _WIN32
+
+#include <Python.h>
+#include <pythread.h>
+#include <lua.h>
+#include <errno.h>
+#include <semaphore.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "luainpython.h"
+#include "luaconv.h"
+#include "utils.h"
+#include "lpack.h"
+#include "process.h"
+
+#define PROCESS_EXECUTE 'e'
+#define PROCESS_CALL 'c'
+#define PROCESS_QUIT 'q'
+#define PROCESS_RESULT 'r'
+#define PROCESS_ERROR 'x'
+
+#define PROCESS_POLL_NS 100000000  // checks the peer process every 100ms
+
+typedef struct {
+    sem_t data;   // posted by the writer (reader waiting)
+    sem_t space;  // posted by the reader (writer waiting)
+    volatile size_t head;  // bytes written
+    volatile size_t tail;  // bytes read
+    volatile int reader_waiting;
+    volatile int writer_waiting;
+    char buffer[PROCESS_RING_SIZE];
+} process_ring;
+
+typedef struct {
+    process_ring request;   // parent -> worker
+    process_ring response;  // worker -> parent
+} process_channel;
+
+typedef struct process_job {
+    struct process_job *next;
+    PyObject *future;
+    PyObject *code;  // Lua code or name of the global function
+    PyObject *args;  // function arguments (NULL executes the code)
+} process_job;
+
+struct ProcessPoolObject;
+
+typedef struct {
+    struct ProcessPoolObject *pool;
+    process_channel *channel;
+    pid_t pid;
+    PyThread_type_lock wakeup;  // locked while the feeder sleeps
+    bool sleeping;
+} process_worker;
+
+typedef struct ProcessPoolObject {
+    PyObject_HEAD
+    process_worker *workers;
+    process_channel *channels;  // shared memory
+    int size;
+    int alive;  // running feeder threads
+    bool closing;
+    process_job *head;
+    process_job *tail;
+    PyObject *future_type;
+    PyThread_type_lock finished;  // released when the feeders are finished
+} ProcessPoolObject;
+
+static pid_t process_parent = 0;  // set in the workers
+
+/* The worker checks its parent, the parent checks the worker */
+static bool process_alive(pid_t peer) {
+    if (process_parent) return getppid() == peer;
+    return waitpid(peer, NULL, WNOHANG) == 0;
+}
+
+/* Sleeps until the peer moves its counter. Returns -1 when the peer is gone. */
+static int process_wait(sem_t *sem, volatile int *waiting, volatile size_t *counter,
+                        size_t value, pid_t peer) {
+    struct timespec timeout;
+    int status = 0;
+    *waiting = 1;
+    __sync_synchronize();
+    while (*counter == value) {
+        clock_gettime(CLOCK_REALTIME, &timeout);
+        timeout.tv_nsec += PROCESS_POLL_NS;
+        if (timeout.tv_nsec >= 1000000000) {
+            timeout.tv_sec++;
+            timeout.tv_nsec -= 1000000000;
+        }
+        if (sem_timedwait(sem, &timeout) != 0 && errno == ETIMEDOUT && !process_alive(peer)) {
+            status = -1;
+            break;
+        }
+    }
+    *waiting = 0;
+    return status;
+}
+
+/* The waiting flags avoid a sem_post for each chunk */
+static int process_ring_write(process_ring *ring, const char *data, size_t size, pid_t peer) {
+    while (size > 0) {
+        size_t used = ring->head - ring->tail;
+        size_t offset = ring->head % PROCESS_RING_SIZE;
+        size_t count = PROCESS_RING_SIZE - used;
+        if (count == 0) {
+            if (process_wait(&ring->space, &ring->writer_waiting, &ring->tail, ring->tail, peer) != 0)
+                return -1;
+            continue;
+        }
+        if (count > PROCESS_RING_SIZE - offset) count = PROCESS_RING_SIZE - offset;
+        if (count > size) count = size;
+        memcpy(ring->buffer + offset, data, count);
+        __sync_synchronize();
+        ring->head += count;
+        __sync_synchronize();
+        if (ring->reader_waiting) sem_post(&ring->data);
+        data += count;
+        size -= count;
+    }
+    return 0;
+}
+
+static int process_ring_read(process_ring *ring, char *data, size_t size, pid_t peer) {
+    while (size > 0) {
+        size_t used = ring->head - ring->tail;
+        size_t offset = ring->tail % PROCESS_RING_SIZE;
+        size_t count = used;
+        if (count == 0) {
+            if (process_wait(&ring->data, &ring->reader_waiting, &ring->head, ring->head, peer) != 0)
+                return -1;
+            continue;
+        }
+        __sync_synchronize();
+        if (count > PROCESS_RING_SIZE - offset) count = PROCESS_RING_SIZE - offset;
+        if (count > size) count = size;
+        memcpy(data, ring->buffer + offset, count);
+        __sync_synchronize();
+        ring->tail += count;
+        __sync_synchronize();
+        if (ring->writer_waiting) sem_post(&ring->space);
+        data += count;
+        size -= count;
+    }
+    return 0;
+}
+
+/* Message: uint32 size + bytes. Returns -1 when the peer is gone. */
+static int process_send(process_ring *ring, lpack_buffer *buf, pid_t peer) {
+    uint32_t size = (uint32_t) buf->size;
+    if (process_ring_write(ring, (char *) &size, sizeof(size), peer) != 0)
+        return -1;
+    return process_ring_write(ring, buf->data, buf->size, peer);
+}
+
+static int process_receive(process_ring *ring, lpack_buffer *buf, pid_t peer) {
+    uint32_t size;
+    if (process_ring_read(ring, (char *) &size, sizeof(size), peer) != 0)
+        return -1;
+    if (size > buf->capacity) {
+        char *data = realloc(buf->data, size);
+        if (!data) return -1;
+        buf->data = data;
+        buf->capacity = size;
+    }
+    buf->size = size;
+    return process_ring_read(ring, buf->data, size, peer);
+}
+
+/*
+ * Worker process
+ */
+static void process_error(lpack_buffer *response, const char *message) {
+    char kind = PROCESS_ERROR;
+    uint32_t size = (uint32_t) strlen(message);
+    response->size = 0;
+    lpack_put(response, &kind, 1);
+    lpack_put(response, &size, sizeof(size));
+    lpack_put(response, message, size);
+}
+
+/* Sends the Python error (set by python_new_error) */
+static void process_python_error(lpack_buffer *response) {
+    PyObject *ptype, *pvalue, *ptraceback;
+    char *message;
+    PyErr_Fetch(&ptype, &pvalue, &ptraceback);
+    message = get_pyobject_str(pvalue);
+    process_error(response, message ? message : "unknown error");
+    free(message);
+    Py_XDECREF(ptype);
+    Py_XDECREF(pvalue);
+    Py_XDECREF(ptraceback);
+}
+
+/* Request: kind, uint32 size + code, uint32 nargs + packed arguments */
+static void process_run(lua_State *L, lpack_buffer *request, lpack_buffer *response) {
+    lpack_reader reader;
+    const char *error = NULL, *data;
+    char kind = PROCESS_RESULT, *code;
+    uint32_t size, nargs, index;
+    int status, nresults;
+
+    lpack_reader_init(&reader, request->data + 1, request->size - 1);
+    if (!(data = lpack_get(&reader, sizeof(size)))) {
+        process_error(response, "invalid request");
+        return;
+    }
+    memcpy(&size, data, sizeof(size));
+    if (!(data = lpack_get(&reader, size)) || !(code = malloc(size + 1))) {
+        process_error(response, "invalid request");
+        return;
+    }
+    memcpy(code, data, size);
+    code[size] = '\0';
+
+    lua_cleanup_barrier();
+    lua_beginblock(L);
+    if (*request->data == PROCESS_CALL) {
+        lua_Object lobj = lua_getglobal(L, code);
+        data = lpack_get(&reader, sizeof(nargs));
+        if (!data) {
+            error = "invalid request";
+        } else if (!lua_isfunction(L, lobj)) {
+            error = "global is not a function";
+        }
+        if (data) memcpy(&nargs, data, sizeof(nargs));
+        for (index = 0; !error && index < nargs; index++) {
+            error = lunpack_lua(L, &reader);  // pushes the argument
+        }
+        status = error ? 0 : lua_callfunction(L, lobj);
+    } else {
+        status = lua_dobuffer(L, code, (int) size, "<process>");
+    }
+    if (error) {
+        process_error(response, error);
+    } else if (status) {
+        char *format = *request->data == PROCESS_CALL ? "call function lua (%s)" : "eval code (%s)";
+        char buff[buffsize_calc(2, format, code)];
+        sprintf(buff, format, code);
+        python_new_error(PyExc_RuntimeError, &buff[0]);
+        process_python_error(response);
+    } else {
+        nresults = lua_gettop(L);
+        if (*request->data == PROCESS_EXECUTE && nresults > 1) nresults = 1;
+        nargs = (uint32_t) nresults;
+        response->size = 0;
+        lpack_put(response, &kind, 1);
+        lpack_put(response, &nargs, sizeof(nargs));
+        for (index = 0; !error && index < nargs; index++) {
+            error = lpack_lua(L, response, lua_getresult(L, index + 1));
+        }
+        if (error) {
+            char *format = "pack result (%s)";
+            char buff[buffsize_calc(2, format, error)];
+            sprintf(buff, format, error);
+            process_error(response, buff);
+        }
+    }
+    lua_endblock(L);
+    lua_cleanup_unwind();
+    free(code);
+}
+
+static void process_worker_main(process_channel *channel, InterpreterObject *interpreter) {
+    lpack_buffer request, response;
+    lpack_buffer_init(&request);
+    lpack_buffer_init(&response);
+    while (process_receive(&channel->request, &request, process_parent) == 0) {
+        if (request.size == 0 || *request.data == PROCESS_QUIT)
+            break;
+        process_run(interpreter->L, &request, &response);
+        if (process_send(&channel->response, &response, process_parent) != 0)
+            break;
+    }
+    _exit(0);
+}
+
+/*
+ * Parent process
+ */
+static void process_job_free(process_job *job) {
+    Py_XDECREF(job->future);
+    Py_XDECREF(job->code);
+    Py_XDECREF(job->args);
+    free(job);
+}
+
+/* Jobs are taken with the GIL held (FIFO shared by the feeders) */
+static process_job *process_job_take(ProcessPoolObject *pool) {
+    process_job *job = pool->head;
+    if (job) {
+        pool->head = job->next;
+        if (!pool->head) pool->tail = NULL;
+    }
+    return job;
+}
+
+static int process_request(lpack_buffer *buf, process_job *job) {
+    char kind = job->args ? PROCESS_CALL : PROCESS_EXECUTE;
+    uint32_t size = (uint32_t) PyString_GET_SIZE(job->code), nargs, index;
+    buf->size = 0;
+    if (lpack_put(buf, &kind, 1) || lpack_put(buf, &size, sizeof(size)) ||
+        lpack_put(buf, PyString_AS_STRING(job->code), size)) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    if (job->args) {
+        nargs = (uint32_t) PyTuple_GET_SIZE(job->args);
+        if (lpack_put(buf, &nargs, sizeof(nargs))) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        for (index = 0; index < nargs; index++) {
+            if (lpack_python(buf, PyTuple_GET_ITEM(job->args, index)) != 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+/* Results as Interpreter: None, value or tuple of values (call) */
+static PyObject *process_response(lpack_buffer *buf) {
+    lpack_reader reader;
+    const char *data;
+    uint32_t count, index;
+    PyObject *ret, *value;
+    if (buf->size < 1) {
+        PyErr_SetString(PyExc_RuntimeError, "invalid response");
+        return NULL;
+    }
+    lpack_reader_init(&reader, buf->data + 1, buf->size - 1);
+    if (!(data = lpack_get(&reader, sizeof(count)))) {
+        PyErr_SetString(PyExc_RuntimeError, "invalid response");
+        return NULL;
+    }
+    memcpy(&count, data, sizeof(count));
+    if (*buf->data == PROCESS_ERROR) {
+        if (!(data = lpack_get(&reader, count))) {
+            PyErr_SetString(PyExc_RuntimeError, "invalid response");
+            return NULL;
+        }
+        if ((value = PyString_FromStringAndSize(data, count))) {
+            PyErr_SetObject(PyExc_RuntimeError, value);
+            Py_DECREF(value);
+        }
+        return NULL;
+    }
+    if (count == 0) {
+        Py_RETURN_NONE;
+    } else if (count == 1) {
+        return lunpack_python(&reader);
+    }
+    if (!(ret = PyTuple_New(count))) return NULL;
+    for (index = 0; index < count; index++) {
+        if (!(value = lunpack_python(&reader))) {
+            Py_DECREF(ret);
+            return NULL;
+        }
+        PyTuple_SET_ITEM(ret, index, value);
+    }
+    return ret;
+}
+
+static void process_job_done(process_job *job, PyObject *ret) {
+    PyObject *res;
+    if (ret) {
+        res = PyObject_CallMethod(job->future, "set_result", "(O)", ret);
+        Py_DECREF(ret);
+    } else {
+        PyObject *ptype, *pvalue, *ptraceback;
+        PyErr_Fetch(&ptype, &pvalue, &ptraceback);
+        PyErr_NormalizeException(&ptype, &pvalue, &ptraceback);
+        res = PyObject_CallMethod(job->future, "set_exception", "(O)", pvalue ? pvalue : Py_None);
+        Py_XDECREF(ptype);
+        Py_XDECREF(pvalue);
+        Py_XDECREF(ptraceback);
+    }
+    if (res) {
+        Py_DECREF(res);
+    } else {
+        PyErr_WriteUnraisable(job->future);
+    }
+}
+
+/* Runs the job in the worker process. Returns -1 when the worker is gone. */
+static int process_job_execute(process_worker *worker, process_job *job, lpack_buffer *buf) {
+    PyObject *running = PyObject_CallMethod(job->future, "set_running_or_notify_cancel", NULL);
+    int status = 0;
+    if (!running) {
+        PyErr_WriteUnraisable(job->future);
+    } else if (PyObject_IsTrue(running)) { // not cancelled
+        PyObject *ret = NULL;
+        if (process_request(buf, job) == 0) {
+            Py_BEGIN_ALLOW_THREADS
+            status = process_send(&worker->channel->request, buf, worker->pid);
+            if (status == 0) status = process_receive(&worker->channel->response, buf, worker->pid);
+            Py_END_ALLOW_THREADS
+            if (status == 0) {
+                ret = process_response(buf);
+            } else {
+                PyErr_SetString(PyExc_RuntimeError, "worker process is gone");
+            }
+        }
+        process_job_done(job, ret);
+    }
+    Py_XDECREF(running);
+    return status;
+}
+
+static void process_feeder_main(void *arg) {
+    process_worker *worker = (process_worker *) arg;
+    ProcessPoolObject *pool = worker->pool;
+    PyGILState_STATE gstate = PyGILState_Ensure();
+    lpack_buffer buf;
+    process_job *job;
+    int status = 0;
+    lpack_buffer_init(&buf);
+    while (status == 0) {
+        if ((job = process_job_take(pool))) {
+            status = process_job_execute(worker, job, &buf);
+            process_job_free(job);
+        } else if (pool->closing) {
+            break;
+        } else {
+            worker->sleeping = true;
+            Py_BEGIN_ALLOW_THREADS
+            PyThread_acquire_lock(worker->wakeup, WAIT_LOCK);
+            Py_END_ALLOW_THREADS
+        }
+    }
+    Py_BEGIN_ALLOW_THREADS
+    if (status == 0) { // quit message
+        buf.size = 0;
+        lpack_put(&buf, "q", 1);
+        process_send(&worker->channel->request, &buf, worker->pid);
+    }
+    waitpid(worker->pid, NULL, 0);
+    Py_END_ALLOW_THREADS
+    lpack_buffer_free(&buf);
+    if (--pool->alive == 0) {
+        while ((job = process_job_take(pool))) { // no workers left
+            PyErr_SetString(PyExc_RuntimeError, "no worker process available");
+            process_job_done(job, NULL);
+            process_job_free(job);
+        }
+        PyThread_release_lock(pool->finished);
+    }
+    Py_DECREF(pool);
+    PyGILState_Release(gstate);
+}
+
+static void process_wakeup(process_worker *worker) {
+    if (worker->sleeping) {
+        worker->sleeping = false;
+        PyThread_release_lock(worker->wakeup);
+    }
+}
+
+static void process_shutdown(ProcessPoolObject *self, bool wait) {
+    int index;
+    self->closing = true;
+    for (index = 0; index < self->size; index++) {
+        process_wakeup(&self->workers[index]);
+    }
+    if (wait && self->finished) {
+        Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(self->finished, WAIT_LOCK);
+        PyThread_release_lock(self->finished);
+        Py_END_ALLOW_THREADS
+    }
+}
+
+static PyObject *process_submit(ProcessPoolObject *self, PyObject *code, PyObject *fargs) {
+    int index;
+    if (self->closing || self->alive == 0) {
+        PyErr_SetString(PyExc_RuntimeError, "cannot submit jobs after shutdown");
+        return NULL;
+    }
+    process_job *job = calloc(1, sizeof(process_job));
+    if (!job) return PyErr_NoMemory();
+    if (fargs && !(job->args = PySequence_Tuple(fargs))) {
+        process_job_free(job);
+        return NULL;
+    }
+    if (!(job->future = PyObject_CallObject(self->future_type, NULL))) {
+        process_job_free(job);
+        return NULL;
+    }
+    Py_INCREF(code);
+    job->code = code;
+    Py_INCREF(job->future);
+    if (self->tail) {
+        self->tail->next = job;
+    } else {
+        self->head = job;
+    }
+    self->tail = job;
+    for (index = 0; index < self->size; index++) {
+        if (self->workers[index].sleeping) {
+            process_wakeup(&self->workers[index]);
+            break;
+        }
+    }
+    return job->future;
+}
+
+static PyObject *ProcessPool_submit(ProcessPoolObject *self, PyObject *args, PyObject *kwargs) {
+    static char *kwlist[] = {"code", "args", NULL};
+    PyObject *code, *fargs = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "S|O", kwlist, &code, &fargs))
+        return NULL;
+
+    return process_submit(self, code, fargs != Py_None ? fargs : NULL);
+}
+
+/* Waits for the result of the job */
+static PyObject *process_result(PyObject *future) {
+    PyObject *ret;
+    if (!future) return NULL;
+    ret = PyObject_CallMethod(future, "result", NULL);
+    Py_DECREF(future);
+    return ret;
+}
+
+static PyObject *ProcessPool_execute(ProcessPoolObject *self, PyObject *args) {
+    PyObject *code;
+
+    if (!PyArg_ParseTuple(args, "S", &code))
+        return NULL;
+
+    return process_result(process_submit(self, code, NULL));
+}
+
+static PyObject *ProcessPool_call(ProcessPoolObject *self, PyObject *args) {
+    Py_ssize_t nargs = PyTuple_Size(args);
+    PyObject *name, *fargs, *ret;
+
+    if (nargs < 1 || !PyString_Check(name = PyTuple_GET_ITEM(args, 0))) {
+        PyErr_SetString(PyExc_TypeError, "call() requires the name of the global function");
+        return NULL;
+    }
+    if (!(fargs = PyTuple_GetSlice(args, 1, nargs)))
+        return NULL;
+    ret = process_result(process_submit(self, name, fargs));
+    Py_DECREF(fargs);
+    return ret;
+}
+
+static PyObject *ProcessPool_shutdown(ProcessPoolObject *self, PyObject *args, PyObject *kwargs) {
+    static char *kwlist[] = {"wait", NULL};
+    PyObject *wait = Py_True;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O", kwlist, &wait))
+        return NULL;
+
+    process_shutdown(self, PyObject_IsTrue(wait));
+    Py_RETURN_NONE;
+}
+
+static PyObject *ProcessPool_enter(ProcessPoolObject *self) {
+    Py_INCREF(self);
+    return (PyObject *) self;
+}
+
+static PyObject *ProcessPool_exit(ProcessPoolObject *self, PyObject *args) {
+    process_shutdown(self, true);
+    Py_RETURN_FALSE;
+}
+
+/* Forks the workers: each one is a copy of the warm interpreter */
+static int process_fork(ProcessPoolObject *self, InterpreterObject *interpreter) {
+    pid_t parent = getpid();
+    int index;
+    for (index = 0; index < self->size; index++) {
+        process_worker *worker = &self->workers[index];
+        worker->pool = self;
+        worker->channel = &self->channels[index];
+        if (sem_init(&worker->channel->request.data, 1, 0) != 0 ||
+            sem_init(&worker->channel->request.space, 1, 0) != 0 ||
+            sem_init(&worker->channel->response.data, 1, 0) != 0 ||
+            sem_init(&worker->channel->response.space, 1, 0) != 0) {
+            PyErr_SetFromErrno(PyExc_OSError);
+            return -1;
+        }
+        if (!(worker->wakeup = PyThread_allocate_lock())) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        PyThread_acquire_lock(worker->wakeup, WAIT_LOCK);
+        worker->pid = fork();
+        if (worker->pid == 0) {
+            PyOS_AfterFork();
+            process_parent = parent;
+            process_worker_main(worker->channel, interpreter);
+        } else if (worker->pid < 0) {
+            PyErr_SetFromErrno(PyExc_OSError);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Initialization function environment.
+ */
+static int ProcessPool_init(ProcessPoolObject *self, PyObject *args, PyObject *kwargs) {
+    static char *kwlist[] = {"size", "init_script", "args", NULL};
+    PyObject *init_script = Py_None, *iargs = NULL, *futures, *interpreter, *ret;
+    int size, index, status;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "i|OO!", kwlist, &size, &init_script,
+                                     &PyTuple_Type, &iargs))
+        return -1;
+
+    if (self->workers) {
+        PyErr_SetString(PyExc_RuntimeError, "pool already initialized");
+        return -1;
+    }
+    if (size < 1) {
+        PyErr_SetString(PyExc_ValueError, "pool size must be greater than zero");
+        return -1;
+    }
+    if (!(futures = PyImport_ImportModule("concurrent.futures")))
+        return -1;
+    self->future_type = PyObject_GetAttrString(futures, "Future");
+    Py_DECREF(futures);
+    if (!self->future_type)
+        return -1;
+
+    self->channels = mmap(NULL, sizeof(process_channel) * size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (self->channels == MAP_FAILED) {
+        self->channels = NULL;
+        PyErr_SetFromErrno(PyExc_OSError);
+        return -1;
+    }
+    self->workers = calloc((size_t) size, sizeof(process_worker));
+    self->finished = PyThread_allocate_lock();
+    if (!self->workers || !self->finished) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    PyThread_acquire_lock(self->finished, WAIT_LOCK);
+    self->size = size;
+
+    // Interpreter(*args) + init script, copied by the workers
+    if (iargs) {
+        interpreter = PyObject_CallObject((PyObject *) &InterpreterObject_Type, iargs);
+    } else {
+        interpreter = PyObject_CallObject((PyObject *) &InterpreterObject_Type, NULL);
+    }
+    if (!interpreter) return -1;
+    if (init_script != Py_None) {
+        ret = PyObject_CallMethod(interpreter, "execute", "(O)", init_script);
+        if (!ret) {
+            Py_DECREF(interpreter);
+            return -1;
+        }
+        Py_DECREF(ret);
+    }
+    status = process_fork(self, (InterpreterObject *) interpreter);
+    Py_DECREF(interpreter);
+
+    PyEval_InitThreads();
+    for (index = 0; index < size && self->workers[index].pid > 0; index++) {
+        Py_INCREF(self); // released by the feeder thread
+        if (PyThread_start_new_thread(process_feeder_main, &self->workers[index]) == -1) {
+            Py_DECREF(self);
+            kill(self->workers[index].pid, SIGTERM);
+            waitpid(self->workers[index].pid, NULL, 0);
+            if (status == 0) PyErr_SetString(PyExc_RuntimeError, "can't start new thread");
+            status = -1;
+            continue;
+        }
+        self->alive++;
+    }
+    if (self->alive == 0) {
+        PyThread_release_lock(self->finished);
+    }
+    if (status != 0) {
+        PyObject *ptype, *pvalue, *ptraceback;
+        PyErr_Fetch(&ptype, &pvalue, &ptraceback);
+        process_shutdown(self, true);
+        PyErr_Restore(ptype, pvalue, ptraceback);
+        return -1;
+    }
+    return 0;
+}
+
+static void ProcessPool_dealloc(ProcessPoolObject *self) {
+    int index;
+    process_job *job;
+    // feeders are finished (each one holds a reference)
+    while ((job = process_job_take(self))) {
+        process_job_free(job);
+    }
+    if (self->workers) {
+        for (index = 0; index < self->size; index++) {
+            process_worker *worker = &self->workers[index];
+            if (worker->wakeup) PyThread_free_lock(worker->wakeup);
+            if (worker->channel) {
+                sem_destroy(&worker->channel->request.data);
+                sem_destroy(&worker->channel->request.space);
+                sem_destroy(&worker->channel->response.data);
+                sem_destroy(&worker->channel->response.space);
+            }
+        }
+        free(self->workers);
+    }
+    if (self->channels) munmap(self->channels, sizeof(process_channel) * self->size);
+    if (self->finished) PyThread_free_lock(self->finished);
+    Py_XDECREF(self->future_type);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyMethodDef ProcessPool_methods[] = {
+    {"submit",    (PyCFunction) ProcessPool_submit,   METH_VARARGS | METH_KEYWORDS,
+            "submit(code[, args]): executes the code (or calls the global function with args) "
+            "in a worker process. Returns a future."},
+    {"execute",   (PyCFunction) ProcessPool_execute,  METH_VARARGS,
+            "executes the code in a worker process and returns its value."},
+    {"call",      (PyCFunction) ProcessPool_call,     METH_VARARGS,
+            "call(name, *args): calls the global function in a worker process."},
+    {"shutdown",  (PyCFunction) ProcessPool_shutdown, METH_VARARGS | METH_KEYWORDS,
+            "finishes the pending jobs and stops the worker processes."},
+    {"__enter__", (PyCFunction) ProcessPool_enter,    METH_NOARGS, NULL},
+    {"__exit__",  (PyCFunction) ProcessPool_exit,     METH_VARARGS, NULL},
+    {NULL,         NULL}
+};
+
+PyTypeObject ProcessPoolObject_Type = {
+    PyObject_HEAD_INIT(NULL)
+    0,                         /*ob_size*/
+    "lua.ProcessPool",         /*tp_name*/
+    sizeof(ProcessPoolObject), /*tp_basicsize*/
+    0,                         /*tp_itemsize*/
+    (destructor) ProcessPool_dealloc, /*tp_dealloc*/
+    0,                         /*tp_print*/
+    0,                         /*tp_getattr*/
+    0,                         /*tp_setattr*/
+    0,                         /*tp_compare*/
+    0,                         /*tp_repr*/
+    0,                         /*tp_as_number*/
+    0,                         /*tp_as_sequence*/
+    0,                         /*tp_as_mapping*/
+    0,                         /*tp_hash */
+    0,                         /*tp_call*/
+    0,                         /*tp_str*/
+    0,                         /*tp_getattro*/
+    0,                         /*tp_setattro*/
+    0,                         /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,/*tp_flags*/
+    "Pool of processes running copies of a Lua interpreter", /* tp_doc */
+    0,                         /* tp_traverse */
+    0,                         /* tp_clear */
+    0,                         /* tp_richcompare */
+    0,                         /* tp_weaklistoffset */
+    0,                         /* tp_iter */
+    0,                         /* tp_iternext */
+    ProcessPool_methods,       /* tp_methods */
+    0,                         /* tp_members */
+    0,                         /* tp_getset */
+    0,                         /* tp_base */
+    0,                         /* tp_dict */
+    0,                         /* tp_descr_get */
+    0,                         /* tp_descr_set */
+    0,                         /* tp_dictoffset */
+    (initproc)ProcessPool_init, /* tp_init */
+    PyType_GenericAlloc,       /* tp_alloc */
+    PyType_GenericNew,         /* tp_new */
+    PyObject_Del,              /*tp_free*/
+    0,                         /*tp_is_gc*/
+};
+
+#endif
@@ -0,0 +1,17 @@
+//
+// Created by alex on 19/10/2026.
+//
+
+#ifndef LUNATIC_PROCESS_H
+#define LUNATIC_PROCESS_H
+
+#include <Python.h>
+
+#ifndef _WIN32
+// Bytes of each shared memory ring (requests and results)
+#define PROCESS_RING_SIZE (1 << 20)
+
+extern PyTypeObject ProcessPoolObject_Type;
+#endif
+
+#endif //LUNATIC_PROCESS_H
@@ -2,7 +2,21 @@
 // Created by alex on 26/09/2015.
 //
 
+#include <lua.h>
+#include <lstring.h>
+
+#if defined(_WIN32)
+#include "lapi.h"
+#else
+#include "lshared.h"
+#endif
+
 #include "pyconv.h"
+#include "pydispatch.h"
+#include "ucodec.h"
+#include "schema.h"
+#include "lregistry.h"
+#include "lcleanup.h"
 #include "utils.h"
 #include "constants.h"
 
@@ -14,9 +28,8 @@ void get_pyobject_string_buffer(lua_State *L, PyObject *obj, String *str) {
 
 /* python string unicode as string bytes */
 PyObject *get_pyobject_encoded_string_buffer(lua_State *L, PyObject *obj, String *str) {
-    char *encoding = python_getstring(L, PY_UNICODE_ENCODING);
-    char *errorhandler = python_getstring(L, PY_UNICODE_ENCODING_ERRORHANDLER);
-    PyObject *pyStr = PyUnicode_AsEncodedString(obj, encoding, errorhandler);
+    python_unicode_settings *unicode = python_unicode(L);
+    PyObject *pyStr = PyUnicode_AsEncodedString(obj, unicode->encoding, unicode->errors);
     if (!pyStr) lua_new_error(L, "converting unicode string");
     get_pyobject_string_buffer(L, pyStr, str);
     return pyStr;
@@ -32,6 +45,7 @@ py_object *py_object_container(lua_State *L, PyObject *obj, bool asindx) {
     pobj->object = obj;
     pobj->isargs = false;
     pobj->iskwargs = false;
+    pobj->optional = false;
     return pobj;
 }
 #pragma clang diagnostic pop
@@ -41,142 +55,400 @@ Conversion push_pyobject_container(lua_State *L, PyObject *obj, bool asindx) {
     return WRAPPED;
 }
 
-lua_Object py_object_raw(lua_State *L, PyObject *obj,
-                         lua_Object lptable, PyObject *lpkey) {
-    lua_Object ltable = lua_createtable(L);
-    if (PyObject_IsDictInstance(obj)) {
-        PyObject *iterator = PyObject_GetIter(obj); // iterator keys
-        if (!iterator) lua_new_error(L, "failed to create the dictionary iterator");
-        PyObject *key, *value;
-        while ((key = PyIter_Next(iterator))) {
-            value = PyObject_GetItem(obj, key);
-            if (!value) {
-                Py_DECREF(iterator); Py_DECREF(key);
-                lua_raise_error(L, "failed to convert the key value %s", key);
-            }
-            if (PyObject_IsDictInstance(value) || PyObject_IsListInstance(value) ||
-                PyObject_IsTupleInstance(value)) {
-                if (py_object_raw(L, value, ltable, key) == LUA_NOOBJECT) {
-                    Py_DECREF(key); Py_DECREF(value); Py_DECREF(iterator);
-                    lua_raise_error(L, "raw type not supported \"%s\"", value);
-                } else {
-                    Py_DECREF(value);
-                }
-            } else {
-                lua_pushobject(L, ltable);
-                if (py_convert(L, key) == CONVERTED) Py_DECREF(key);
-                if (py_convert(L, value) == CONVERTED) Py_DECREF(value);
-                lua_settable(L);
+/* Container being converted into a table (python.table / Interpreter.to_lua) */
+typedef struct {
+    PyObject *object;  // dict or the list / tuple (PySequence_Fast) or the record
+    SchemaObject *schema;  // of the record (fields by the schema) or NULL
+    Hash *hash;
+    Py_ssize_t pos;
+} pyconv_frame;
+
+typedef struct {
+    pyconv_frame *frames;
+    int count;
+    int capacity;
+    PyObject *memo;  // id(container) -> (container, table): the container is kept alive
+    bool byref;
+    int state;  // PY_STATE_ID (keys of the schemas)
+    int codec;
+    char *encoding;
+    char *errorhandler;
+} pyconv_stack;
+
+/* Creates the table of the container or record (presized) and pushes its frame */
+static int pyconv_open(lua_State *L, pyconv_stack *stack, PyObject *obj, SchemaObject *schema, TObject *o) {
+    PyObject *id = PyLong_FromVoidPtr(obj), *entry, *table;
+    if (!id)
+        return -1;
+    if ((entry = PyDict_GetItem(stack->memo, id))) {  // shared or cyclic
+        Py_DECREF(id);
+        ttype(o) = LUA_T_ARRAY;
+        avalue(o) = (Hash *) PyLong_AsVoidPtr(PyTuple_GET_ITEM(entry, 1));
+        return 0;
+    }
+    if (stack->count == stack->capacity) {
+        int capacity = stack->capacity ? stack->capacity * 2 : 16;
+        pyconv_frame *frames = realloc(stack->frames, capacity * sizeof(pyconv_frame));
+        if (!frames) {
+            Py_DECREF(id);
+            PyErr_NoMemory();
+            return -1;
+        }
+        stack->frames = frames;
+        stack->capacity = capacity;
+    }
+    PyObject *object;
+    Py_ssize_t size;
+    if (schema) {
+        if (schema_check(schema, obj) != 0 || schema_keys(schema, L, stack->state) != 0) {
+            Py_DECREF(id);
+            return -1;
+        }
+        Py_INCREF(obj);
+        object = obj;
+        size = PyTuple_GET_SIZE(schema->fields);
+    } else if (PyDict_Check(obj)) {
+        Py_INCREF(obj);
+        object = obj;
+        size = PyDict_Size(obj);
+    } else if (!(object = PySequence_Fast(obj, "list or tuple expected"))) {
+        Py_DECREF(id);
+        return -1;
+    } else {
+        size = PySequence_Fast_GET_SIZE(object);
+    }
+    Hash *hash = luaH_new(L, (int) size);
+    // a field read by a property is a new object: its id is not reused while memoized
+    entry = NULL;
+    if (!(table = PyLong_FromVoidPtr(hash)) || !(entry = PyTuple_Pack(2, obj, table)) ||
+        PyDict_SetItem(stack->memo, id, entry) != 0) {
+        Py_XDECREF(entry);
+        Py_XDECREF(table);
+        Py_DECREF(id);
+        Py_DECREF(object);
+        return -1;
+    }
+    Py_DECREF(entry);
+    Py_DECREF(table);
+    Py_DECREF(id);
+    pyconv_frame *frame = &stack->frames[stack->count++];
+    frame->object = object;
+    frame->schema = schema;
+    Py_XINCREF(schema);
+    frame->hash = hash;
+    frame->pos = 0;
+    ttype(o) = LUA_T_ARRAY;
+    avalue(o) = hash;
+    return 0;
+}
+
+/**
+ * Converts the object into the internal value. The other objects go through py_convert
+ * (the collector may run: the pending value is kept in the C stack before).
+ **/
+static int pyconv_value(lua_State *L, pyconv_stack *stack, PyObject *obj,
+                        TObject *o, TObject *pending) {
+    py_dispatch_entry *entry;
+    if (obj == Py_None || obj == Py_False) {
+        ttype(o) = LUA_T_NIL;
+        return 0;
+    } else if (obj == Py_True) {
+        ttype(o) = LUA_T_NUMBER;
+        nvalue(o) = 1;
+        return 0;
+    } else if (!(entry = py_dispatch(Py_TYPE(obj)))) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    switch (entry->kind) {
+#if PY_MAJOR_VERSION < 3
+        case PY_KIND_INT:
+            ttype(o) = LUA_T_NUMBER;
+            nvalue(o) = PyInt_AS_LONG(obj);
+            return 0;
+        case PY_KIND_STRING:
+            if (stack->byref) break;
+            ttype(o) = LUA_T_STRING;
+            tsvalue(o) = luaS_newlstr(L, PyString_AS_STRING(obj), PyString_GET_SIZE(obj));
+            return 0;
+#endif
+        case PY_KIND_FLOAT:
+            ttype(o) = LUA_T_NUMBER;
+            nvalue(o) = PyFloat_AS_DOUBLE(obj);
+            return 0;
+        case PY_KIND_LONG:
+            ttype(o) = LUA_T_NUMBER;
+            nvalue(o) = PyLong_AsDouble(obj);
+            return nvalue(o) == -1.0 && PyErr_Occurred() ? -1 : 0;
+        case PY_KIND_UNICODE: {
+            if (stack->byref) break;
+#if PY_MAJOR_VERSION < 3
+            Py_ssize_t len;
+            char *s = ucodec_encode(stack->codec, obj, &len);
+            if (s) {
+                ttype(o) = LUA_T_STRING;
+                tsvalue(o) = luaS_newlstr(L, s, len);
+                return 0;
             }
+#endif
+            PyObject *str = PyUnicode_AsEncodedString(obj, stack->encoding, stack->errorhandler);
+            if (!str)
+                return -1;
+            ttype(o) = LUA_T_STRING;
+            tsvalue(o) = luaS_newlstr(L, PyBytes_AS_STRING(str), PyBytes_GET_SIZE(str));
+            Py_DECREF(str);
+            return 0;
         }
-        Py_DECREF(iterator);
-        if (PyErr_Occurred()) {
-            lua_raise_error(L, "failure iterating dictionary: %s", obj);
+        case PY_KIND_WRAP:
+            if (entry->index)  // dict, list or tuple
+                return pyconv_open(L, stack, obj, NULL, o);
+            break;
+        case PY_KIND_SCHEMA:
+            return pyconv_open(L, stack, obj, (SchemaObject *) entry->converter, o);
+        default:
+            break;
+    }
+    if (pending) {
+        luaA_pushobject(L, pending);
+        lua_pop(L);
+    }
+    Py_INCREF(obj);  // the container keeps the reference
+    if (py_convert(L, obj) != WRAPPED)
+        Py_DECREF(obj);
+    *o = *lapi_address(L, lua_pop(L));
+    return 0;
+}
+
+/* Fills the table at the top of the stack until a new container is opened */
+static int pyconv_fill(lua_State *L, pyconv_stack *stack) {
+    int top = stack->count - 1;
+    TObject key, value;
+    while (stack->count == top + 1) {
+        pyconv_frame *frame = &stack->frames[top];
+        if (frame->schema) {
+            if (frame->pos >= PyTuple_GET_SIZE(frame->schema->fields))
+                break;
+            ttype(&key) = LUA_T_STRING;
+            tsvalue(&key) = frame->schema->keys[frame->pos];
+            PyObject *field = schema_field(frame->schema, frame->object, frame->pos++);
+            if (!field)
+                return -1;
+            int status = pyconv_value(L, stack, field, &value, NULL);  // the keys are locked
+            Py_DECREF(field);
+            if (status != 0)
+                return -1;
+        } else if (PyDict_Check(frame->object)) {
+            PyObject *k, *v;
+            if (!PyDict_Next(frame->object, &frame->pos, &k, &v))
+                break;
+            if (pyconv_value(L, stack, k, &key, NULL) != 0 ||
+                pyconv_value(L, stack, v, &value, &key) != 0)
+                return -1;
+            if (ttype(&key) == LUA_T_NIL) {
+                PyErr_SetString(PyExc_ValueError, "table index is nil");
+                return -1;
+            }
+        } else {
+            if (frame->pos >= PySequence_Fast_GET_SIZE(frame->object))
+                break;
+            PyObject *item = PySequence_Fast_ITEMS(frame->object)[frame->pos++];
+            if (pyconv_value(L, stack, item, &value, NULL) != 0)
+                return -1;
+            ttype(&key) = LUA_T_NUMBER;
+            nvalue(&key) = (double) frame->pos;
         }
-    } else if (PyObject_IsListInstance(obj) || PyObject_IsTupleInstance(obj)) {
-        Py_ssize_t index, size = PyObject_Size(obj);
-        PyObject *ikey, *value;
-        for (index = 0; index < size; index++) {
-            ikey = PyInt_FromSsize_t(index);
-            value = PyObject_GetItem(obj, ikey);
-            Py_DECREF(ikey);
-            if (PyObject_IsDictInstance(value) || PyObject_IsListInstance(value) ||
-                PyObject_IsTupleInstance(value)) {
-                ikey = PyInt_FromSsize_t(index + 1);
-                if (py_object_raw(L, value, ltable, ikey) == LUA_NOOBJECT) {
-                    Py_DECREF(ikey); Py_DECREF(value);
-                    lua_raise_error(L, "raw type not supported \"%s\"", value);
-                } else {
-                    Py_DECREF(value);
-                }
-            } else {
-                lua_pushobject(L, ltable);
-                lua_pushnumber(L, index + 1);
-                if (py_convert(L, value) == CONVERTED) Py_DECREF(value);
-                lua_settable(L);
+        if (ttype(&value) != LUA_T_NIL)
+            *luaH_set(L, stack->frames[top].hash, &key) = value;
+    }
+    if (stack->count == top + 1) {  // done
+        Py_DECREF(stack->frames[top].object);
+        Py_XDECREF(stack->frames[top].schema);
+        stack->count--;
+    }
+    return 0;
+}
+
+/**
+ * Converts the dict, list or tuple (and the containers inside it) into a new table,
+ * with an explicit stack. A container referenced several times (or cyclic) becomes
+ * the same table. The records with a schema (explicit or registered for the type)
+ * are converted by it. Returns LUA_NOOBJECT with the Python error set on failure.
+ **/
+lua_Object py_schema_table(lua_State *L, PyObject *obj, PyObject *schema) {
+    if (!schema && !PyDict_Check(obj) && !PyList_Check(obj) && !PyTuple_Check(obj)) {
+        PyErr_Format(PyExc_TypeError, "raw type not supported \"%.200s\"", Py_TYPE(obj)->tp_name);
+        return LUA_NOOBJECT;
+    }
+    pyconv_stack stack = {NULL, 0, 0, NULL, false, 0, LUA_CODEC_OTHER, NULL, NULL};
+    stack.byref = is_byref(L);
+    stack.state = python_getnumber(L, PY_STATE_ID);
+    python_unicode_settings *unicode = python_unicode(L);
+    stack.codec = unicode->codec;
+    stack.encoding = unicode->encoding;
+    stack.errorhandler = unicode->errors;
+    if (!(stack.memo = PyDict_New()))
+        return LUA_NOOBJECT;
+    lua_Object ltable = LUA_NOOBJECT;
+    TObject root;
+    if (pyconv_open(L, &stack, obj, (SchemaObject *) schema, &root) == 0) {
+        luaA_pushobject(L, &root);  // reachable by the collector
+        ltable = lua_pop(L);
+        while (stack.count > 0) {
+            if (pyconv_fill(L, &stack) != 0) {
+                ltable = LUA_NOOBJECT;
+                break;
             }
         }
-    } else {
-        return LUA_NOOBJECT; // error: invalid type
     }
-    if (lptable && lpkey) {
-        lua_pushobject(L, lptable);
-        if (py_convert(L, lpkey) == CONVERTED) Py_DECREF(lpkey);
-        lua_pushobject(L, ltable);
-        lua_settable(L);
+    while (stack.count > 0) {
+        stack.count--;
+        Py_DECREF(stack.frames[stack.count].object);
+        Py_XDECREF(stack.frames[stack.count].schema);
     }
+    free(stack.frames);
+    Py_DECREF(stack.memo);
+#if PY_MAJOR_VERSION < 3
+    ucodec_release();
+#endif
     return ltable;
 }
 
+lua_Object py_object_table(lua_State *L, PyObject *obj) {
+    py_dispatch_entry *entry = py_dispatch(Py_TYPE(obj));
+    if (!entry)
+        return LUA_NOOBJECT;
+    return py_schema_table(L, obj, entry->kind == PY_KIND_SCHEMA ? entry->converter : NULL);
+}
+
 /* Convert types in Python directly to the Lua */
 void pyobj2table(lua_State *L) {
     lua_Object lobj = lua_getparam(L, 1);
     if (is_object_container(L, lobj)) {
         py_object *obj = get_py_object(L, lobj);
-        lua_Object retval = py_object_raw(L, obj->object, 0, NULL);
+        lua_Object retval = py_object_table(L, obj->object);
         if (retval == LUA_NOOBJECT)
-            lua_raise_error(L, "raw type not supported \"%s\"", obj->object);
+            lua_raise_error(L, "failed to convert \"%s\" to table", obj->object);
         lua_pushobject(L, retval);
     } else {
         lua_pushobject(L, lobj);
     }
 }
 
-static Conversion xpush_pyobject_container(lua_State *L, PyObject *obj) {
-    return push_pyobject_container(L, obj, check_pyobject_index(obj));
+static Conversion xpush_pyobject_container(lua_State *L, PyObject *obj, py_dispatch_entry *entry) {
+    return push_pyobject_container(L, obj, entry->index);
+}
+
+/**
+ * Pushes the value returned by the converter of the type (containers as tables).
+ * The value is not passed to its own converter again (no recursion between converters).
+**/
+static Conversion py_convert_user(lua_State *L, PyObject *o, py_dispatch_entry *entry) {
+    PyObject *converter = entry->converter;
+    bool index = entry->index;  // the entry may move (cache changed by the converter)
+    Py_INCREF(converter);
+    PyObject *value = PyObject_CallFunctionObjArgs(converter, o, NULL);
+    Py_DECREF(converter);
+    if (!value)
+        lua_raise_error(L, "converter of \"%s\" failed", o);
+    if (Py_TYPE(value) == Py_TYPE(o)) { // converted to itself
+        push_pyobject_container(L, value, index);
+    } else if (PyDict_Check(value) || PyList_Check(value) || PyTuple_Check(value)) {
+        lua_Object ltable = py_object_table(L, value);
+        Py_DECREF(value);
+        if (ltable == LUA_NOOBJECT)
+            lua_raise_error(L, "converter of \"%s\" failed", o);
+        lua_pushobject(L, ltable);
+    } else if ((entry = py_dispatch(Py_TYPE(value))) && entry->kind == PY_KIND_CONVERTER) {
+        push_pyobject_container(L, value, entry->index);
+    } else {
+        lua_cleanup_push(L, value); // released also if the conversion raises a Lua error
+        if (py_convert(L, value) != CONVERTED)
+            Py_INCREF(value); // kept by the container
+    }
+    return CONVERTED; // the original object is not kept
 }
 
 Conversion py_convert(lua_State *L, PyObject *o) {
     Conversion ret;
     if (o == Py_None || o == Py_False) {
         lua_pushnil(L);
-        ret = CONVERTED;
+        return CONVERTED;
     } else if (o == Py_True) {
         lua_pushnumber(L, 1);
-        ret = CONVERTED;
+        return CONVERTED;
+    }
+    py_dispatch_entry *entry = py_dispatch(Py_TYPE(o));
+    if (!entry) lua_new_error(L, "failed to dispatch the conversion");
+    switch (entry->kind) {
 #if PY_MAJOR_VERSION >= 3
-        } else if (PyUnicode_Check(o)) {
-        Py_ssize_t len;
-        char *s = PyUnicode_AsUTF8AndSize(o, &len);
-        lua_pushstring(L, s);
-        ret = CONVERTED;
+        case PY_KIND_UNICODE: {
+            Py_ssize_t len;
+            char *s = PyUnicode_AsUTF8AndSize(o, &len);
+            lua_pushlstring(L, s, len);
+            ret = CONVERTED;
+            break;
+        }
 #else
-    } else if (PyString_Check(o)) {
-        if (is_byref(L)) {
-            ret = xpush_pyobject_container(L, o);
-        } else {
-            String str;
-            get_pyobject_string_buffer(L, o, &str);
-            lua_pushlstring(L, str.buff, str.size);
+        case PY_KIND_STRING:
+            if (is_byref(L)) {
+                ret = xpush_pyobject_container(L, o, entry);
+            } else {
+                lua_pushlstring(L, PyString_AS_STRING(o), PyString_GET_SIZE(o));
+                ret = CONVERTED;
+            }
+            break;
+        case PY_KIND_UNICODE:
+            if (is_byref(L)) {
+                ret = xpush_pyobject_container(L, o, entry);
+            } else {
+                Py_ssize_t len;
+                char *s = ucodec_encode(python_unicode(L)->codec, o, &len);
+                if (s) {
+                    lua_pushlstring(L, s, len);
+                    ucodec_release();
+                } else { // codec registry
+                    String str;
+                    PyObject *pyStr = get_pyobject_encoded_string_buffer(L, o, &str);
+                    lua_pushlstring(L, str.buff, str.size);
+                    Py_DECREF(pyStr);
+                }
+                ret = CONVERTED;
+            }
+            break;
+        case PY_KIND_INT:
+            lua_pushnumber(L, PyInt_AS_LONG(o));
+            ret = CONVERTED;
+            break;
+#endif
+        case PY_KIND_LONG: {
+            double num = PyLong_AsDouble(o);  // as pyconv_value (no long overflow)
+            if (num == -1.0 && PyErr_Occurred())
+                lua_new_error(L, "converting python long");
+            lua_pushnumber(L, num);
             ret = CONVERTED;
+            break;
         }
-    } else if (PyUnicode_Check(o)) {
-        if (is_byref(L)) {
-            ret = xpush_pyobject_container(L, o);
-        } else {
-            String str;
-            PyObject *pyStr = get_pyobject_encoded_string_buffer(L, o, &str);
-            lua_pushlstring(L, str.buff, str.size);
-            Py_DECREF(pyStr);
+        case PY_KIND_FLOAT:
+            lua_pushnumber(L, PyFloat_AS_DOUBLE(o));
+            ret = CONVERTED;
+            break;
+        case PY_KIND_LUAOBJECT:
+            lua_pushobject(L, lregistry_get(L, ((LuaObject*)o)->ref));
+            ret = CONVERTED;
+            break;
+        case PY_KIND_CONVERTER:
+            ret = py_convert_user(L, o, entry);
+            break;
+        case PY_KIND_SCHEMA: {
+            lua_Object ltable = py_schema_table(L, o, entry->converter);
+            if (ltable == LUA_NOOBJECT)
+                lua_raise_error(L, "failed to convert \"%s\" by the schema", o);
+            lua_pushobject(L, ltable);
             ret = CONVERTED;
+            break;
         }
-#endif
-#if PY_MAJOR_VERSION < 3
-    } else if (PyInt_Check(o)) {
-        lua_pushnumber(L, PyInt_AsLong(o));
-        ret = CONVERTED;
-#endif
-    } else if (PyLong_Check(o)) {
-        lua_pushnumber(L, PyLong_AsLong(o));
-        ret = CONVERTED;
-    } else if (PyFloat_Check(o)) {
-        lua_pushnumber(L, PyFloat_AsDouble(o));
-        ret = CONVERTED;
-    } else if (LuaObject_Check(o)) {
-        lua_pushobject(L, lua_getref(L, ((LuaObject*)o)->ref));
-        ret = CONVERTED;
-    } else {
-        ret = xpush_pyobject_container(L, o);
+        default:
+            ret = xpush_pyobject_container(L, o, entry);
     }
     return ret;
 }
@@ -18,6 +18,10 @@ typedef struct {
     int ref;
     int refiter;
     bool indexed;
+    void *identity;          // address of the table/function/userdata (key of the cache)
+    PyObject *weakreflist;
+    PyObject **reach;        // objects of the containers only it reaches (Interpreter.collect)
+    Py_ssize_t nreach;
 } LuaObject;
 
 typedef struct STRING {
@@ -34,6 +38,8 @@ typedef enum {
 py_object *py_object_container(lua_State *L, PyObject *obj, bool asindx);
 Conversion push_pyobject_container(lua_State *L, PyObject *obj, bool asindx);
 Conversion py_convert(lua_State *L, PyObject *o);
+lua_Object py_object_table(lua_State *L, PyObject *obj);
+lua_Object py_schema_table(lua_State *L, PyObject *obj, PyObject *schema);
 void pyobj2table(lua_State *L);
 
 void get_pyobject_string_buffer(lua_State *L, PyObject *obj, String *str);
@@ -0,0 +1,138 @@
+//
+// Created by alex on 19/10/2026.
+//
+// The cache and the registry are used with the GIL held.
+
+#include <stdint.h>
+#include "pydispatch.h"
+#include "pyconv.h"
+#include "schema.h"
+
+static py_dispatch_entry *dispatch_cache = NULL;
+static int dispatch_capacity = 0;
+static int dispatch_count = 0;
+
+// (type, converter) in the order of registration
+static PyObject *converters = NULL;
+
+static void py_dispatch_clear(void) {
+    int index;
+    for (index = 0; index < dispatch_capacity; index++) {
+        Py_CLEAR(dispatch_cache[index].type);
+    }
+    dispatch_count = 0;
+}
+
+static py_dispatch_entry *py_dispatch_slot(py_dispatch_entry *cache, int capacity, PyTypeObject *type) {
+    int index = (int) (((uintptr_t) type >> 4) & (capacity - 1));
+    while (cache[index].type && cache[index].type != type)
+        index = (index + 1) & (capacity - 1);
+    return &cache[index];
+}
+
+static int py_dispatch_grow(void) {
+    int capacity = dispatch_capacity ? dispatch_capacity * 2 : PY_DISPATCH_SIZE, index;
+    py_dispatch_entry *cache = calloc((size_t) capacity, sizeof(py_dispatch_entry));
+    if (!cache)
+        return -1;
+    for (index = 0; index < dispatch_capacity; index++) {
+        if (dispatch_cache[index].type)
+            *py_dispatch_slot(cache, capacity, dispatch_cache[index].type) = dispatch_cache[index];
+    }
+    free(dispatch_cache);
+    dispatch_cache = cache;
+    dispatch_capacity = capacity;
+    return 0;
+}
+
+/* Kind of the type (the user converters first, in the order of registration) */
+static void py_dispatch_classify(PyTypeObject *type, py_dispatch_entry *entry) {
+    Py_ssize_t index, size = converters ? PyList_GET_SIZE(converters) : 0;
+    entry->converter = NULL;
+    entry->index = PyType_IsSubtype(type, &PyList_Type) ||
+                   PyType_IsSubtype(type, &PyTuple_Type) ||
+                   PyType_IsSubtype(type, &PyDict_Type);
+    for (index = 0; index < size; index++) {
+        PyObject *item = PyList_GET_ITEM(converters, index);
+        if (PyType_IsSubtype(type, (PyTypeObject *) PyTuple_GET_ITEM(item, 0))) {
+            entry->converter = PyTuple_GET_ITEM(item, 1);
+            entry->kind = Schema_Check(entry->converter) ? PY_KIND_SCHEMA : PY_KIND_CONVERTER;
+            return;
+        }
+    }
+#if PY_MAJOR_VERSION < 3
+    if (PyType_IsSubtype(type, &PyString_Type)) {
+        entry->kind = PY_KIND_STRING;
+    } else if (PyType_IsSubtype(type, &PyUnicode_Type)) {
+        entry->kind = PY_KIND_UNICODE;
+    } else if (PyType_IsSubtype(type, &PyInt_Type)) {
+        entry->kind = PY_KIND_INT;
+    } else
+#else
+    if (PyType_IsSubtype(type, &PyUnicode_Type)) {
+        entry->kind = PY_KIND_UNICODE;
+    } else
+#endif
+    if (PyType_IsSubtype(type, &PyLong_Type)) {
+        entry->kind = PY_KIND_LONG;
+    } else if (PyType_IsSubtype(type, &PyFloat_Type)) {
+        entry->kind = PY_KIND_FLOAT;
+    } else if (PyType_IsSubtype(type, &LuaObject_Type)) {
+        entry->kind = PY_KIND_LUAOBJECT;
+    } else {
+        entry->kind = PY_KIND_WRAP;
+    }
+}
+
+/* Returns the (cached) conversion of the type or NULL (out of memory) */
+py_dispatch_entry *py_dispatch(PyTypeObject *type) {
+    py_dispatch_entry *entry;
+    if (dispatch_capacity && (entry = py_dispatch_slot(dispatch_cache, dispatch_capacity, type))->type)
+        return entry;
+    if (dispatch_count >= PY_DISPATCH_MAX) {
+        py_dispatch_clear();
+    } else if ((dispatch_count + 1) * 4 > dispatch_capacity * 3 && py_dispatch_grow() != 0) {
+        return NULL;
+    }
+    entry = py_dispatch_slot(dispatch_cache, dispatch_capacity, type);
+    py_dispatch_classify(type, entry);
+    Py_INCREF(type);
+    entry->type = type;
+    dispatch_count++;
+    return entry;
+}
+
+/**
+ * Registers the converter (callable: object -> value converted) of the type and its
+ * subclasses. None removes the converter. Returns -1 with the Python error set.
+ **/
+int py_dispatch_register(PyObject *type, PyObject *converter) {
+    Py_ssize_t index;
+    if (!PyType_Check(type)) {
+        PyErr_SetString(PyExc_TypeError, "type expected");
+        return -1;
+    }
+    if (converter != Py_None && !PyCallable_Check(converter)) {
+        PyErr_SetString(PyExc_TypeError, "converter must be callable (or None)");
+        return -1;
+    }
+    if (!converters && !(converters = PyList_New(0)))
+        return -1;
+    for (index = 0; index < PyList_GET_SIZE(converters); index++) {
+        if (PyTuple_GET_ITEM(PyList_GET_ITEM(converters, index), 0) == type) {
+            if (PySequence_DelItem(converters, index) != 0)
+                return -1;
+            break;
+        }
+    }
+    if (converter != Py_None) {
+        PyObject *item = PyTuple_Pack(2, type, converter);
+        if (!item || PyList_Append(converters, item) != 0) {
+            Py_XDECREF(item);
+            return -1;
+        }
+        Py_DECREF(item);
+    }
+    py_dispatch_clear();  // the types are classified again
+    return 0;
+}
@@ -0,0 +1,40 @@
+//
+// Created by alex on 19/10/2026.
+//
+// Conversion of the Python objects to Lua dispatched by the type: each type
+// is classified once (builtin kind or user converter) and cached.
+
+#ifndef LUNATIC_PYDISPATCH_H
+#define LUNATIC_PYDISPATCH_H
+
+#include <Python.h>
+#include <stdbool.h>
+
+// Initial size of the type cache (power of two)
+#define PY_DISPATCH_SIZE 64
+// The cache is cleared when it reaches this number of types
+#define PY_DISPATCH_MAX 4096
+
+typedef enum {
+    PY_KIND_WRAP = 0,   // container (python object)
+    PY_KIND_STRING,
+    PY_KIND_UNICODE,
+    PY_KIND_INT,
+    PY_KIND_LONG,
+    PY_KIND_FLOAT,
+    PY_KIND_LUAOBJECT,
+    PY_KIND_CONVERTER,  // user converter
+    PY_KIND_SCHEMA      // record converted by the schema (converter)
+} py_kind;
+
+typedef struct {
+    PyTypeObject *type;    // strong reference (NULL empty)
+    py_kind kind;
+    bool index;            // list, tuple or dict (accessed by index)
+    PyObject *converter;   // borrowed from the registry
+} py_dispatch_entry;
+
+py_dispatch_entry *py_dispatch(PyTypeObject *type);
+int py_dispatch_register(PyObject *type, PyObject *converter);
+
+#endif //LUNATIC_PYDISPATCH_H
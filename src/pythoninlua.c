@@ -30,9 +30,18 @@
 
 #include "luaconv.h"
 #include "pyconv.h"
+#include "pydispatch.h"
+#include "ucodec.h"
+#include "luaarray.h"
+#include "lnumeric.h"
+#include "schema.h"
+#include "lpack.h"
+#include "ljson.h"
+#include "lregistry.h"
 #include "utils.h"
 #include "constants.h"
 #include "auxiliary.h"
+#include "lthread.h"
 
 
 static void py_object_call(lua_State *L) {
@@ -75,9 +84,9 @@ static void py_object_call(lua_State *L) {
         if (PyDict_Check(args)) luaL_argerror(L, 2, "object dict expected kwargs{a=1,...}");
 
     } else if (nargs > 0) {
-        python_setnumber(L, PY_LUA_TABLE_CONVERT, 1);
+        lua_cleanup_flag(L, PY_LUA_TABLE_CONVERT, 1);
         args = get_py_tuple(L, 1); // arbitrary args fn(1,2,'a')
-        python_setnumber(L, PY_LUA_TABLE_CONVERT, 0);
+        lua_cleanup_flag(L, PY_LUA_TABLE_CONVERT, 0);
         isargs = false;
     } else {
         args = PyTuple_New(0);
@@ -88,8 +97,9 @@ static void py_object_call(lua_State *L) {
     if (!iskwargs && kwargs)
         Py_DECREF(kwargs);
     if (value) {
-        if (py_convert(L, value) == CONVERTED) {
-            Py_DECREF(value);
+        lua_cleanup_push(L, value); // the conversion may raise a Lua error
+        if (py_convert(L, value) != CONVERTED) {
+            Py_INCREF(value); // kept by the container
         }
     } else {
         lua_raise_error(L, "call function python \"%s\"", pobj->object);
@@ -130,23 +140,41 @@ static void py_object_index_set(lua_State *L) {
     if (lua_gettop(L) < 2) {
         lua_error(L, "invalid arguments");
     }
+    if (LuaArray_Check(pobj->object)) { // without the key / value conversion
+        lua_array_index_set(L, (LuaArrayObject *) pobj->object, lua_getparam(L, 2), lua_getparam(L, 3));
+        return;
+    }
     set_py_object_index(L, pobj, 2, 3);
 }
 
+/**
+ * obj[key] (asindx) or obj.key.
+ * When missing (LookupError / AttributeError) the error is cleared: NULL and *missing set.
+**/
+static PyObject *py_object_lookup(PyObject *obj, PyObject *key, bool asindx, bool *missing) {
+    PyObject *item = asindx ? PyObject_GetItem(obj, key) : PyObject_GetAttr(obj, key);
+    *missing = false;
+    if (!item && PyErr_ExceptionMatches(asindx ? PyExc_LookupError : PyExc_AttributeError)) {
+        PyErr_Clear();
+        *missing = true;
+    }
+    return item;
+}
+
 static int get_py_object_index(lua_State *L, py_object *pobj, int keyn) {
     PyObject *key = lua_stack_convert(L, keyn);
     Conversion ret = UNCHANGED;
     PyObject *item;
+    bool missing;
     if (!key) luaL_argerror(L, 1, "failed to convert key");
-    if (pobj->asindx) {
-        item = PyObject_GetItem(pobj->object, key);
-    } else {
-        item = PyObject_GetAttr(pobj->object, key);
-    }
+    item = py_object_lookup(pobj->object, key, pobj->asindx, &missing);
     if (item) {
         if ((ret = py_convert(L, item)) == CONVERTED) {
             Py_DECREF(item);
         }
+    } else if (missing && pobj->optional) {
+        lua_pushnil(L);
+        ret = CONVERTED;
     } else {
         char *error = "%s \"%s\" not found";
         char *name = pobj->asindx ? "index" : "attribute";
@@ -162,8 +190,65 @@ static int get_py_object_index(lua_State *L, py_object *pobj, int keyn) {
     return ret;
 }
 
+/* Pushes obj[key] / obj.key, or the default argument (nil) when missing */
+static void py_object_lookup_default(lua_State *L, bool asindx, char *error) {
+    py_object *pobj = get_py_object(L, lua_getparam(L, 1));
+    PyObject *key = lua_stack_convert(L, 2);
+    bool missing;
+    if (!key) luaL_argerror(L, 2, "failed to convert key");
+    PyObject *item = py_object_lookup(pobj->object, key, asindx, &missing);
+    Py_DECREF(key);
+    if (item) {
+        if (py_convert(L, item) == CONVERTED) {
+            Py_DECREF(item);
+        }
+    } else if (missing) {
+        lua_Object ldefault = lua_getparam(L, 3);
+        if (ldefault == LUA_NOOBJECT) {
+            lua_pushnil(L);
+        } else {
+            lua_pushobject(L, ldefault);
+        }
+    } else {
+        lua_raise_error(L, error, pobj->object);
+    }
+}
+
+/* python.getattr(obj, name, default) */
+static void py_getattr(lua_State *L) {
+    py_object_lookup_default(L, false, "getattr of \"%s\" failed");
+}
+
+/* python.get(obj, key, default) */
+static void py_get(lua_State *L) {
+    py_object_lookup_default(L, true, "get of \"%s\" failed");
+}
+
+/* python.hasattr(obj, name): 1 or nil (other errors are raised) */
+static void py_hasattr(lua_State *L) {
+    py_object *pobj = get_py_object(L, lua_getparam(L, 1));
+    PyObject *key = lua_stack_convert(L, 2);
+    bool missing;
+    if (!key) luaL_argerror(L, 2, "failed to convert name");
+    PyObject *item = py_object_lookup(pobj->object, key, false, &missing);
+    Py_DECREF(key);
+    if (item) {
+        Py_DECREF(item);
+        lua_pushnumber(L, 1);
+    } else if (missing) {
+        lua_pushnil(L);
+    } else {
+        lua_raise_error(L, "hasattr of \"%s\" failed", pobj->object);
+    }
+}
+
 static void py_object_index_get(lua_State *L) {
-    get_py_object_index(L, get_py_object(L, lua_getparam(L, 1)), 2);
+    py_object *pobj = get_py_object(L, lua_getparam(L, 1));
+    if (LuaArray_Check(pobj->object)) {
+        lua_array_index_get(L, (LuaArrayObject *) pobj->object, lua_getparam(L, 2));
+        return;
+    }
+    get_py_object_index(L, pobj, 2);
 }
 
 static void py_object_gc(lua_State *L) {
@@ -267,6 +352,20 @@ static void py_asattr(lua_State *L) {
     push_pyobject_container(L, pobj->object, false);
 }
 
+/**
+ * Container where the missing indexes / attributes are nil (no error)
+ * Ex:
+ * local opts = python.optional(options)
+ * if opts.verbose then ... end
+**/
+static void py_optional(lua_State *L) {
+    py_object *pobj = get_py_object(L, lua_getparam(L, 1));
+    Py_INCREF(pobj->object); // new ref
+    py_object *optional = py_object_container(L, pobj->object, pobj->asindx);
+    optional->optional = true;
+    lua_pushusertag(L, optional, python_api_tag(L));
+}
+
 /* Enables list and tuple as arguments */
 static void py_asargs(lua_State *L) {
     py_object *pobj = get_py_object(L, lua_getparam(L, 1));
@@ -421,12 +520,16 @@ static void _set_unicode_encoding_errorhandler(lua_State *L, int stackpos) {
             }
         }
         python_setstring(L, PY_UNICODE_ENCODING_ERRORHANDLER, handler);
+        python_unicode_changed();
     }
 }
 
 /* function that allows changing the default encoding */
 static void py_set_unicode_encoding(lua_State *L) {
-    python_setstring(L, PY_UNICODE_ENCODING, luaL_check_string(L, 1));
+    char *encoding = luaL_check_string(L, 1);
+    python_setstring(L, PY_UNICODE_ENCODING, encoding);
+    python_setnumber(L, PY_UNICODE_CODEC, ucodec_id(encoding)); // resolved once
+    python_unicode_changed();
     _set_unicode_encoding_errorhandler(L, 2);
 }
 
@@ -435,6 +538,17 @@ static void py_set_unicode_encoding_errorhandler(lua_State *L) {
     _set_unicode_encoding_errorhandler(L, 1);
 }
 
+/* Lua strings converted to unicode (decoded with the encoding and its error handler) */
+static void py_set_unicode_decoding(lua_State *L) {
+    python_setnumber(L, PY_UNICODE_DECODING, luaL_check_number(L, 1) != 0);
+    python_unicode_changed();
+}
+
+/* Returns 1 when the Lua strings are converted to unicode */
+static void py_get_unicode_decoding(lua_State *L) {
+    lua_pushnumber(L, python_getnumber(L, PY_UNICODE_DECODING));
+}
+
 /* Returns the encoding used in the string conversion */
 static void py_get_unicode_encoding(lua_State *L) {
     lua_pushstring(L, python_getstring(L, PY_UNICODE_ENCODING));
@@ -445,25 +559,53 @@ static void py_get_unicode_encoding_errorhandler(lua_State *L) {
     lua_pushstring(L, python_getstring(L, PY_UNICODE_ENCODING_ERRORHANDLER));
 }
 
+/* Limits the depth of the tables converted to Python (0 unlimited, deeper tables as LuaObject) */
+static void py_set_table_depth(lua_State *L) {
+    int depth = luaL_check_int(L, 1);
+    if (depth < 0) lua_error(L, "#1 depth must be positive (0 unlimited)");
+    python_setnumber(L, PY_LUA_TABLE_DEPTH, depth);
+}
+
+/* Returns the depth of the tables converted to Python */
+static void py_get_table_depth(lua_State *L) {
+    lua_pushnumber(L, python_getnumber(L, PY_LUA_TABLE_DEPTH));
+}
+
+/* Registers the converter (python callable or None) of the python type and its subclasses */
+static void py_register_converter(lua_State *L) {
+    lua_Object ltype = lua_getparam(L, 1);
+    lua_Object lconverter = lua_getparam(L, 2);
+    if (!is_object_container(L, ltype))
+        lua_error(L, "#1 is not a container for python object!");
+    PyObject *converter = Py_None;
+    if (is_object_container(L, lconverter)) {
+        converter = get_pobject(L, lconverter);
+    } else if (!lua_isnil(L, lconverter)) {
+        lua_error(L, "#2 is not a container for python object!");
+    }
+    if (py_dispatch_register(get_pobject(L, ltype), converter) != 0)
+        lua_new_error(L, "failed to register the converter");
+}
+
 /* Convert a Lua table into a Python dictionary */
 static void table2dict(lua_State *L) {
-    python_setnumber(L, PY_LUA_TABLE_CONVERT, 1);
+    lua_cleanup_flag(L, PY_LUA_TABLE_CONVERT, 1);
     push_pyobject_container(L, get_py_dict(L, luaL_tablearg(L, 1)), true);
-    python_setnumber(L, PY_LUA_TABLE_CONVERT, 0);
+    lua_cleanup_flag(L, PY_LUA_TABLE_CONVERT, 0);
 }
 
 /* Convert a Lua table to a python tuple */
 static void table2tuple(lua_State *L) {
-    python_setnumber(L, PY_LUA_TABLE_CONVERT, 1);
+    lua_cleanup_flag(L, PY_LUA_TABLE_CONVERT, 1);
     push_pyobject_container(L, ltable_convert_tuple(L, luaL_tablearg(L, 1)), true);
-    python_setnumber(L, PY_LUA_TABLE_CONVERT, 0);
+    lua_cleanup_flag(L, PY_LUA_TABLE_CONVERT, 0);
 }
 
 /* Convert a Lua table to a python list */
 static void table2list(lua_State *L) {
-    python_setnumber(L, PY_LUA_TABLE_CONVERT, 1);
+    lua_cleanup_flag(L, PY_LUA_TABLE_CONVERT, 1);
     push_pyobject_container(L, ltable2list(L, luaL_tablearg(L, 1)), true);
-    python_setnumber(L, PY_LUA_TABLE_CONVERT, 0);
+    lua_cleanup_flag(L, PY_LUA_TABLE_CONVERT, 0);
 }
 
 /* Split lists and tuples slices o[start:end] */
@@ -488,6 +630,97 @@ static void pyobject_slice(lua_State *L) {
     }
 }
 
+/**
+ * Python object of the argument n (borrowed: released when the function returns).
+ * Containers are unwrapped; Lua tables are not copied (python.dict/list/tuple do it).
+**/
+static PyObject *py_builtin_arg(lua_State *L, int n) {
+    lua_Object lobj = lua_getparam(L, n);
+    if (is_object_container(L, lobj))
+        return get_pobject(L, lobj);
+    if (lua_istable(L, lobj))
+        luaL_argerror(L, n, "python object expected, got a Lua table");
+    PyObject *obj = lua_stack_convert(L, n);
+    if (!obj) luaL_argerror(L, n, "failed to convert to python object");
+    return lua_cleanup_push(L, obj);
+}
+
+/* Pushes the result of a builtin (new reference) */
+static void py_builtin_result(lua_State *L, PyObject *value, char *error, PyObject *obj) {
+    if (!value)
+        lua_raise_error(L, error, obj);
+    if (py_convert(L, value) == CONVERTED) {
+        Py_DECREF(value);
+    }
+}
+
+/* python.len(obj) */
+static void py_len(lua_State *L) {
+    PyObject *obj = py_builtin_arg(L, 1);
+    Py_ssize_t size = PyObject_Size(obj);
+    if (size < 0)
+        lua_raise_error(L, "len of \"%s\" failed", obj);
+    lua_pushnumber(L, (double) size);
+}
+
+/* python.isinstance(obj, cls): 1 or nil */
+static void py_isinstance(lua_State *L) {
+    PyObject *obj = py_builtin_arg(L, 1);
+    int status = PyObject_IsInstance(obj, py_builtin_arg(L, 2));
+    if (status < 0)
+        lua_raise_error(L, "isinstance of \"%s\" failed", obj);
+    if (status) {
+        lua_pushnumber(L, 1);
+    } else {
+        lua_pushnil(L);
+    }
+}
+
+/* python.contains(obj, value): 1 or nil (value in obj) */
+static void py_contains(lua_State *L) {
+    PyObject *obj = py_builtin_arg(L, 1);
+    int status = PySequence_Contains(obj, py_builtin_arg(L, 2));
+    if (status < 0)
+        lua_raise_error(L, "contains of \"%s\" failed", obj);
+    if (status) {
+        lua_pushnumber(L, 1);
+    } else {
+        lua_pushnil(L);
+    }
+}
+
+/* python.type(obj) */
+static void py_type(lua_State *L) {
+    PyObject *obj = py_builtin_arg(L, 1);
+    py_builtin_result(L, PyObject_Type(obj), "type of \"%s\" failed", obj);
+}
+
+/* python.str(obj) */
+static void py_str(lua_State *L) {
+    PyObject *obj = py_builtin_arg(L, 1);
+    py_builtin_result(L, PyObject_Str(obj), "str of \"%s\" failed", obj);
+}
+
+/* python.iter(obj) */
+static void py_iter(lua_State *L) {
+    PyObject *obj = py_builtin_arg(L, 1);
+    py_builtin_result(L, PyObject_GetIter(obj), "iter of \"%s\" failed", obj);
+}
+
+/* python.next(iterator): value, 1 or nil at the end (the value can be None: nil, 1) */
+static void py_next(lua_State *L) {
+    PyObject *obj = py_builtin_arg(L, 1);
+    if (!PyIter_Check(obj))
+        luaL_argerror(L, 1, "iterator expected");
+    PyObject *value = PyIter_Next(obj);
+    if (!value && !PyErr_Occurred()) {
+        lua_pushnil(L);
+    } else {
+        py_builtin_result(L, value, "next of \"%s\" failed", obj);
+        lua_pushnumber(L, 1);
+    }
+}
+
 static void python_system_init(lua_State *L);
 
 /** Ends the Python interpreter, freeing resources*/
@@ -506,68 +739,166 @@ static void python_is_embedded(lua_State *L) {
 }
 
 
+/* Lua functions are called with the GIL held (see lthread.h) */
+LUA_GIL_FUNC(py_execute)
+LUA_GIL_FUNC(py_eval)
+LUA_GIL_FUNC(py_asindx)
+LUA_GIL_FUNC(py_asattr)
+LUA_GIL_FUNC(py_optional)
+LUA_GIL_FUNC(py_getattr)
+LUA_GIL_FUNC(py_hasattr)
+LUA_GIL_FUNC(py_get)
+LUA_GIL_FUNC(py_len)
+LUA_GIL_FUNC(py_isinstance)
+LUA_GIL_FUNC(py_contains)
+LUA_GIL_FUNC(py_type)
+LUA_GIL_FUNC(py_str)
+LUA_GIL_FUNC(py_iter)
+LUA_GIL_FUNC(py_next)
+LUA_GIL_FUNC(py_object_repr)
+LUA_GIL_FUNC(py_locals)
+LUA_GIL_FUNC(py_globals)
+LUA_GIL_FUNC(py_builtins)
+LUA_GIL_FUNC(py_import)
+LUA_GIL_FUNC(python_system_init)
+LUA_GIL_FUNC(python_system_exit)
+LUA_GIL_FUNC(py_args)
+LUA_GIL_FUNC(py_kwargs)
+LUA_GIL_FUNC(py_args_array)
+LUA_GIL_FUNC(python_is_embedded)
+LUA_GIL_FUNC(py_get_version)
+LUA_GIL_FUNC(py_set_unicode_encoding)
+LUA_GIL_FUNC(py_get_unicode_encoding)
+LUA_GIL_FUNC(py_get_unicode_encoding_errorhandler)
+LUA_GIL_FUNC(py_set_unicode_decoding)
+LUA_GIL_FUNC(py_get_unicode_decoding)
+LUA_GIL_FUNC(py_set_unicode_encoding_errorhandler)
+LUA_GIL_FUNC(py_byref)
+LUA_GIL_FUNC(py_byrefc)
+LUA_GIL_FUNC(py_get_tag)
+LUA_GIL_FUNC(py_set_table_depth)
+LUA_GIL_FUNC(py_get_table_depth)
+LUA_GIL_FUNC(py_register_converter)
+LUA_GIL_FUNC(py_array)
+LUA_GIL_FUNC(py_fromarray)
+LUA_GIL_FUNC(py_columns)
+LUA_GIL_FUNC(py_schema)
+LUA_GIL_FUNC(py_pack)
+LUA_GIL_FUNC(py_unpack)
+LUA_GIL_FUNC(py_unpack_file)
+LUA_GIL_FUNC(py_json_encode)
+LUA_GIL_FUNC(py_json_decode)
+LUA_GIL_FUNC(table2dict)
+LUA_GIL_FUNC(table2tuple)
+LUA_GIL_FUNC(table2list)
+LUA_GIL_FUNC(pyobj2table)
+LUA_GIL_FUNC(pyobject_slice)
+LUA_GIL_FUNC(py_asargs)
+LUA_GIL_FUNC(py_askwargs)
+LUA_GIL_FUNC(py_readfile)
+LUA_GIL_FUNC(py_object_call)
+LUA_GIL_FUNC(py_object_index_get)
+LUA_GIL_FUNC(py_object_index_set)
+LUA_GIL_FUNC(py_object_gc)
+
 static struct luaL_reg py_lib[] = {
-    {"execute",                           py_execute}, // run arbitrary expressions in the interpreter.
-    {"eval",                              py_eval},  // assesses the value of a variable and returns its reference.
-    {"asindex",                           py_asindx}, // change the mode of access to attributes of an object for indexes.
-    {"asattr",                            py_asattr}, // changes the way to access the attributes of an object for attributes.
-    {"repr",                              py_object_repr}, // represents the object as a string (str(o)).
-    {"locals",                            py_locals}, // returns the local scope variables dictionary.
-    {"globals",                           py_globals}, // returns the global scope variables dictionary.
-    {"builtins",                          py_builtins}, // returns the dictionary embedded objects.
-    {"import",                            py_import}, // importing a module by its name (import("os")).
-    {"system_init",                       python_system_init}, // initializes the interpreter in the location.
-    {"system_exit",                       python_system_exit}, // terminates the interpreter (when embedded).
-    {"args",                              py_args},
-    {"kwargs",                            py_kwargs},
-    {"args_array",                        py_args_array},
-    {"is_embedded",                       python_is_embedded}, // report of the python interpreter was embedded in the Lua
-    {"get_version",                       py_get_version}, // return release of the extension.
-    {"set_unicode_encoding",              py_set_unicode_encoding},
-    {"get_unicode_encoding",              py_get_unicode_encoding},
-    {"get_unicode_encoding_errorhandler", py_get_unicode_encoding_errorhandler},
-    {"set_unicode_encoding_errorhandler", py_set_unicode_encoding_errorhandler},
-    {"byref",                             py_byref}, // returns the result reference (no conversion).
-    {"byrefc",                            py_byrefc}, // returns the result reference (no conversion).
-    {"tag",                               py_get_tag}, // returns the container tag objects python.
-    {"dict",                              table2dict}, // returns a converted table to dictionary.
-    {"tuple",                             table2tuple}, // returns a converted table to tuple.
-    {"list",                              table2list}, // returns a converted table to list.
-    {"table",                             pyobj2table}, // convert dict, list or tuple for a table.
-    {"raw",                               pyobj2table}, // convert dict, list or tuple for a table.
-    {"slice",                             pyobject_slice},
-    {"asargs",                            py_asargs},
-    {"askwargs",                          py_askwargs},
-    {"readfile",                          py_readfile},
+    {"execute",                           py_execute_gil}, // run arbitrary expressions in the interpreter.
+    {"eval",                              py_eval_gil},  // assesses the value of a variable and returns its reference.
+    {"asindex",                           py_asindx_gil}, // change the mode of access to attributes of an object for indexes.
+    {"asattr",                            py_asattr_gil}, // changes the way to access the attributes of an object for attributes.
+    {"optional",                          py_optional_gil}, // missing indexes / attributes of the object are nil.
+    {"getattr",                           py_getattr_gil}, // getattr(obj, name, default) without error when missing.
+    {"hasattr",                           py_hasattr_gil}, // 1 if the object has the attribute, else nil.
+    {"get",                               py_get_gil}, // obj[key] or default when missing.
+    {"len",                               py_len_gil}, // builtins without the lookup of python.builtins()
+    {"isinstance",                        py_isinstance_gil},
+    {"contains",                          py_contains_gil}, // value in obj
+    {"type",                              py_type_gil},
+    {"str",                               py_str_gil},
+    {"iter",                              py_iter_gil},
+    {"next",                              py_next_gil}, // next value of the iterator (nil at the end).
+    {"repr",                              py_object_repr_gil}, // represents the object as a string (str(o)).
+    {"locals",                            py_locals_gil}, // returns the local scope variables dictionary.
+    {"globals",                           py_globals_gil}, // returns the global scope variables dictionary.
+    {"builtins",                          py_builtins_gil}, // returns the dictionary embedded objects.
+    {"import",                            py_import_gil}, // importing a module by its name (import("os")).
+    {"system_init",                       python_system_init_gil}, // initializes the interpreter in the location.
+    {"system_exit",                       python_system_exit_gil}, // terminates the interpreter (when embedded).
+    {"args",                              py_args_gil},
+    {"kwargs",                            py_kwargs_gil},
+    {"args_array",                        py_args_array_gil},
+    {"is_embedded",                       python_is_embedded_gil}, // report of the python interpreter was embedded in the Lua
+    {"get_version",                       py_get_version_gil}, // return release of the extension.
+    {"set_unicode_encoding",              py_set_unicode_encoding_gil},
+    {"get_unicode_encoding",              py_get_unicode_encoding_gil},
+    {"get_unicode_encoding_errorhandler", py_get_unicode_encoding_errorhandler_gil},
+    {"set_unicode_encoding_errorhandler", py_set_unicode_encoding_errorhandler_gil},
+    {"set_unicode_decoding",              py_set_unicode_decoding_gil}, // lua strings as unicode.
+    {"get_unicode_decoding",              py_get_unicode_decoding_gil},
+    {"byref",                             py_byref_gil}, // returns the result reference (no conversion).
+    {"byrefc",                            py_byrefc_gil}, // returns the result reference (no conversion).
+    {"tag",                               py_get_tag_gil}, // returns the container tag objects python.
+    {"set_table_depth",                   py_set_table_depth_gil}, // max depth of the tables converted.
+    {"get_table_depth",                   py_get_table_depth_gil},
+    {"register_converter",                py_register_converter_gil}, // converter of a python type.
+    {"array",                             py_array_gil}, // numeric array shared with python (buffer).
+    {"fromarray",                         py_fromarray_gil}, // table {1..n} of the numbers of a buffer.
+    {"columns",                           py_columns_gil}, // records {{a=1}, ...} as a dict of lists.
+    {"schema",                            py_schema_gil}, // compiled converter of the records of a class.
+    {"pack",                              py_pack_gil}, // snapshot (binary string) of a value.
+    {"unpack",                            py_unpack_gil}, // value of a snapshot (string or python buffer).
+    {"unpack_file",                       py_unpack_file_gil}, // value of a snapshot file (memory mapped).
+    {"json_encode",                       py_json_encode_gil}, // JSON text of a table (no python objects).
+    {"json_decode",                       py_json_decode_gil}, // table of a JSON text.
+    {"dict",                              table2dict_gil}, // returns a converted table to dictionary.
+    {"tuple",                             table2tuple_gil}, // returns a converted table to tuple.
+    {"list",                              table2list_gil}, // returns a converted table to list.
+    {"table",                             pyobj2table_gil}, // convert dict, list or tuple for a table.
+    {"raw",                               pyobj2table_gil}, // convert dict, list or tuple for a table.
+    {"slice",                             pyobject_slice_gil},
+    {"asargs",                            py_asargs_gil},
+    {"askwargs",                          py_askwargs_gil},
+    {"readfile",                          py_readfile_gil},
     {NULL, NULL}
 };
 
 static struct luaL_reg lua_tag_methods[] = {
-    {"function", py_object_call},
-    {"gettable", py_object_index_get},
-    {"settable", py_object_index_set},
-    {"gc",       py_object_gc},
+    {"function", py_object_call_gil},
+    {"gettable", py_object_index_get_gil},
+    {"settable", py_object_index_set_gil},
+    {"gc",       py_object_gc_gil},
     {NULL, NULL}
 };
 
 
+// Id of the python table of each state (cached state data is checked by it)
+static int python_states = 0;
+
 /* Register module */
 LUA_API int luaopen_python(lua_State *L) {
     lua_Object python = lua_createtable(L);
 
     set_table_string(L, python, PY_UNICODE_ENCODING, "utf8");
     set_table_string(L, python, PY_UNICODE_ENCODING_ERRORHANDLER, "strict");
+    set_table_number(L, python, PY_UNICODE_CODEC, LUA_CODEC_UTF8);
+    set_table_number(L, python, PY_UNICODE_DECODING, 0); // lua strings as str
+    python_unicode_changed();  // new state (maybe at the address of a closed one)
     set_table_number(L, python, PY_OBJECT_BY_REFERENCE, 0);
     set_table_number(L, python, PY_API_IS_EMBEDDED, 0);  // If Python is inside Lua
     set_table_number(L, python, PY_LUA_TABLE_CONVERT, 0); // table convert ?
+    set_table_number(L, python, PY_LUA_TABLE_DEPTH, 0); // unlimited
+    set_table_number(L, python, PY_STATE_ID, ++python_states);
+    lregistry_open(L, python);  // references of the LuaObject (before the baseline)
+    lua_Object lkeys = lua_createtable(L);  // field names of the schemas (schema.c)
+    set_table_object(L, python, PY_SCHEMA_KEYS, lkeys);
 
-    lua_pushcfunction(L, py_args);
+    lua_pushcfunction(L, py_args_gil);
     lua_setglobal(L, PY_ARGS_FUNC);
 
-    lua_pushcfunction(L, py_kwargs);
+    lua_pushcfunction(L, py_kwargs_gil);
     lua_setglobal(L, PY_KWARGS_FUNC);
 
-    lua_pushcfunction(L, py_args_array);
+    lua_pushcfunction(L, py_args_array_gil);
     lua_setglobal(L, PY_ARGS_ARRAY_FUNC);
 
     lua_pushobject(L, python);
@@ -0,0 +1,252 @@
+//
+// Created by alex on 19/10/2026.
+//
+// Reset of a state to the baseline recorded after its initialization,
+// allowing it to be reused by a new interpreter (no lua_open, no libs).
+
+#include <Python.h>
+#include <lua.h>
+#include <string.h>
+
+#include "lshared.h"
+#include "utils.h"
+#include "constants.h"
+#include "recycle.h"
+
+#define BASELINE_GLOBALS "globals"
+#define BASELINE_PYTHON "python"
+#define BASELINE_TAGS "tags"
+#define BASELINE_LAST_TAG "last_tag"
+
+static char *tag_events[] = {
+    "gettable", "settable", "index", "getglobal", "setglobal", "add", "sub",
+    "mul", "div", "pow", "unm", "lt", "le", "gt", "ge", "concat", "gc", "function",
+    NULL
+};
+
+typedef struct {
+    lua_State *L;
+    int baseline;
+    char *argv;
+} recycled_state;
+
+static recycled_state recycled[LUA_RECYCLE_SIZE];
+static int nrecycled = 0;
+
+/* rawget with a string key */
+static lua_Object get_table_object(lua_State *L, lua_Object ltable, char *name) {
+    lua_pushobject(L, ltable);
+    lua_pushstring(L, name);
+    return lua_rawgettable(L);
+}
+
+/* Copies all the fields of a table (shallow) */
+static void table_copy(lua_State *L, lua_Object dst, lua_Object src) {
+    int index = 0;
+    while ((index = lua_next(L, src, index)) > 0) {
+        lua_beginblock(L);
+        lua_Object key = lua_getparam(L, 1);
+        lua_Object value = lua_getparam(L, 2);
+        lua_pushobject(L, dst);
+        lua_pushobject(L, key);
+        lua_pushobject(L, value);
+        lua_rawsettable(L);
+        lua_endblock(L);
+    }
+}
+
+/* Recording of the baseline (called protected by lua_callfunction) */
+static void baseline_record(lua_State *L) {
+    lua_Object baseline = lua_createtable(L);
+    lua_Object globals = lua_createtable(L);
+    lua_Object python = lua_createtable(L);
+    lua_Object tags = lua_createtable(L);
+    char *name = NULL;
+    int tag, index;
+
+    while ((name = lua_nextvar(L, name))) {
+        lua_beginblock(L);
+        lua_Object value = lua_getresult(L, 2);
+        set_table_object(L, globals, name, value);
+        lua_endblock(L);
+    }
+    table_copy(L, python, lua_getglobal(L, PY_API_NAME));
+
+    // tag methods of all the existing tags (0 .. last_tag)
+    for (tag = 0; tag >= L->last_tag; tag--) {
+        lua_Object methods = lua_createtable(L);
+        for (index = 0; tag_events[index]; index++) {
+            lua_beginblock(L);
+            lua_Object method = lua_gettagmethod(L, tag, tag_events[index]);
+            set_table_object(L, methods, tag_events[index], method);
+            lua_endblock(L);
+        }
+        lua_pushobject(L, tags);
+        lua_pushnumber(L, -tag);
+        lua_pushobject(L, methods);
+        lua_rawsettable(L);
+    }
+    set_table_object(L, baseline, BASELINE_GLOBALS, globals);
+    set_table_object(L, baseline, BASELINE_PYTHON, python);
+    set_table_object(L, baseline, BASELINE_TAGS, tags);
+    set_table_number(L, baseline, BASELINE_LAST_TAG, L->last_tag);
+    lua_pushobject(L, baseline);
+}
+
+/* Restore of the baseline (called protected by lua_callfunction) */
+static void baseline_restore(lua_State *L) {
+    lua_Object baseline = lua_getparam(L, 1);
+    lua_Object globals = get_table_object(L, baseline, BASELINE_GLOBALS);
+    lua_Object python, removed = lua_createtable(L);
+    char *name = NULL;
+    int tag, last_tag, index;
+
+    // globals created after the baseline (removed only after the traversal)
+    while ((name = lua_nextvar(L, name))) {
+        lua_beginblock(L);
+        if (lua_isnil(L, get_table_object(L, globals, name))) {
+            set_table_number(L, removed, name, 1);
+        }
+        lua_endblock(L);
+    }
+    index = 0;
+    while ((index = lua_next(L, removed, index)) > 0) {
+        lua_beginblock(L);
+        lua_pushnil(L);
+        lua_rawsetglobal(L, lua_getstring(L, lua_getparam(L, 1)));
+        lua_endblock(L);
+    }
+    index = 0;
+    while ((index = lua_next(L, globals, index)) > 0) {
+        lua_beginblock(L);
+        lua_pushobject(L, lua_getparam(L, 2));
+        lua_rawsetglobal(L, lua_getstring(L, lua_getparam(L, 1)));
+        lua_endblock(L);
+    }
+
+    // python api (restored in place: the C side always looks it up by name)
+    python = lua_getglobal(L, PY_API_NAME);
+    if (lua_istable(L, python)) {
+        lua_Object snapshot = get_table_object(L, baseline, BASELINE_PYTHON);
+        index = 0;
+        while ((index = lua_next(L, python, index)) > 0) {
+            lua_beginblock(L);
+            lua_Object key = lua_getparam(L, 1);
+            lua_pushobject(L, snapshot);
+            lua_pushobject(L, key);
+            if (lua_isnil(L, lua_rawgettable(L))) {
+                lua_pushobject(L, python);
+                lua_pushobject(L, key);
+                lua_pushnil(L);
+                lua_rawsettable(L);
+            }
+            lua_endblock(L);
+        }
+        table_copy(L, python, snapshot);
+    }
+
+    // tag methods (tags created after the baseline can not be removed)
+    lua_Object tags = get_table_object(L, baseline, BASELINE_TAGS);
+    last_tag = (int) lua_getnumber(L, get_table_object(L, baseline, BASELINE_LAST_TAG));
+    for (tag = 0; tag >= last_tag; tag--) {
+        lua_beginblock(L);
+        lua_pushobject(L, tags);
+        lua_pushnumber(L, -tag);
+        lua_Object methods = lua_rawgettable(L);
+        for (index = 0; tag_events[index]; index++) {
+            lua_Object method = get_table_object(L, methods, tag_events[index]);
+            if (!lua_isnil(L, method) || !lua_isnil(L, lua_gettagmethod(L, tag, tag_events[index]))) {
+                lua_pushobject(L, method);
+                lua_settagmethod(L, tag, tag_events[index]);
+            }
+        }
+        lua_endblock(L);
+    }
+#ifdef CGILUA_ENV
+    L->gbreak = 0;
+#endif
+    lua_collectgarbage(L, 0);
+}
+
+/**
+ * Records globals, python api and tag methods of the state.
+ * Returns the reference of the baseline (-1 on error).
+**/
+int lua_baseline_record(lua_State *L) {
+    int ref = -1;
+    lua_beginblock(L);
+    lua_pushcfunction(L, baseline_record);
+    if (lua_callfunction(L, lua_pop(L)) == 0) {
+        lua_pushobject(L, lua_getresult(L, 1));
+        ref = lua_ref(L, 1);
+    }
+    lua_endblock(L);
+    return ref;
+}
+
+/**
+ * Restores the state to the baseline.
+ * Live references (LuaObject) are kept: they belong to its python objects.
+ * Returns zero on success.
+**/
+int lua_baseline_restore(lua_State *L, int baseline) {
+    int status = 1;
+    lua_beginblock(L);
+    lua_Object lobj = lua_getref(L, baseline);
+    if (lua_istable(L, lobj)) {
+        lua_pushcfunction(L, baseline_restore);
+        lua_Object fn = lua_pop(L);
+        lua_pushobject(L, lobj);
+        status = lua_callfunction(L, fn);
+    }
+    lua_endblock(L);
+    python_unicode_changed();  // settings of the baseline
+    return status;
+}
+
+static bool argv_equals(const char *a, const char *b) {
+    return a == b || (a && b && strcmp(a, b) == 0);
+}
+
+/**
+ * Takes a recycled state (created with the same setup argv).
+ * Returns NULL when there is none.
+**/
+lua_State *lua_recycled_take(const char *argv, int *baseline) {
+    int index;
+    for (index = nrecycled - 1; index >= 0; index--) {
+        if (argv_equals(recycled[index].argv, argv)) {
+            lua_State *L = recycled[index].L;
+            *baseline = recycled[index].baseline;
+            free(recycled[index].argv);
+            recycled[index] = recycled[--nrecycled];
+            return L;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Restores the state and keeps it for reuse.
+ * Returns false when it should be closed (full or failed reset).
+**/
+bool lua_recycled_put(lua_State *L, const char *argv, int baseline) {
+    if (nrecycled == LUA_RECYCLE_SIZE || lua_baseline_restore(L, baseline) != 0)
+        return false;
+    recycled[nrecycled].L = L;
+    recycled[nrecycled].baseline = baseline;
+    recycled[nrecycled].argv = argv ? strdup(argv) : NULL;
+    nrecycled++;
+    return true;
+}
+
+/* Closes all recycled states. Returns how many were closed. */
+int lua_recycled_clear(void) {
+    int count = nrecycled;
+    while (nrecycled > 0) {
+        nrecycled--;
+        lua_close(recycled[nrecycled].L);
+        free(recycled[nrecycled].argv);
+    }
+    return count;
+}
@@ -0,0 +1,21 @@
+//
+// Created by alex on 19/10/2026.
+//
+
+#ifndef LUNATIC_RECYCLE_H
+#define LUNATIC_RECYCLE_H
+
+#include <lua.h>
+#include <stdbool.h>
+
+// Maximum number of states kept for reuse
+#define LUA_RECYCLE_SIZE 16
+
+int lua_baseline_record(lua_State *L);
+int lua_baseline_restore(lua_State *L, int baseline);
+
+lua_State *lua_recycled_take(const char *argv, int *baseline);
+bool lua_recycled_put(lua_State *L, const char *argv, int baseline);
+int lua_recycled_clear(void);
+
+#endif //LUNATIC_RECYCLE_H
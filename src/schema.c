@@ -0,0 +1,479 @@
+//
+// Created by alex on 19/10/2026.
+//
+#include <Python.h>
+#include <structmember.h>
+#include <lua.h>
+#include <lauxlib.h>
+#include <lstring.h>
+
+#if defined(_WIN32)
+#include "lapi.h"
+#else
+#include "lshared.h"
+#endif
+
+#include "schema.h"
+#include "luaconv.h"
+#include "pyconv.h"
+#include "pydispatch.h"
+#include "owner.h"
+#include "lregistry.h"
+#include "utils.h"
+#include "constants.h"
+
+/* Interned name of the field (str) */
+static PyObject *schema_name(PyObject *name) {
+#if PY_MAJOR_VERSION < 3
+    if (PyUnicode_Check(name)) {
+        name = PyUnicode_AsUTF8String(name);
+    } else if (PyString_Check(name)) {
+        Py_INCREF(name);
+    } else {
+        PyErr_SetString(PyExc_TypeError, "field names must be strings");
+        return NULL;
+    }
+    if (name) PyString_InternInPlace(&name);
+#else
+    if (!PyUnicode_Check(name)) {
+        PyErr_SetString(PyExc_TypeError, "field names must be strings");
+        return NULL;
+    }
+    Py_INCREF(name);
+    PyUnicode_InternInPlace(&name);
+#endif
+    return name;
+}
+
+/* Position in the namedtuple or slot offset (-1 generic attribute) of each field */
+static int schema_offsets(SchemaObject *schema) {
+    Py_ssize_t index, count = PyTuple_GET_SIZE(schema->fields);
+    PyObject *names = NULL;
+    if (schema->kind == SCHEMA_TUPLE) {
+        if (!(names = PyObject_GetAttrString((PyObject *) schema->cls, "_fields")))
+            return -1;
+        if ((schema->size = PySequence_Size(names)) < 0) {
+            Py_DECREF(names);
+            return -1;
+        }
+    }
+    for (index = 0; index < count; index++) {
+        PyObject *name = PyTuple_GET_ITEM(schema->fields, index);
+        if (names) {
+            if ((schema->offsets[index] = PySequence_Index(names, name)) < 0) {
+                Py_DECREF(names);
+                return -1;
+            }
+        } else if (schema->kind == SCHEMA_ATTR) {
+            PyObject *descr = _PyType_Lookup(schema->cls, name);
+            schema->offsets[index] = -1;
+            if (descr && Py_TYPE(descr) == &PyMemberDescr_Type &&
+                ((PyMemberDescrObject *) descr)->d_member->type == T_OBJECT_EX)
+                schema->offsets[index] = ((PyMemberDescrObject *) descr)->d_member->offset;
+        }
+    }
+    Py_XDECREF(names);
+    return 0;
+}
+
+/**
+ * Compiles the schema of the records of the class with the fields (sequence of names).
+ * namedtuples are read by position, dicts by key and the other objects by
+ * attribute (__slots__ by offset).
+ **/
+PyObject *Schema_New(PyTypeObject *cls, PyObject *fields, InterpreterObject *interpreter) {
+    PyObject *names = PySequence_Tuple(fields);
+    Py_ssize_t index, count;
+    if (!names)
+        return NULL;
+    count = PyTuple_GET_SIZE(names);
+    for (index = 0; index < count; index++) {
+        PyObject *name = schema_name(PyTuple_GET_ITEM(names, index));
+        if (!name) {
+            Py_DECREF(names);
+            return NULL;
+        }
+        Py_DECREF(PyTuple_GET_ITEM(names, index));
+        PyTuple_SET_ITEM(names, index, name);
+    }
+    SchemaObject *schema = PyObject_New(SchemaObject, &SchemaObject_Type);
+    if (!schema) {
+        Py_DECREF(names);
+        return NULL;
+    }
+    Py_INCREF(cls);
+    schema->cls = cls;
+    schema->fields = names;
+    schema->size = 0;
+    schema->L = NULL;
+    schema->state = 0;
+    schema->interpreter = NULL;  // weak: the global converters do not keep the state alive
+    schema->offsets = malloc((size_t) (count ? count : 1) * sizeof(Py_ssize_t));
+    schema->keys = calloc((size_t) (count ? count : 1), sizeof(TaggedString *));
+    if (PyType_IsSubtype(cls, &PyDict_Type)) {
+        schema->kind = SCHEMA_DICT;
+    } else if (PyType_IsSubtype(cls, &PyTuple_Type) &&
+               PyObject_HasAttrString((PyObject *) cls, "_fields")) {
+        schema->kind = SCHEMA_TUPLE;
+    } else {
+        schema->kind = SCHEMA_ATTR;
+    }
+    if (!schema->offsets || !schema->keys) {
+        Py_DECREF(schema);
+        return PyErr_NoMemory();
+    } else if (interpreter && !(schema->interpreter = PyWeakref_NewRef((PyObject *) interpreter, NULL))) {
+        Py_DECREF(schema);
+        return NULL;
+    } else if (schema_offsets(schema) != 0) {
+        Py_DECREF(schema);
+        return NULL;
+    }
+    return (PyObject *) schema;
+}
+
+/* Converts the records of the class by the schema (python.dict records only explicitly) */
+int schema_register(SchemaObject *schema) {
+    if (schema->cls == &PyDict_Type)
+        return 0;
+    return py_dispatch_register((PyObject *) schema->cls, (PyObject *) schema);
+}
+
+/* Table of the field names in the api python (python._schema_keys) */
+static Hash *schema_anchor(lua_State *L) {
+    TObject *python = &luaS_new(L, PY_API_NAME)->u.s.globalval, key, *anchor;
+    if (ttype(python) != LUA_T_ARRAY)
+        return NULL;
+    ttype(&key) = LUA_T_STRING;
+    tsvalue(&key) = luaS_new(L, PY_SCHEMA_KEYS);
+    anchor = luaH_get(L, avalue(python), &key);
+    return ttype(anchor) == LUA_T_ARRAY ? avalue(anchor) : NULL;
+}
+
+/**
+ * Lua keys of the fields in the state (state: its PY_STATE_ID, read once by the caller).
+ * The strings are kept by python._schema_keys (shared by the schemas, freed with
+ * the state), so switching between states only looks them up again.
+ * Returns -1 with the Python error set.
+ **/
+int schema_keys(SchemaObject *schema, lua_State *L, int state) {
+    Py_ssize_t index, count = PyTuple_GET_SIZE(schema->fields);
+    if (schema->L == L && schema->state == state)
+        return 0;
+    Hash *anchor = schema_anchor(L);
+    if (!anchor) {
+        PyErr_SetString(PyExc_RuntimeError, "lost table of the schema keys");
+        return -1;
+    }
+    TObject key, value;
+    ttype(&key) = LUA_T_STRING;
+    ttype(&value) = LUA_T_NUMBER;
+    nvalue(&value) = 1;
+    for (index = 0; index < count; index++) {
+        PyObject *name = PyTuple_GET_ITEM(schema->fields, index);
+#if PY_MAJOR_VERSION < 3
+        char *s = PyString_AS_STRING(name);
+        Py_ssize_t len = PyString_GET_SIZE(name);
+#else
+        Py_ssize_t len;
+        char *s = (char *) PyUnicode_AsUTF8AndSize(name, &len);
+        if (!s) return -1;
+#endif
+        tsvalue(&key) = luaS_newlstr(L, s, len);
+        *luaH_set(L, anchor, &key) = value;
+        schema->keys[index] = tsvalue(&key);
+    }
+    schema->L = L;
+    schema->state = state;
+    return 0;
+}
+
+/* The record has the shape of the schema (the fields are read without checks) */
+int schema_check(SchemaObject *schema, PyObject *record) {
+    bool valid;
+    switch (schema->kind) {
+        case SCHEMA_TUPLE:
+            valid = PyTuple_Check(record) && PyTuple_GET_SIZE(record) >= schema->size;
+            break;
+        case SCHEMA_DICT:
+            valid = PyDict_Check(record);
+            break;
+        default:
+            valid = PyObject_TypeCheck(record, schema->cls);
+    }
+    if (!valid)
+        PyErr_Format(PyExc_TypeError, "record of \"%.200s\" expected (got \"%.200s\")",
+                     schema->cls->tp_name, Py_TYPE(record)->tp_name);
+    return valid ? 0 : -1;
+}
+
+/* Value of the field of the record (checked) or None (missing) */
+PyObject *schema_field(SchemaObject *schema, PyObject *record, Py_ssize_t index) {
+    Py_ssize_t offset = schema->offsets[index];
+    PyObject *value;
+    switch (schema->kind) {
+        case SCHEMA_TUPLE:
+            value = PyTuple_GET_ITEM(record, offset);
+            break;
+        case SCHEMA_DICT:
+            value = PyDict_GetItem(record, PyTuple_GET_ITEM(schema->fields, index));
+            break;
+        default:
+            if (offset < 0)
+                return PyObject_GetAttr(record, PyTuple_GET_ITEM(schema->fields, index));
+            value = *(PyObject **) ((char *) record + offset);
+    }
+    if (!value)
+        value = Py_None;
+    Py_INCREF(value);
+    return value;
+}
+
+/* Values of the fields in the table of the LuaObject */
+static PyObject *Schema_lua_values(SchemaObject *self, LuaObject *table) {
+    LUA_OWNER_CALL(table->interpreter, Schema_lua_values, self, table, NULL);
+    Py_ssize_t index, count = PyTuple_GET_SIZE(self->fields);
+    PyObject *values = NULL;
+    LUA_STATE_ACQUIRE(table->interpreter);
+    lua_State *L = table->interpreter->L;
+    lua_beginblock(L);
+    lua_Object lobj = lregistry_get(L, table->ref);
+    if (!lua_istable(L, lobj)) {
+        PyErr_SetString(PyExc_TypeError, "table expected");
+    } else if (schema_keys(self, L, python_getnumber(L, PY_STATE_ID)) == 0 &&
+               (values = PyTuple_New(count))) {
+        Hash *hash = avalue(lapi_address(L, lobj));
+        TObject key;
+        ttype(&key) = LUA_T_STRING;
+        for (index = 0; index < count; index++) {
+            tsvalue(&key) = self->keys[index];
+            PyObject *value = lua_interpreter_tobject_convert(table->interpreter, luaH_get(L, hash, &key));
+            if (!value) {
+                Py_CLEAR(values);
+                break;
+            }
+            PyTuple_SET_ITEM(values, index, value);
+        }
+    }
+    lua_endblock(L);
+    LUA_STATE_RELEASE(table->interpreter);
+    return values;
+}
+
+/* Values of the fields in a mapping (missing keys as None) */
+static PyObject *Schema_mapping_values(SchemaObject *self, PyObject *mapping) {
+    Py_ssize_t index, count = PyTuple_GET_SIZE(self->fields);
+    PyObject *values = PyTuple_New(count);
+    for (index = 0; values && index < count; index++) {
+        PyObject *value = PyObject_GetItem(mapping, PyTuple_GET_ITEM(self->fields, index));
+        if (!value && PyErr_ExceptionMatches(PyExc_KeyError)) {
+            PyErr_Clear();
+            Py_INCREF(Py_None);
+            value = Py_None;
+        }
+        if (!value) {
+            Py_CLEAR(values);
+        } else {
+            PyTuple_SET_ITEM(values, index, value);
+        }
+    }
+    return values;
+}
+
+/* Creates the record of the class with the values of the fields */
+static PyObject *Schema_build(SchemaObject *self, PyObject *values) {
+    Py_ssize_t index, count = PyTuple_GET_SIZE(self->fields);
+    PyObject *record, *args;
+    switch (self->kind) {
+        case SCHEMA_TUPLE: {
+            PyObject *items = PyTuple_New(self->size);
+            if (!items)
+                return NULL;
+            for (index = 0; index < self->size; index++) {
+                Py_INCREF(Py_None);
+                PyTuple_SET_ITEM(items, index, Py_None);
+            }
+            for (index = 0; index < count; index++) {
+                PyObject *value = PyTuple_GET_ITEM(values, index);
+                Py_INCREF(value);
+                Py_DECREF(PyTuple_GET_ITEM(items, self->offsets[index]));
+                PyTuple_SET_ITEM(items, self->offsets[index], value);
+            }
+            args = PyTuple_Pack(1, items);  // tuple.__new__(cls, items) as namedtuple._make
+            Py_DECREF(items);
+            if (!args)
+                return NULL;
+            record = PyTuple_Type.tp_new(self->cls, args, NULL);
+            Py_DECREF(args);
+            return record;
+        }
+        case SCHEMA_DICT:
+            record = self->cls == &PyDict_Type ? PyDict_New() :
+                     PyObject_CallObject((PyObject *) self->cls, NULL);
+            for (index = 0; record && index < count; index++) {
+                if (PyObject_SetItem(record, PyTuple_GET_ITEM(self->fields, index),
+                                     PyTuple_GET_ITEM(values, index)) != 0)
+                    Py_CLEAR(record);
+            }
+            return record;
+        default:
+            if (!(args = PyTuple_New(0)))
+                return NULL;
+            record = self->cls->tp_new(self->cls, args, NULL);
+            Py_DECREF(args);
+            for (index = 0; record && index < count; index++) {
+                PyObject *value = PyTuple_GET_ITEM(values, index);
+                if (self->offsets[index] >= 0 && PyObject_TypeCheck(record, self->cls)) {
+                    PyObject **slot = (PyObject **) ((char *) record + self->offsets[index]);
+                    PyObject *old = *slot;
+                    Py_INCREF(value);
+                    *slot = value;
+                    Py_XDECREF(old);
+                } else if (PyObject_SetAttr(record, PyTuple_GET_ITEM(self->fields, index), value) != 0) {
+                    Py_CLEAR(record);
+                }
+            }
+            return record;
+    }
+}
+
+/* schema(table): record of the table (LuaObject) or mapping */
+static PyObject *Schema_call(SchemaObject *self, PyObject *args, PyObject *kwargs) {
+    PyObject *table, *values, *record;
+    if (!PyArg_ParseTuple(args, "O:Schema", &table))
+        return NULL;
+    if (LuaObject_Check(table)) {
+        values = Schema_lua_values(self, (LuaObject *) table);
+    } else {
+        values = Schema_mapping_values(self, table);
+    }
+    if (!values)
+        return NULL;
+    record = Schema_build(self, values);
+    Py_DECREF(values);
+    return record;
+}
+
+/* Schema.to_lua in the state of the interpreter (kept by the caller) */
+static PyObject *Schema_to_lua_state(SchemaObject *self, PyObject *record, InterpreterObject *interpreter) {
+    PyObject *ret = NULL;
+    LUA_OWNER_CALL(interpreter, Schema_to_lua_state, self, record, interpreter);
+    LUA_STATE_ACQUIRE(interpreter);
+    lua_beginblock(interpreter->L);
+    lua_Object ltable = py_schema_table(interpreter->L, record, (PyObject *) self);
+    if (ltable != LUA_NOOBJECT)
+        ret = LuaObject_New(interpreter, ltable);
+    lua_endblock(interpreter->L);
+    LUA_STATE_RELEASE(interpreter);
+    return ret;
+}
+
+static PyObject *Schema_to_lua(SchemaObject *self, PyObject *record) {
+    PyObject *interpreter, *ret;
+    if (!self->interpreter) {
+        PyErr_SetString(PyExc_TypeError, "schema without interpreter (see Interpreter.schema)");
+        return NULL;
+    }
+    interpreter = PyWeakref_GET_OBJECT(self->interpreter);
+    if (interpreter == Py_None) {
+        PyErr_SetString(PyExc_RuntimeError, "interpreter of the schema was released");
+        return NULL;
+    }
+    Py_INCREF(interpreter);
+    ret = Schema_to_lua_state(self, record, (InterpreterObject *) interpreter);
+    Py_DECREF(interpreter);
+    return ret;
+}
+
+static PyObject *Schema_repr(SchemaObject *self) {
+    PyObject *fields = PyObject_Repr(self->fields), *repr;
+    if (!fields)
+        return NULL;
+    repr = PyString_FromFormat("<Schema %s %s>", self->cls->tp_name, PyString_AsString(fields));
+    Py_DECREF(fields);
+    return repr;
+}
+
+static void Schema_dealloc(SchemaObject *self) {
+    // the keys stay in python._schema_keys of the states (shared by the schemas)
+    free(self->offsets);
+    free(self->keys);
+    Py_XDECREF(self->cls);
+    Py_XDECREF(self->fields);
+    Py_XDECREF(self->interpreter);
+    PyObject_Del(self);
+}
+
+static PyMethodDef Schema_methods[] = {
+    {"to_lua", (PyCFunction) Schema_to_lua, METH_O,
+     "Converts the record into a table (presized, keys created once)."},
+    {NULL, NULL}
+};
+
+static PyMemberDef Schema_members[] = {
+    {"fields", T_OBJECT, offsetof(SchemaObject, fields), READONLY, "names of the fields"},
+    {NULL}
+};
+
+PyTypeObject SchemaObject_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "lua.Schema",                               /* tp_name */
+    sizeof(SchemaObject),                       /* tp_basicsize */
+    0,                                          /* tp_itemsize */
+    (destructor) Schema_dealloc,                /* tp_dealloc */
+    0,                                          /* tp_print */
+    0,                                          /* tp_getattr */
+    0,                                          /* tp_setattr */
+    0,                                          /* tp_reserved */
+    (reprfunc) Schema_repr,                     /* tp_repr */
+    0,                                          /* tp_as_number */
+    0,                                          /* tp_as_sequence */
+    0,                                          /* tp_as_mapping */
+    0,                                          /* tp_hash */
+    (ternaryfunc) Schema_call,                  /* tp_call */
+    0,                                          /* tp_str */
+    PyObject_GenericGetAttr,                    /* tp_getattro */
+    0,                                          /* tp_setattro */
+    0,                                          /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                         /* tp_flags */
+    "Compiled converter of records (Interpreter.schema / python.schema)", /* tp_doc */
+    0,                                          /* tp_traverse */
+    0,                                          /* tp_clear */
+    0,                                          /* tp_richcompare */
+    0,                                          /* tp_weaklistoffset */
+    0,                                          /* tp_iter */
+    0,                                          /* tp_iternext */
+    Schema_methods,                             /* tp_methods */
+    Schema_members,                             /* tp_members */
+};
+
+/* python.schema(cls, {"a", "b"}): converts the records of the class by the schema */
+void py_schema(lua_State *L) {
+    lua_Object lcls = lua_getparam(L, 1), lfields = lua_getparam(L, 2);
+    if (!is_object_container(L, lcls) || !PyType_Check(get_pobject(L, lcls)))
+        luaL_argerror(L, 1, "python class expected");
+    luaL_arg_check(L, lua_istable(L, lfields), 2, "table of field names expected");
+    PyObject *cls = get_pobject(L, lcls), *fields = PyList_New(0), *name;
+    int index;
+    for (index = 1; fields; index++) {
+        lua_pushobject(L, lfields);
+        lua_pushnumber(L, index);
+        lua_Object lname = lua_rawgettable(L);
+        if (lua_isnil(L, lname)) {
+            break;
+        } else if (!lua_isstring(L, lname)) {
+            Py_DECREF(fields);
+            luaL_argerror(L, 2, "field names must be strings");
+        }
+        name = PyString_FromStringAndSize(lua_getstring(L, lname), lua_strlen(L, lname));
+        if (!name || PyList_Append(fields, name) != 0)
+            Py_CLEAR(fields);
+        Py_XDECREF(name);
+    }
+    PyObject *schema = fields ? Schema_New((PyTypeObject *) cls, fields, NULL) : NULL;
+    Py_XDECREF(fields);
+    if (!schema || schema_register((SchemaObject *) schema) != 0) {
+        Py_XDECREF(schema);
+        lua_new_error(L, "failed to create the schema");
+    }
+    push_pyobject_container(L, schema, false);
+}
@@ -0,0 +1,46 @@
+//
+// Created by alex on 19/10/2026.
+//
+// Record converters compiled from a fixed shape (namedtuple, __slots__ class,
+// dict with known keys): the Lua and Python keys are created once and the
+// fields are read by tuple position or slot offset.
+
+#ifndef LUNATIC_SCHEMA_H
+#define LUNATIC_SCHEMA_H
+
+#include <Python.h>
+#include <lua.h>
+#include "luainpython.h"
+
+typedef enum {
+    SCHEMA_ATTR = 0,  // attributes (slots by offset)
+    SCHEMA_TUPLE,     // namedtuple (by position)
+    SCHEMA_DICT       // dict (by key)
+} schema_kind;
+
+typedef struct {
+    PyObject_HEAD
+    PyTypeObject *cls;
+    PyObject *fields;          // tuple of the (interned) names
+    schema_kind kind;
+    Py_ssize_t *offsets;       // tuple position or slot offset (-1 getattr) of each field
+    Py_ssize_t size;           // items of the namedtuple
+    PyObject *interpreter;     // weakref of the Interpreter (Interpreter.schema, to_lua) or NULL
+    lua_State *L;              // state of the Lua keys
+    int state;                 // id of its python table
+    struct TaggedString **keys;
+} SchemaObject;
+
+extern PyTypeObject SchemaObject_Type;
+
+#define Schema_Check(op) PyObject_TypeCheck(op, &SchemaObject_Type)
+
+PyObject *Schema_New(PyTypeObject *cls, PyObject *fields, InterpreterObject *interpreter);
+int schema_register(SchemaObject *schema);
+int schema_keys(SchemaObject *schema, lua_State *L, int state);
+int schema_check(SchemaObject *schema, PyObject *record);
+PyObject *schema_field(SchemaObject *schema, PyObject *record, Py_ssize_t index);
+
+void py_schema(lua_State *L);
+
+#endif //LUNATIC_SCHEMA_H
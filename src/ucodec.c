@@ -0,0 +1,271 @@
+//
+// Created by alex on 19/10/2026.
+//
+// The scratch buffer is used with the GIL held.
+
+#include "ucodec.h"
+
+#include <ctype.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* Codec of the encoding name (case, '-' and '_' ignored as in the codec registry) */
+int ucodec_id(const char *encoding) {
+    char name[16];
+    size_t size = 0;
+    for (; *encoding && size < sizeof(name) - 1; encoding++) {
+        if (*encoding != '-' && *encoding != '_')
+            name[size++] = (char) tolower((unsigned char) *encoding);
+    }
+    name[size] = '\0';
+    if (*encoding) {
+        return LUA_CODEC_OTHER;
+    } else if (strcmp(name, "utf8") == 0 || strcmp(name, "u8") == 0) {
+        return LUA_CODEC_UTF8;
+    } else if (strcmp(name, "ascii") == 0 || strcmp(name, "usascii") == 0) {
+        return LUA_CODEC_ASCII;
+    } else if (strcmp(name, "latin1") == 0 || strcmp(name, "iso88591") == 0 ||
+               strcmp(name, "l1") == 0) {
+        return LUA_CODEC_LATIN1;
+    }
+    return LUA_CODEC_OTHER;
+}
+
+#if PY_MAJOR_VERSION < 3
+static char *scratch = NULL;
+static size_t scratch_size = 0;
+
+static char *ucodec_scratch(size_t size) {
+    if (size > scratch_size) {
+        char *buffer = realloc(scratch, size);
+        if (!buffer)
+            return NULL;
+        scratch = buffer;
+        scratch_size = size;
+    }
+    return scratch;
+}
+
+/* Releases the scratch buffer when it grew too much (big strings) */
+void ucodec_release(void) {
+    if (scratch_size > UCODEC_SCRATCH_MAX) {
+        free(scratch);
+        scratch = NULL;
+        scratch_size = 0;
+    }
+}
+
+/* Copies the initial ascii characters (8 per step with SSE2), returns how many */
+static Py_ssize_t ucodec_ascii_run(const Py_UNICODE *s, Py_ssize_t size, char *out) {
+    Py_ssize_t index = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+#if Py_UNICODE_SIZE == 4
+    const __m128i mask = _mm_set1_epi32(~0x7F);
+    for (; index + 8 <= size; index += 8) {
+        __m128i low = _mm_loadu_si128((const __m128i *) (s + index));
+        __m128i high = _mm_loadu_si128((const __m128i *) (s + index + 4));
+        __m128i bits = _mm_and_si128(_mm_or_si128(low, high), mask);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(bits, zero)) != 0xFFFF)
+            break;
+        __m128i words = _mm_packs_epi32(low, high);
+        _mm_storel_epi64((__m128i *) (out + index), _mm_packus_epi16(words, words));
+    }
+#else
+    const __m128i mask = _mm_set1_epi16((short) ~0x7F);
+    for (; index + 8 <= size; index += 8) {
+        __m128i words = _mm_loadu_si128((const __m128i *) (s + index));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(words, mask), zero)) != 0xFFFF)
+            break;
+        _mm_storel_epi64((__m128i *) (out + index), _mm_packus_epi16(words, words));
+    }
+#endif
+#endif
+    for (; index < size && (Py_UCS4) s[index] < 0x80; index++)
+        out[index] = (char) s[index];
+    return index;
+}
+
+/* utf-8 as the codec of Python 2 (surrogate pairs joined, lone surrogates encoded) */
+static Py_ssize_t ucodec_encode_utf8(const Py_UNICODE *s, Py_ssize_t size, char *out) {
+    Py_ssize_t index = 0, pos = 0;
+    while (index < size) {
+        Py_ssize_t count = ucodec_ascii_run(s + index, size - index, out + pos);
+        index += count;
+        pos += count;
+        if (index >= size)
+            break;
+        Py_UCS4 ch = (Py_UCS4) s[index++];
+        if (ch < 0x800) {
+            out[pos++] = (char) (0xC0 | (ch >> 6));
+            out[pos++] = (char) (0x80 | (ch & 0x3F));
+            continue;
+        }
+        if (ch >= 0xD800 && ch <= 0xDBFF && index < size &&
+            s[index] >= 0xDC00 && s[index] <= 0xDFFF) { // surrogate pair
+            ch = 0x10000 + ((ch - 0xD800) << 10) + (s[index++] - 0xDC00);
+        }
+        if (ch < 0x10000) {
+            out[pos++] = (char) (0xE0 | (ch >> 12));
+        } else {
+            out[pos++] = (char) (0xF0 | (ch >> 18));
+            out[pos++] = (char) (0x80 | ((ch >> 12) & 0x3F));
+        }
+        out[pos++] = (char) (0x80 | ((ch >> 6) & 0x3F));
+        out[pos++] = (char) (0x80 | (ch & 0x3F));
+    }
+    return pos;
+}
+
+/**
+ * Encodes the unicode in the scratch buffer (valid until the next call).
+ * Returns NULL when the codec registry is needed (other encodings, characters
+ * out of ascii / latin-1 or no memory).
+ **/
+char *ucodec_encode(int codec, PyObject *unicode, Py_ssize_t *len) {
+    const Py_UNICODE *s = PyUnicode_AS_UNICODE(unicode);
+    Py_ssize_t size = PyUnicode_GET_SIZE(unicode), index;
+    char *out;
+    switch (codec) {
+        case LUA_CODEC_UTF8:
+            if (!(out = ucodec_scratch((size_t) size * (Py_UNICODE_SIZE == 2 ? 3 : 4) + 1)))
+                return NULL;
+            *len = ucodec_encode_utf8(s, size, out);
+            return out;
+        case LUA_CODEC_ASCII:
+        case LUA_CODEC_LATIN1:
+            if (!(out = ucodec_scratch((size_t) size + 1)))
+                return NULL;
+            index = ucodec_ascii_run(s, size, out);
+            if (codec == LUA_CODEC_LATIN1) {
+                for (; index < size && (Py_UCS4) s[index] < 0x100; index++)
+                    out[index] = (char) s[index];
+            }
+            if (index < size)
+                return NULL;  // the error handler decides
+            *len = size;
+            return out;
+        default:
+            return NULL;
+    }
+}
+
+/* Length of the initial ascii bytes (16 per step with SSE2) */
+static Py_ssize_t ucodec_ascii_length(const char *s, Py_ssize_t size) {
+    Py_ssize_t index = 0;
+#if defined(__SSE2__)
+    for (; index + 16 <= size; index += 16) {
+        if (_mm_movemask_epi8(_mm_loadu_si128((const __m128i *) (s + index))) != 0)
+            break;
+    }
+#endif
+    for (; index < size && (unsigned char) s[index] < 0x80; index++);
+    return index;
+}
+
+/* Bytes as code points (ascii and latin-1) */
+static void ucodec_widen(const unsigned char *s, Py_ssize_t size, Py_UNICODE *out) {
+    Py_ssize_t index = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; index + 16 <= size; index += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i *) (s + index));
+        __m128i low = _mm_unpacklo_epi8(bytes, zero), high = _mm_unpackhi_epi8(bytes, zero);
+#if Py_UNICODE_SIZE == 4
+        _mm_storeu_si128((__m128i *) (out + index), _mm_unpacklo_epi16(low, zero));
+        _mm_storeu_si128((__m128i *) (out + index + 4), _mm_unpackhi_epi16(low, zero));
+        _mm_storeu_si128((__m128i *) (out + index + 8), _mm_unpacklo_epi16(high, zero));
+        _mm_storeu_si128((__m128i *) (out + index + 12), _mm_unpackhi_epi16(high, zero));
+#else
+        _mm_storeu_si128((__m128i *) (out + index), low);
+        _mm_storeu_si128((__m128i *) (out + index + 8), high);
+#endif
+    }
+#endif
+    for (; index < size; index++)
+        out[index] = s[index];
+}
+
+/* Decodes valid utf-8 (strict), returns the code units or -1 (invalid) */
+static Py_ssize_t ucodec_decode_utf8(const unsigned char *s, Py_ssize_t size, Py_UNICODE *out) {
+    Py_ssize_t index = 0, pos = 0;
+    while (index < size) {
+        Py_ssize_t count = ucodec_ascii_length((const char *) s + index, size - index);
+        ucodec_widen(s + index, count, out + pos);
+        index += count;
+        pos += count;
+        if (index >= size)
+            break;
+        Py_UCS4 ch = s[index], min;
+        int more;
+        if (ch >= 0xC2 && ch <= 0xDF) {
+            ch &= 0x1F, more = 1, min = 0x80;
+        } else if (ch >= 0xE0 && ch <= 0xEF) {
+            ch &= 0x0F, more = 2, min = 0x800;
+        } else if (ch >= 0xF0 && ch <= 0xF4) {
+            ch &= 0x07, more = 3, min = 0x10000;
+        } else {
+            return -1;
+        }
+        if (index + more >= size)
+            return -1;  // truncated
+        for (index++; more > 0; more--, index++) {
+            if ((s[index] & 0xC0) != 0x80)
+                return -1;
+            ch = (ch << 6) | (s[index] & 0x3F);
+        }
+        if (ch < min || ch > 0x10FFFF || (ch >= 0xD800 && ch <= 0xDFFF))
+            return -1;  // overlong, out of range or surrogate
+#if Py_UNICODE_SIZE == 2
+        if (ch >= 0x10000) {
+            ch -= 0x10000;
+            out[pos++] = (Py_UNICODE) (0xD800 + (ch >> 10));
+            ch = 0xDC00 + (ch & 0x3FF);
+        }
+#endif
+        out[pos++] = (Py_UNICODE) ch;
+    }
+    return pos;
+}
+
+/**
+ * Creates the unicode of the Lua string. The valid utf-8 (ascii, latin-1) is decoded
+ * here, the invalid data and the other encodings by the codec registry (error handler).
+ **/
+PyObject *ucodec_decode(int codec, const char *encoding, const char *errors,
+                        const char *s, Py_ssize_t size) {
+    PyObject *unicode;
+    Py_ssize_t length;
+    switch (codec) {
+        case LUA_CODEC_UTF8:
+            if (!(unicode = PyUnicode_FromUnicode(NULL, size)))
+                return NULL;
+            length = ucodec_decode_utf8((const unsigned char *) s, size, PyUnicode_AS_UNICODE(unicode));
+            if (length < 0) {
+                Py_DECREF(unicode);
+                return PyUnicode_DecodeUTF8(s, size, errors);
+            }
+            if (length < size && PyUnicode_Resize(&unicode, length) != 0)
+                return NULL;
+            return unicode;
+        case LUA_CODEC_ASCII:
+            if (ucodec_ascii_length(s, size) < size)
+                return PyUnicode_DecodeASCII(s, size, errors);
+            // fall through: ascii is latin-1
+        case LUA_CODEC_LATIN1:
+            if (!(unicode = PyUnicode_FromUnicode(NULL, size)))
+                return NULL;
+            ucodec_widen((const unsigned char *) s, size, PyUnicode_AS_UNICODE(unicode));
+            return unicode;
+        default:
+            return PyUnicode_Decode(s, size, encoding, errors);
+    }
+}
+#else
+PyObject *ucodec_decode(int codec, const char *encoding, const char *errors,
+                        const char *s, Py_ssize_t size) {
+    return PyUnicode_Decode(s, size, encoding, errors);
+}
+#endif
@@ -0,0 +1,30 @@
+//
+// Created by alex on 19/10/2026.
+//
+// Unicode encoding / decoding with the codec resolved by set_unicode_encoding:
+// the utf-8 (and the ascii part of ascii / latin-1) is handled here, without
+// the codec registry and the temporary python string.
+
+#ifndef LUNATIC_UCODEC_H
+#define LUNATIC_UCODEC_H
+
+#include <Python.h>
+
+// Encodings handled by ucodec_encode (others use the codec registry)
+#define LUA_CODEC_OTHER 0
+#define LUA_CODEC_UTF8 1
+#define LUA_CODEC_ASCII 2
+#define LUA_CODEC_LATIN1 3
+
+// Scratch buffer kept between the conversions (bigger ones are released)
+#define UCODEC_SCRATCH_MAX (1 << 20)
+
+int ucodec_id(const char *encoding);
+#if PY_MAJOR_VERSION < 3
+char *ucodec_encode(int codec, PyObject *unicode, Py_ssize_t *len);
+void ucodec_release(void);
+#endif
+PyObject *ucodec_decode(int codec, const char *encoding, const char *errors,
+                        const char *s, Py_ssize_t size);
+
+#endif //LUNATIC_UCODEC_H
@@ -23,6 +23,39 @@ char *python_getstring(lua_State *L, char *name) {
     return lua_getstring(L, lua_rawgettable(L));
 }
 
+/* Settings of the last state read (used with the GIL held) */
+static struct {
+    lua_State *L;
+    unsigned long version;
+    python_unicode_settings settings;
+} unicode_cache = {NULL, 0};
+
+static unsigned long unicode_version = 1;
+
+/**
+ * Unicode settings of the state, read from the api python only when the state
+ * differs from the last one or the settings changed (string conversions).
+ * The strings belong to the python table.
+**/
+python_unicode_settings *python_unicode(lua_State *L) {
+    if (unicode_cache.L != L || unicode_cache.version != unicode_version) {
+        lua_beginblock(L);
+        unicode_cache.settings.codec = python_getnumber(L, PY_UNICODE_CODEC);
+        unicode_cache.settings.encoding = python_getstring(L, PY_UNICODE_ENCODING);
+        unicode_cache.settings.errors = python_getstring(L, PY_UNICODE_ENCODING_ERRORHANDLER);
+        unicode_cache.settings.decoding = python_getnumber(L, PY_UNICODE_DECODING);
+        lua_endblock(L);
+        unicode_cache.L = L;
+        unicode_cache.version = unicode_version;
+    }
+    return &unicode_cache.settings;
+}
+
+/* Invalidates the cached settings (setters, new, reset or closed states) */
+void python_unicode_changed(void) {
+    unicode_version++;
+}
+
 /* Stores the value in the given key in the API python */
 void python_setstring(lua_State *L, char *name, char *value) {
     set_table_string(L, lua_getglobal(L, PY_API_NAME), name, value);
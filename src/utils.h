@@ -66,6 +66,17 @@ void python_setnumber(lua_State *L, char *name, int value);
 int lua_tablesize(lua_State *L, lua_Object ltable);
 int python_api_tag(lua_State *L);
 
+/* Unicode settings of the api python (cached until python_unicode_changed) */
+typedef struct {
+    int codec;       // ucodec id of the encoding
+    char *encoding;
+    char *errors;
+    int decoding;    // Lua strings as unicode
+} python_unicode_settings;
+
+python_unicode_settings *python_unicode(lua_State *L);
+void python_unicode_changed(void);
+
 #ifndef strdup
 char *strdup(const char *s);
 #endif
@@ -148,6 +148,467 @@ def fn(interpreter, index):
     interpreter.require(os.path.join(PATH, "..", "lua", "test2.lua"))
 
 
+def pool_test():
+    with lua.InterpreterPool(2, "function square(n) return n * n end",
+                             args=(os.environ['BASE_DIR'],)) as pool:
+        futures = [pool.submit("square", (n,)) for n in range(10)]
+        assert [f.result() for f in futures] == [n * n for n in range(10)], "pool: call results error"
+        assert pool.submit("return {1, 2, 3}").result() == (1, 2, 3), "pool: table result error"
+    pool = lua.InterpreterPool(2, args=(os.environ['BASE_DIR'],))
+    future = pool.submit("return 7")
+    del pool  # without shutdown: the workers finish the job and stop
+    assert future.result() == 7, "pool: job of a released pool error"
+
+
+def recycle_test():
+    interpreter = lua.Interpreter(os.environ['BASE_DIR'], recycle=True)
+    interpreter.execute("REQUEST_VALUE = 1; python.request_value = 1")
+    interpreter.reset()
+    assert interpreter.eval("REQUEST_VALUE") is None, "reset: global not removed"
+    assert interpreter.eval("python.request_value") is None, "reset: python api not restored"
+    del interpreter
+    interpreter = lua.Interpreter(os.environ['BASE_DIR'], recycle=True)  # recycled state
+    assert interpreter.eval("python.get_version()"), "recycled state: python api error"
+    del interpreter
+    assert lua.clear_recycled() == 1, "recycled state not kept"
+
+
+def bytecode_cache_test():
+    import shutil
+    import subprocess
+    import tempfile
+    from distutils.spawn import find_executable
+    if not find_executable("luac"):
+        print 'bytecode cache test skipped (luac not found)'
+        return
+    version = subprocess.Popen(["luac", "-v"], stdout=subprocess.PIPE, stderr=subprocess.STDOUT).communicate()[0]
+    cache = tempfile.mkdtemp()
+    lua.set_bytecode_cache(cache)
+    try:
+        count = lua.prewarm_bytecode_cache(os.path.join(PATH, "..", "lua"))
+        chunks = [name for name in os.listdir(cache) if name.endswith(".luac")]
+        if "Lua 3.2" in version:
+            assert count > 0 and count == len(chunks), "bytecode cache: chunks count error"
+        else:  # other luac (Lua 5.x): the sources are loaded
+            assert count == 0 and not chunks, "bytecode cache: chunk of another Lua version kept"
+        interpreter = lua.Interpreter(os.environ['BASE_DIR'])
+        interpreter.require(os.path.join(PATH, "..", "lua", "test2.lua"))
+    finally:
+        lua.set_bytecode_cache(None)
+        shutil.rmtree(cache)
+
+
+def async_test():
+    interpreter = lua.Interpreter(os.environ['BASE_DIR'])
+    interpreter.execute("calls = {}; function push(n) tinsert(calls, n) return getn(calls) end")
+    futures = [interpreter.call_async("push", n) for n in range(10)]
+    assert [f.result() for f in futures] == list(range(1, 11)), "async: calls out of order"
+    assert interpreter.execute_async("return calls[10]").result() == 9, "async: execute result error"
+    assert interpreter.eval("getn(calls)") == 10, "async: state not shared"
+
+
+def owner_thread_test():
+    import threading
+    interpreter = lua.Interpreter(os.environ['BASE_DIR'], owner_thread=True)
+    counter = interpreter.eval("{value = 0}")
+    increment = interpreter.eval("function(t) t.value = t.value + 1 end")
+
+    def worker():
+        for _ in range(100):
+            increment(counter)
+
+    threads = [threading.Thread(target=worker) for _ in range(4)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    assert counter.value == 400, "owner thread: calls lost"
+
+
+def process_pool_test():
+    with lua.ProcessPool(2, "function stats(t) return getn(t), t[1] .. t[2] end",
+                         args=(os.environ['BASE_DIR'],)) as pool:
+        assert pool.call("stats", ["a", "b"]) == (2, "ab"), "process pool: call results error"
+        assert pool.execute("return {x = 1.5, y = {1, 2}}") == {"x": 1.5, "y": (1, 2)}, \
+            "process pool: table result error"
+        futures = [pool.submit("return %d * 2" % n) for n in range(10)]
+        assert [f.result() for f in futures] == [n * 2 for n in range(10)], "process pool: submit error"
+
+
+def views_test():
+    interpreter = lua.Interpreter(os.environ['BASE_DIR'])
+    array = interpreter.eval("{10, 20, 30}")
+    assert list(array.items()) == [(1, 10), (2, 20), (3, 30)], "views: array not in index order"
+    table = interpreter.eval("{a = 1, b = 2}")
+    assert sorted(table.keys()) == ["a", "b"] and sorted(table.values()) == [1, 2], "views: hash error"
+    assert len(table.keys()) == 2 and len(interpreter.eval("{1, n = 5}").items()) == 2, "views: hash length error"
+    interpreter.execute("large = {} local i = 1 while i <= 1000 do large[i] = i i = i + 1 end")
+    large = interpreter.eval("large")
+    assert sum(large.values()) == 500500 and len(large.keys()) == 1000, "views: chunks error"
+
+
+def to_python_test():
+    interpreter = lua.Interpreter(os.environ['BASE_DIR'])
+    interpreter.execute("shared = {1, 2}; config = {a = shared, b = shared, c = {d = {e = 1}}}; config.self = config")
+    config = interpreter.eval("config").to_python()
+    assert config["a"] is config["b"] and config["a"] == (1, 2), "to_python: shared table error"
+    assert config["self"] is config, "to_python: cyclic table error"
+    assert config["c"]["d"] == {"e": 1}, "to_python: nested table error"
+    shallow = interpreter.eval("config").to_python(deep=False)
+    assert isinstance(shallow["c"], lua.LuaObject), "to_python: max depth error"
+
+
+def to_lua_test():
+    interpreter = lua.Interpreter(os.environ['BASE_DIR'])
+    rows = [1, 2.5, u"three"]
+    data = {"a": rows, "b": rows, "name": "lunatic"}
+    data["self"] = data
+    table = interpreter.to_lua(data)
+    assert table["a"][3] == "three" and table["name"] == "lunatic", "to_lua: values error"
+    check = interpreter.eval("function(t) return t.self == t and t.a == t.b end")
+    assert check(table) == 1, "to_lua: shared/cyclic containers error"
+
+
+def converters_test():
+    import collections
+    import decimal
+    Point = collections.namedtuple("Point", "x y")
+    lua.register_converter(decimal.Decimal, float)
+    lua.register_converter(Point, lambda point: point._asdict())
+
+    class Ping(object):
+        pass
+
+    class Pong(object):
+        pass
+
+    lua.register_converter(Ping, lambda ping: Pong())
+    lua.register_converter(Pong, lambda pong: Ping())
+    try:
+        interpreter = lua.Interpreter(os.environ['BASE_DIR'])
+        check = interpreter.eval("function(n, p) return n + p.x + p.y end")
+        assert check(decimal.Decimal("1.5"), Point(1, 2)) == 4.5, "converters: result error"
+        identity = interpreter.eval("function(o) return o end")
+        assert isinstance(identity(Ping()), Pong), "converters: result converted again"
+        assert identity(2 ** 40) == 2 ** 40 == interpreter.to_lua([2 ** 40])[1], "converters: long error"
+    finally:
+        lua.register_converter(decimal.Decimal, None)
+        lua.register_converter(Point, None)
+        lua.register_converter(Ping, None)
+        lua.register_converter(Pong, None)
+
+
+def unicode_encoding_test():
+    interpreter = lua.Interpreter(os.environ['BASE_DIR'])
+    identity = interpreter.eval("function(s) return s end")
+    text = u"ascii run " * 4 + u"caf\xe9 \u20ac \U0001f600"
+    assert identity(text) == text.encode("utf-8"), "unicode: utf-8 bytes error"
+    interpreter.execute("python.set_unicode_encoding('latin-1')")
+    assert identity(u"caf\xe9") == "caf\xe9", "unicode: latin-1 bytes error"
+
+
+def unicode_decoding_test():
+    interpreter = lua.Interpreter(os.environ['BASE_DIR'], unicode_decoding=True)
+    identity = interpreter.eval("function(s) return s end")
+    assert identity(u"caf\xe9 \u20ac") == u"caf\xe9 \u20ac", "unicode decoding: value error"
+    table = interpreter.eval("{name = 'lunatic'}").to_python()
+    assert all(isinstance(item, unicode) for item in table.items()[0]), "unicode decoding: table error"
+    interpreter.reset()
+    assert isinstance(identity(u"x"), unicode), "unicode decoding: mode lost by reset"
+    interpreter.execute("python.set_unicode_decoding(0)")
+    assert isinstance(identity(u"x"), str), "unicode decoding: not disabled by zero"
+
+
+def array_test():
+    import struct
+    interpreter = lua.Interpreter(os.environ['BASE_DIR'])
+    interpreter.execute("squares = python.array(4) local i = 1 while i <= squares.n do squares[i] = i * i i = i + 1 end")
+    squares = interpreter.eval("squares")
+    view = memoryview(squares)
+    assert struct.unpack(view.format * len(squares), view.tobytes()) == (1, 4, 9, 16), "array: buffer error"
+    counts = lua.LuaArray(3, 'i')
+    interpreter.eval("function(a) a[2] = 7 return a[2] + a.n end")(counts)
+    assert counts[1] == 7 and memoryview(counts).format == 'i', "array: shared buffer error"
+    for value in (7.9, 2 ** 40):
+        try:
+            interpreter.eval("function(a, v) a[1] = v end")(counts, value)
+            assert False, "array: invalid integer stored by lua"
+        except RuntimeError:
+            pass
+    for value, error in ((7.9, TypeError), (2 ** 40, OverflowError)):
+        try:
+            counts[0] = value
+            assert False, "array: invalid integer stored"
+        except error:
+            pass
+
+
+def numeric_array_test():
+    import array
+    interpreter = lua.Interpreter(os.environ['BASE_DIR'])
+    series = interpreter.eval("{1, 2, 3, 4.5}")
+    assert series.to_array().tolist() == [1.0, 2.0, 3.0, 4.5], "to_array: double error"
+    try:
+        series.to_array('i')
+        assert False, "to_array: integer check error"
+    except ValueError:
+        pass
+    try:
+        interpreter.eval("{1, 2}").to_array('q')
+        assert False, "to_array: typecode q accepted"
+    except ValueError:
+        pass
+    assert interpreter.eval("{}").to_array('h') == array.array('h'), "to_array: empty error"
+    table = interpreter.eval("function(buf) return python.fromarray(buf) end")(array.array('i', [5, 6, 7]))
+    assert table.to_array('i') == array.array('i', [5, 6, 7]), "fromarray: buffer error"
+
+
+def columns_test():
+    interpreter = lua.Interpreter(os.environ['BASE_DIR'])
+    records = interpreter.eval("{{ts = 1, v = 10}, {ts = 2, v = 20}, {ts = 3}}")
+    columns = records.to_columns()
+    assert columns == {"ts": [1, 2, 3], "v": [10, 20, None]}, "to_columns: values error"
+    columns = interpreter.eval("function(t) return python.columns(t) end")(records)
+    assert columns["v"][:2] == [10, 20], "columns: lua side error"
+
+
+class SlotsRecord(object):
+    __slots__ = ("ts", "v")
+
+
+def schema_test():
+    import collections
+    import gc
+    import weakref
+    interpreter = lua.Interpreter(os.environ['BASE_DIR'])
+    Sample = collections.namedtuple("Sample", "ts v")
+    samples = interpreter.schema(Sample, ["ts", "v"])
+    table = samples.to_lua(Sample(1, 2.5))
+    assert table["ts"] == 1 and table["v"] == 2.5, "schema: namedtuple to lua error"
+    assert samples(table) == Sample(1, 2.5), "schema: namedtuple from lua error"
+    rows = interpreter.to_lua([Sample(1, 2), Sample(3, 4)])
+    assert rows[2]["v"] == 4, "schema: registered schema error"
+    records = interpreter.schema(SlotsRecord, ("ts", "v"))
+    record = records(interpreter.eval("{ts = 5, v = 6}"))
+    assert isinstance(record, SlotsRecord) and (record.ts, record.v) == (5, 6), "schema: slots error"
+    assert records.to_lua(record)["v"] == 6, "schema: slots to lua error"
+    other = lua.Interpreter(os.environ['BASE_DIR'])
+    for index in range(3):  # the keys are looked up again in each state
+        assert other.to_lua([Sample(index, 0)])[1]["ts"] == index, "schema: second state error"
+        assert interpreter.to_lua([Sample(index, 0)])[1]["ts"] == index, "schema: state switch error"
+
+    class Window(object):
+        def __init__(self, start):
+            self.start = start
+
+        @property
+        def span(self):
+            return [self.start, self.start + 1]  # new list for each record
+
+    interpreter.schema(Window, ["start", "span"])
+    windows = interpreter.to_lua([Window(1), Window(5)])
+    assert windows[2]["span"][1] == 5, "schema: property value memoized by id"
+    Mark = collections.namedtuple("Mark", "x")
+    marks = other.schema(Mark, ["x"])
+    ref = weakref.ref(other)
+    del other
+    gc.collect()
+    assert ref() is None, "schema: interpreter kept by the registered schema"
+    try:
+        marks.to_lua(Mark(1))
+        assert False, "schema: released interpreter used"
+    except RuntimeError:
+        pass
+    lua.register_converter(Mark, None)
+
+
+def pack_test():
+    import mmap
+    import tempfile
+    interpreter = lua.Interpreter(os.environ['BASE_DIR'])
+    rules = interpreter.eval("{name = 'rules', items = {1, 2, 3}}")
+    blob = interpreter.pack(rules)
+    assert blob[:3] == "LPK", "pack: header error"
+    copy = lua.Interpreter(os.environ['BASE_DIR']).unpack(blob)
+    assert copy["name"] == "rules" and copy["items"][3] == 3, "unpack: value error"
+    unpacked = interpreter.eval("function(data) local t = python.unpack(python.pack(data)) return t[2] end")
+    assert unpacked(interpreter.eval("{10, 20}")) == 20, "pack: lua side error"
+    fields = interpreter.eval("function(data) local t = python.unpack(python.pack(data)) return t.n, t[1] end")
+    assert fields(interpreter.eval("{5, n = 3}")) == (3, 5), "pack: field n lost"
+    number = interpreter.eval("16777217")  # not exact as a float
+    assert type(number) is int and type(interpreter.unpack(interpreter.pack(number))) is int, "pack: number type error"
+    with tempfile.NamedTemporaryFile() as snapshot:
+        snapshot.write(interpreter.pack({"a": [1, 2]}))
+        snapshot.flush()
+        assert interpreter.unpack_file(snapshot.name)["a"][2] == 2, "unpack_file: error"
+        mapped = mmap.mmap(snapshot.fileno(), 0, access=mmap.ACCESS_READ)
+        assert interpreter.unpack(mapped)["a"][1] == 1, "unpack: mmap error"
+        mapped.close()
+
+
+def json_test():
+    import json
+    interpreter = lua.Interpreter(os.environ['BASE_DIR'])
+    encode = interpreter.eval("function(t) return python.json_encode(t) end")
+    text = encode(interpreter.eval("{name = [[a\"b]], items = {1, 2.5, 3}}"))
+    assert json.loads(text) == {"name": 'a"b', "items": [1, 2.5, 3]}, "json_encode: error"
+    assert json.loads(encode(interpreter.eval("{[1000000] = 1}"))) == {"1000000": 1}, "json_encode: sparse error"
+    assert json.loads(encode(interpreter.eval("{5, n = 3}"))) == {"1": 5, "n": 3}, "json_encode: field n lost"
+    decode = interpreter.eval("function(s) local t = python.json_decode(s) return t.items[3] + t.nested.n end")
+    assert decode('{"items": [1, null, 3], "nested": {"n": 4}}') == 7, "json_decode: error"
+
+
+def ref_registry_test():
+    interpreter = lua.Interpreter(os.environ['BASE_DIR'])
+    kept = interpreter.eval("{value = 1}")
+    for index in range(1000):
+        assert interpreter.eval("{value = %d}" % index)["value"] == index, "ref registry: value error"
+    assert interpreter.eval("python._refs[-1]") < 10, "ref registry: released slots not reused"
+    interpreter.reset()
+    assert kept["value"] == 1, "ref registry: reference lost by reset"
+
+
+def identity_cache_test():
+    interpreter = lua.Interpreter(os.environ['BASE_DIR'])
+    interpreter.execute("shared = {1, 2}")
+    table = interpreter.eval("shared")
+    assert interpreter.eval("shared") is table, "identity cache: wrapper not reused"
+    assert interpreter.eval("{1, 2}") != table, "identity cache: distinct tables are equal"
+    memo = {table: "shared"}
+    del table
+    assert memo[interpreter.eval("shared")] == "shared", "identity cache: hash error"
+
+
+def freelist_test():
+    interpreter = lua.Interpreter(os.environ['BASE_DIR'])
+    before = lua.freelist_stats()
+    for index in range(100):
+        assert list(interpreter.eval("{1, 2, 3}")) == [1, 2, 3], "free list: iteration error"
+    stats = lua.freelist_stats()
+    for name in ("LuaObject", "LuaObject_iterator"):
+        assert stats[name]["hits"] > before[name]["hits"], "free list: %s not reused" % name
+        assert stats[name]["size"] <= 256, "free list: %s not bounded" % name
+
+
+def collect_test():
+    import gc
+    import weakref
+
+    class Holder(object):
+        pass
+
+    interpreter = lua.Interpreter(os.environ['BASE_DIR'])
+    holder = Holder()
+    holder.table = interpreter.eval("{}")
+    holder.table["owner"] = holder  # cycle through the container of the table
+    assert interpreter.reachable()[holder.table] == (holder,), "collect: cycle not reported"
+    ref = weakref.ref(holder)
+    del holder
+    gc.collect()
+    assert ref() is not None, "collect: cycle seen without the Lua side"
+    interpreter.collect()
+    assert ref() is None, "collect: cycle not collected"
+
+
+def cleanup_test():
+    import weakref
+
+    class Boom(object):
+        pass
+
+    def explode(obj):
+        raise ValueError("boom")
+
+    alive = weakref.WeakSet()
+
+    def make():
+        obj = Boom()
+        alive.add(obj)
+        return obj
+
+    lua.register_converter(Boom, explode)
+    try:
+        interpreter = lua.Interpreter(os.environ['BASE_DIR'])
+        call = interpreter.eval("function(f) return f() end")
+        for index in range(100):
+            try:
+                call(make)
+            except RuntimeError:
+                pass
+        assert len(alive) == 0, "cleanup: temporaries kept by the errors"
+        interpreter.execute("python._lua_table_convert = 1 python.dict({a = 1})")
+        assert interpreter.eval("python._lua_table_convert") == 1, "cleanup: flag of the caller not restored"
+    finally:
+        lua.register_converter(Boom, None)
+
+
+def optional_lookup_test():
+    class Options(object):
+        level = 3
+
+    interpreter = lua.Interpreter(os.environ['BASE_DIR'])
+    getattr_ = interpreter.eval("function(o, n, d) return python.getattr(o, n, d) end")
+    assert getattr_(Options(), "level", 0) == 3, "getattr: value error"
+    assert getattr_(Options(), "missing", 5) == 5, "getattr: default error"
+    hasattr_ = interpreter.eval("function(o, n) return python.hasattr(o, n) end")
+    assert hasattr_(Options(), "level") == 1 and hasattr_(Options(), "missing") is None, "hasattr: error"
+    get = interpreter.eval("function(o, k, d) return python.get(o, k, d) end")
+    assert get({"a": 1}, "a", 0) == 1 and get({"a": 1}, "b", 7) == 7, "get: error"
+    optional = interpreter.eval("function(o) local opt = python.optional(o) return opt.missing, opt.level end")
+    assert optional(Options()) == (None, 3), "optional: error"
+
+
+def builtins_test():
+    interpreter = lua.Interpreter(os.environ['BASE_DIR'])
+    length = interpreter.eval("function(o) return python.len(o) end")
+    assert length([1, 2, 3]) == 3, "builtins: len error"
+    isinstance_ = interpreter.eval("function(o, c) return python.isinstance(o, c) end")
+    assert isinstance_([], list) == 1 and isinstance_([], dict) is None, "builtins: isinstance error"
+    contains = interpreter.eval("function(o, v) return python.contains(o, v) end")
+    assert contains([1, 2], 2) == 1 and contains([1, 2], 5) is None, "builtins: contains error"
+    assert interpreter.eval("function(o) return python.type(o) end")([]) is list, "builtins: type error"
+    assert interpreter.eval("function(o) return python.str(o) end")((1, 2)) == "(1, 2)", "builtins: str error"
+    total = interpreter.eval("""function(o)
+        local it, n, value, more = python.iter(o), 0
+        value, more = python.next(it)
+        while more do n = n + 1 value, more = python.next(it) end
+        return n
+    end""")
+    assert total([1, None, 3]) == 3, "builtins: iter/next error"
+    try:
+        interpreter.execute("python.len({1, 2})")
+        assert False, "builtins: Lua table accepted"
+    except RuntimeError:
+        pass
+    assert interpreter.eval("python.len(python.list({1, 2}))") == 2, "builtins: list argument error"
+
+
+pool_test()
+recycle_test()
+bytecode_cache_test()
+async_test()
+owner_thread_test()
+process_pool_test()
+views_test()
+to_python_test()
+to_lua_test()
+converters_test()
+unicode_encoding_test()
+unicode_decoding_test()
+array_test()
+numeric_array_test()
+columns_test()
+schema_test()
+pack_test()
+json_test()
+ref_registry_test()
+identity_cache_test()
+freelist_test()
+collect_test()
+cleanup_test()
+optional_lookup_test()
+builtins_test()
+
 index = 0
 while True:
     with LuaInterpreter(os.environ['BASE_DIR']) as interpreter: